@@ -11,10 +11,10 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	When all the entries are in use, Add grows the table; the caller
+//	is responsible for extending the directory file to Size() bytes
+//	before writing it back.  Lookups go through a hash index on the
+//	file name that is rebuilt whenever the directory is fetched.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,6 +25,23 @@
 #include "filehdr.h"
 #include "directory.h"
 
+//----------------------------------------------------------------------
+// HashName
+// 	Hash the first "len" characters of "name" (FNV-1a).
+//----------------------------------------------------------------------
+
+unsigned int
+HashName(char *name, int len)
+{
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; i < len && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -38,9 +55,13 @@
 Directory::Directory(int size)
 {
     table = new DirectoryEntry[size];
+    hashNext = new int[size];
     tableSize = size;
     for (int i = 0; i < tableSize; i++)
 	table[i].inUse = FALSE;
+    dirtyFirst = 0;			// all of it has to be written
+    dirtyLast = tableSize - 1;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
@@ -51,11 +72,13 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] hashNext;
 } 
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk, resizing the
+//	in-memory table to match the directory file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,12 +86,26 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    if (size != tableSize) {
+        delete [] table;
+        delete [] hashNext;
+        table = new DirectoryEntry[size];
+        hashNext = new int[size];
+        tableSize = size;
+    }
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    dirtyFirst = tableSize;
+    dirtyLast = -1;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only
+//	the sectors holding changed entries are written; the range is
+//	widened to whole sectors, since we have them in memory anyway.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
@@ -76,7 +113,119 @@ Directory::FetchFrom(OpenFile *file)
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = tableSize * sizeof(DirectoryEntry);
+    int first, last;
+
+    if (dirtyFirst > dirtyLast)
+        return;				// nothing changed
+    first = divRoundDown(dirtyFirst * (int) sizeof(DirectoryEntry), 
+                SectorSize) * SectorSize;
+    last = min(divRoundUp((dirtyLast + 1) * (int) sizeof(DirectoryEntry), 
+                SectorSize) * SectorSize, size);
+    (void) file->WriteAt((char *)table + first, last - first, first);
+    dirtyFirst = tableSize;
+    dirtyLast = -1;
+}
+
+//----------------------------------------------------------------------
+// Directory::SetDirty
+// 	Remember that entries "first" to "last" have to be written back.
+//----------------------------------------------------------------------
+
+void
+Directory::SetDirty(int first, int last)
+{
+    dirtyFirst = min(dirtyFirst, first);
+    dirtyLast = max(dirtyLast, last);
+}
+
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Grow the in-memory table to "size" entries; the new entries
+//	are free.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int size)
+{
+    DirectoryEntry *newTable = new DirectoryEntry[size];
+
+    ASSERT(size >= tableSize);
+    bcopy((char *)table, (char *)newTable, tableSize * sizeof(DirectoryEntry));
+    for (int i = tableSize; i < size; i++)
+        newTable[i].inUse = FALSE;
+    delete [] table;
+    delete [] hashNext;
+    table = newTable;
+    hashNext = new int[size];
+    SetDirty(tableSize, size - 1);	// the new sectors hold garbage
+    tableSize = size;
+    Rehash();
+}
+
+//----------------------------------------------------------------------
+// Directory::CopyName
+// 	Copy the full name of entry "i" (which may be spread over several
+//	long name entries) into "into", which must have room for
+//	FileLongNameMaxLen + 1 characters.
+//----------------------------------------------------------------------
+
+void
+Directory::CopyName(int i, char *into)
+{
+    ASSERT(table[i].inUse && !table[i].isLong);
+    strncpy(into, table[i].shortname, FileNameMaxLen);
+    into[FileNameMaxLen] = '\0';
+    if (table[i].beginLong) {
+        do {
+            i++;
+            ASSERT(i < tableSize && table[i].isLong);
+            strncat(into, table[i].longname, FileLongNamePerEntry);
+        } while (!table[i].lastEntry);
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash / HashInsert / HashRemove
+// 	Maintain the hash index from file name to the first entry of
+//	the file.  Each bucket is a chain threaded through hashNext.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    for (int b = 0; b < NumHashBuckets; b++)
+        hashHead[b] = -1;
+    for (int i = 0; i < tableSize; i++)
+        if (table[i].inUse && !table[i].isLong)
+            HashInsert(i);
+}
+
+void
+Directory::HashInsert(int i)
+{
+    char name[FileLongNameMaxLen + 1];
+    int b;
+
+    CopyName(i, name);
+    b = HashName(name, FileLongNameMaxLen) % NumHashBuckets;
+    hashNext[i] = hashHead[b];
+    hashHead[b] = i;
+}
+
+void
+Directory::HashRemove(int i)
+{
+    char name[FileLongNameMaxLen + 1];
+    int *link;
+
+    CopyName(i, name);
+    link = &hashHead[HashName(name, FileLongNameMaxLen) % NumHashBuckets];
+    while (*link != i) {
+        ASSERT(*link != -1);
+        link = &hashNext[*link];
+    }
+    *link = hashNext[i];
 }
 
 //----------------------------------------------------------------------
@@ -90,12 +239,14 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse)
-        if (!table[i].isLong)
-        if (!strncmp(getName(i), name, FileLongNameMaxLen))
-	       return i;
-        
+    char entryName[FileLongNameMaxLen + 1];
+    int b = HashName(name, FileLongNameMaxLen) % NumHashBuckets;
+
+    for (int i = hashHead[b]; i != -1; i = hashNext[i]) {
+        CopyName(i, entryName);
+        if (!strncmp(entryName, name, FileLongNameMaxLen))
+	    return i;
+    }
     return -1;		// name not in directory
 }
 
@@ -106,90 +257,43 @@ Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"isDir" -- if not NULL, set to whether the file is a directory
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *name)
+Directory::Find(char *name, bool *isDir)
 {
-    char *namebuffer = new char[50];
-    strcpy(namebuffer, name);
-
-    // suppose "name" can be a path: root/OS/homework/HW1
-    char *firstpart;               // root
-    char *secondpart;              // OS/homework/HW1
-    DividePath(&namebuffer, &firstpart, &secondpart);
-    ASSERT(firstpart != NULL);
-    int i = FindIndex(firstpart);
-    if (i == -1) return -1;
-
-    int sonSector = table[i].sector;
-    if (secondpart == NULL)
-        return sonSector;
-    else{
-        // else, son is a directory, FIND in son recursively
-        Directory *son = new Directory(NumDirEntries);
-        OpenFile *sonFile = new OpenFile(sonSector);
-        son->FetchFrom(sonFile);
-        int finalSector = son->Find(secondpart);
-        delete son;
-        delete sonFile;
-        return finalSector;
-    }
-    /*
     int i = FindIndex(name);
 
-    if (i != -1)
-	return table[i].sector;
-    return -1;*/
+    if (i == -1)
+	return -1;
+    if (isDir != NULL)
+        *isDir = table[i].type;
+    return table[i].sector;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory, or 
+//	is too long.  If there is no run of free entries long enough
+//	for the name, the table grows.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"dir" -- is the file a directory?
 //----------------------------------------------------------------------
 
 bool
 Directory::Add(char *name, int newSector, bool dir)
 { 
-    char *namebuffer = new char[50];
-    strcpy(namebuffer, name);
-
-    // suppose "name" can be a path: root/OS/homework/HW1
-    char *firstpart;               // root
-    char *secondpart;              // OS/homework/HW1
-    DividePath(&namebuffer, &firstpart, &secondpart);
-    ASSERT(firstpart != NULL);
-
-    int sonIndex = FindIndex(firstpart);
-    // if it is a directory but does not exist
-    if (sonIndex == -1 && secondpart != NULL) return FALSE;
-    // if it is a file but exist
-    if (sonIndex != -1 && secondpart == NULL) return FALSE;
-
-    if(secondpart != NULL){
-    //  son is a directory, ADD in son recursively
-        ASSERT(table[sonIndex].type == 1);
-        int sonSector = table[sonIndex].sector;
-        Directory *son = new Directory(NumDirEntries);
-        OpenFile *sonFile = new OpenFile(sonSector);
-        son->FetchFrom(sonFile);
-        int success = son->Add(secondpart, newSector, dir);
-        if (success) son->WriteBack(sonFile);
-        delete son;
-        delete sonFile;
-        return success;
-    }
-    // else, add file in this directory
-    // if (FindIndex(name) != -1)
-	// return FALSE;
-    int lenName = strlen(firstpart);
+    if (FindIndex(name) != -1)
+	return FALSE;
+
+    int lenName = strlen(name);
     int numEntries = 0; // how many entries does it need?
+    if (lenName > FileLongNameMaxLen)
+        return FALSE;
     if (lenName > FileNameMaxLen){
         lenName -= FileNameMaxLen;
         numEntries ++;
@@ -198,41 +302,49 @@ Directory::Add(char *name, int newSector, bool dir)
             numEntries ++;
         }
     }
-    for (int i = 0; i+numEntries < tableSize; ++i){
-        bool found = TRUE;
-        // is there consecutive numEntries free entries
-        for (int j = i; j <= i+numEntries; ++j){
-            if (table[j].inUse)
-                found = FALSE;
-        }
-        if (found) {
-            char *namecopy = firstpart;
-            table[i].inUse = TRUE;
-            table[i].isLong = FALSE;
-            table[i].beginLong = FALSE;
-            strncpy(table[i].shortname, namecopy, FileNameMaxLen); 
-            namecopy += FileNameMaxLen;
-            table[i].sector = newSector;
-            if (dir) table[i].type = 1;
-            else table[i].type = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i+numEntries < tableSize; ++i){
+            bool found = TRUE;
+            // is there consecutive numEntries free entries
+            for (int j = i; j <= i+numEntries; ++j){
+                if (table[j].inUse)
+                    found = FALSE;
+            }
+            if (found) {
+                char *namecopy = name;
+                table[i].inUse = TRUE;
+                table[i].isLong = FALSE;
+                table[i].beginLong = FALSE;
+                strncpy(table[i].shortname, namecopy, FileNameMaxLen); 
+                table[i].shortname[FileNameMaxLen] = '\0';
+                namecopy += FileNameMaxLen;
+                table[i].sector = newSector;
+                if (dir) table[i].type = 1;
+                else table[i].type = 0;
             
-            // it is the beginning of a long name entry
-            if (numEntries > 0){
-                table[i].beginLong = TRUE;
-                for (int j=1; j<=numEntries; ++j){
-                    table[i+j].inUse = TRUE;
-                    table[i+j].isLong = TRUE;
-                    table[i+j].lastEntry = FALSE;
-                    strncpy(table[i+j].longname, namecopy, FileLongNamePerEntry); 
-                    namecopy += FileLongNamePerEntry;
+                // it is the beginning of a long name entry
+                if (numEntries > 0){
+                    table[i].beginLong = TRUE;
+                    for (int j=1; j<=numEntries; ++j){
+                        table[i+j].inUse = TRUE;
+                        table[i+j].isLong = TRUE;
+                        table[i+j].lastEntry = FALSE;
+                        strncpy(table[i+j].longname, namecopy, FileLongNamePerEntry); 
+                        table[i+j].longname[FileLongNamePerEntry] = '\0';
+                        namecopy += FileLongNamePerEntry;
+                    }
+                    table[i+numEntries].lastEntry = TRUE;
                 }
-                table[i+numEntries].lastEntry = TRUE;
+                SetDirty(i, i + numEntries);
+                HashInsert(i);
+                return TRUE;
             }
-            return TRUE;
         }
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
-    
+        // no space; grow the directory and try again
+        Resize(tableSize + max(NumDirEntries, numEntries + 1));
+    }
+    ASSERT(FALSE);
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -246,36 +358,13 @@ Directory::Add(char *name, int newSector, bool dir)
 bool
 Directory::Remove(char *name)
 { 
-    char *namebuffer = new char[50];
-    strcpy(namebuffer, name);
-
-    // suppose "name" can be a path: root/OS/homework/HW1
-    char *firstpart;               // root
-    char *secondpart;              // OS/homework/HW1
-    DividePath(&namebuffer, &firstpart, &secondpart);
-    ASSERT(firstpart != NULL);
-    int i = FindIndex(firstpart);
-    // if son does not exist
-    if (i == -1) return FALSE;
-
-    if (secondpart != NULL){
-        ASSERT(table[i].type == 1);
-    //  son is a directory, REMOVE in son recursively
-        int sonSector = table[i].sector;
-        Directory *son = new Directory(NumDirEntries);
-        OpenFile *sonFile = new OpenFile(sonSector);
-        son->FetchFrom(sonFile);
-        int success = son->Remove(secondpart);
-        if (success) son->WriteBack(sonFile);
-        delete son;
-        delete sonFile;
-        return success;
-    }
-    //int i = FindIndex(name);
+    int i = FindIndex(name);
 
-    //if (i == -1)
-	//   return FALSE; 		// name not in directory
-    ASSERT(table[i].isLong == FALSE);
+    if (i == -1)
+	return FALSE; 		// name not in directory
+    int first = i;
+
+    HashRemove(i);
     table[i].inUse = FALSE;
     if (table[i].beginLong){
         while(!table[++i].lastEntry){
@@ -284,9 +373,28 @@ Directory::Remove(char *name)
         }
         table[i].inUse = FALSE;
     }
+    SetDirty(first, i);
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::EntrySector
+// 	Return the header sector of the file whose name starts at entry
+//	"i", or -1 if no file starts there.
+//
+//	"isDir" -- if not NULL, set to whether the file is a directory
+//----------------------------------------------------------------------
+
+int
+Directory::EntrySector(int i, bool *isDir)
+{
+    if (!table[i].inUse || table[i].isLong)
+        return -1;
+    if (isDir != NULL)
+        *isDir = table[i].type;
+    return table[i].sector;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
 // 	List all the file names in the directory. 
@@ -364,33 +472,121 @@ char *Directory::getName(int i)
     }
     else{
         // long name
-        name = new char[FileLongNameMaxLen];
-        strcpy(name, table[i++].shortname);
-        while(!table[i].lastEntry){
-            ASSERT(i < tableSize);
-            strcat(name, table[i].longname);
-            i++;
-        }
-        ASSERT(i < tableSize);
-        strcat(name, table[i].longname);
+        name = new char[FileLongNameMaxLen + 1];
+        CopyName(i, name);
     }
     return name;
 }
 
-void 
-Directory::DividePath(char **path, char **first, char **second){
-    //  path: root/OS/homework/HW1
-    //  first: root
-    //  second: OS/homework/HW1
-    char *divide = strchr((*path), '/');
-    if (divide == NULL){
-        (*first) = (*path);
-        (*second) = NULL;
+//----------------------------------------------------------------------
+// CanonicalPath
+// 	Copy the first "len" characters of "path" into "into", without
+//	leading or trailing '/'s and with each run of '/'s made one, so
+//	that every spelling of a path "FileSystem::Lookup" accepts gives
+//	the same cache key.  "into" must have room for "len" + 1 chars.
+//
+//	Returns the length of the result.
+//----------------------------------------------------------------------
+
+static int
+CanonicalPath(char *path, int len, char *into)
+{
+    int n = 0;
+
+    for (int i = 0; i < len; i++) {
+        if (path[i] == '/' && (n == 0 || into[n - 1] == '/'))
+            continue;
+        into[n++] = path[i];
     }
-    else {
-        (*first) = (*path);
-        (*second) = divide + 1;
-        *divide = '\0';
+    if (n > 0 && into[n - 1] == '/')
+        n--;
+    into[n] = '\0';
+    return n;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty path lookup cache.
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache()
+{
+    for (int i = 0; i < DentryCacheSize; i++)
+        table[i].path = NULL;
+}
+
+DentryCache::~DentryCache()
+{
+    for (int i = 0; i < DentryCacheSize; i++)
+        delete [] table[i].path;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return TRUE, and the file header sector of the first "len"
+//	characters of "path", if they are cached.
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(char *path, int len, int *sector, bool *isDir)
+{
+    char *key = new char[len + 1];
+    DentryCacheEntry *e;
+    bool found;
+
+    len = CanonicalPath(path, len, key);
+    e = &table[HashName(key, len) % DentryCacheSize];
+    found = (e->path != NULL && !strcmp(e->path, key));
+    delete [] key;
+    if (!found)
+        return FALSE;
+    *sector = e->sector;
+    if (isDir != NULL)
+        *isDir = e->isDir;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Insert
+// 	Remember that the first "len" characters of "path" name the
+//	file whose header is at "sector", replacing whatever was in
+//	the slot before.  Paths are kept in canonical form.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Insert(char *path, int len, int sector, bool isDir)
+{
+    char *key = new char[len + 1];
+    DentryCacheEntry *e;
+
+    len = CanonicalPath(path, len, key);
+    e = &table[HashName(key, len) % DentryCacheSize];
+    delete [] e->path;
+    e->path = key;
+    e->sector = sector;
+    e->isDir = isDir;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Invalidate
+// 	Drop the entry for "path", and for every path below it in case
+//	"path" is a directory.  However "path" is spelled, it matches
+//	the canonical form the entries are kept in.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Invalidate(char *path)
+{
+    char *key = new char[strlen(path) + 1];
+    int len = CanonicalPath(path, strlen(path), key);
+
+    for (int i = 0; i < DentryCacheSize; i++) {
+        char *p = table[i].path;
+        if (p != NULL && !strncmp(p, key, len) 
+                      && (p[len] == '\0' || p[len] == '/' || len == 0)) {
+            delete [] p;
+            table[i].path = NULL;
+        }
     }
-    return;
-}
\ No newline at end of file
+    delete [] key;
+}
@@ -23,7 +23,9 @@
 					// file names are <= 9 characters long
 #define FileLongNameMaxLen  256 // we assume long file names are <= 256 characters long
 #define FileLongNamePerEntry 14
-#define NumDirEntries       10
+#define NumDirEntries       10	// initial size; directories grow by this
+#define NumHashBuckets      31	// chains in a directory's name index
+#define DentryCacheSize     64	// entries in the path -> sector cache
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -61,11 +63,15 @@ class DirectoryEntry {
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// When it is on disk, it is stored as a regular Nachos file, which
+// grows as files are added.  In memory, the entries are indexed by
+// a hash of their name.
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk; WriteBack only writes the sectors holding entries that
+// changed.  Names passed to a Directory are single path
+// components; FileSystem walks the path.
 
 class Directory {
   public:
@@ -77,13 +83,20 @@ class Directory {
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name, bool *isDir = NULL);
+					// Find the sector number of the 
 					// FileHeader for file: "name"
 
     bool Add(char *name, int newSector, bool dir=FALSE);  // Add a file name into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    int Size() { return tableSize * sizeof(DirectoryEntry); }
+					// Bytes needed to store the directory
+    int NumEntries() { return tableSize; }
+    int EntrySector(int i, bool *isDir);// Header sector of the file
+					//  starting at entry "i", or -1
+
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
@@ -91,15 +104,56 @@ class Directory {
 					//  names and their contents.
     // lab 5
     char *getName(int i);
-    void DividePath(char **path, char **first, char **second);
     // end lab 5
   private:
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
+    int hashHead[NumHashBuckets];	// First entry of each hash chain
+    int *hashNext;			// Next entry on the same chain
+    int dirtyFirst, dirtyLast;		// Entries changed since FetchFrom
+					//  or WriteBack
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    void CopyName(int i, char *into);	// Full name of entry "i"
+    void Resize(int size);		// Grow the table to "size" entries
+    void SetDirty(int first, int last);	// Entries first..last changed
+    void HashInsert(int i);		// Index entry "i" by its name
+    void HashRemove(int i);
+    void Rehash();			// Rebuild the whole index
+};
+
+// The following class caches the result of path lookups -- full path
+// to file header sector -- so that repeated opens of the same (or a
+// nearby) path do not read every directory along the way.  The cache
+// is direct-mapped on a hash of the path, with repeated '/'s collapsed
+// so that one file has one key; entries are dropped when the file they
+// name is created or removed.
+
+class DentryCacheEntry {
+  public:
+    char *path;				// NULL if the slot is empty
+    int sector;				// File header of "path"
+    bool isDir;				// Is "path" a directory?
+};
+
+class DentryCache {
+  public:
+    DentryCache();			// An empty cache
+    ~DentryCache();
+
+    bool Lookup(char *path, int len, int *sector, bool *isDir);
+					// Look up the first "len" chars
+					//  of "path"
+    void Insert(char *path, int len, int sector, bool isDir);
+    void Invalidate(char *path);	// Drop "path" and everything 
+					//  below it
+
+  private:
+    DentryCacheEntry table[DentryCacheSize];
 };
 
+unsigned int HashName(char *name, int len);	// Hash "len" chars of name
+
 #endif // DIRECTORY_H
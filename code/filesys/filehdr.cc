@@ -4,11 +4,14 @@
 //
 //	The file header is used to locate where on disk the 
 //	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	table of pointers -- most entries point directly to the 
+//	disk sector containing that portion of the file data, the
+//	last two point to a single indirect and a doubly indirect
+//	table of sector numbers.  The table size is chosen so that 
+//	the file header will be just big enough to fit in one disk sector.
+//
+//	Index tables are read at most once while the header is in
+//	memory, and are written back together with the header.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -26,6 +29,51 @@
 
 #include "system.h"
 #include "filehdr.h"
+#include "synch.h"
+//----------------------------------------------------------------------
+// IndexSectors
+// 	Return how many index tables a file with "numSectors" data
+//	blocks needs, besides its header.
+//----------------------------------------------------------------------
+
+int
+IndexSectors(int numSectors)
+{
+    if (numSectors <= NumDirectI)
+        return 0;
+    numSectors -= NumDirectI;
+    if (numSectors <= NumDirectII)
+        return 1;
+    numSectors -= NumDirectII;
+    return 2 + divRoundUp(numSectors, NumDirectII);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize an empty file header, with no cached index tables.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    numBytes = 0;
+    numSectors = 0;
+    hdrSector = -1;
+    indirect = NULL;
+    doublyIndirect = NULL;
+    secondLevel = NULL;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	Release the index table cache.  Nothing is written back; callers
+//	flush modifications with WriteBack.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    DropIndexCache();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -40,42 +88,56 @@
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
+    DropIndexCache();
+    numBytes = 0;
+    numSectors = 0;
+    return Extend(freeMap, fileSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file to "newSize" bytes, allocating data blocks and
+//	whatever index tables they need out of "freeMap".  Return FALSE,
+//	leaving the header unchanged, if the disk is too full.
+//
+//	The new index tables are only written to disk by WriteBack.
+//----------------------------------------------------------------------
 
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (numSectors <= NumDirectI){
-        if (freeMap->NumClear() < numSectors)
-	       return FALSE;		// not enough space
-        for (int i = 0; i < numSectors; i++)
-        dataSectors[i] = freeMap->Find();
+bool
+FileHeader::Extend(BitMap *freeMap, int newSize)
+{
+    if (newSize > MaxFileSize)
+        return FALSE;
+    if (newSize <= numBytes)
         return TRUE;
-    }
-    else {
-        // how many secondary index Table do we need ?
-        int secondaryTableNum = divRoundUp((numSectors - NumDirectI), NumDirectII);
-        ASSERT(secondaryTableNum <= NumDirectTable);
-        if (freeMap->NumClear() < numSectors + secondaryTableNum)   
-           return FALSE;        // not enough space
-        int k = 0;    // number of allocated sectors
-
-        // we need secondary index table
-        // fisrt, allocate all direct indexs
-        for (int i = 0; i < NumDirectI; i++, k++)
-            dataSectors[i] = freeMap->Find();
-
-        // then, allocate secondary index table
-        for (int i = 0; i < secondaryTableNum; ++i){
-            int secondaryIndexTable[NumDirectII] = {0};
-            dataSectors[NumDirectI + i] = freeMap->Find();
-            for (int j = 0; j < NumDirectII && k < numSectors; ++j,++k){
-                secondaryIndexTable[j] = freeMap->Find();
-            }
-            SetLastAccessTime();
-            SetLastModifyTime();
-            synchDisk->WriteSector(dataSectors[NumDirectI + i], (char *)secondaryIndexTable); 
-        }
+    if (!GrowTo(freeMap, divRoundUp(newSize, SectorSize)))
+        return FALSE;
+    numBytes = newSize;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GrowTo
+// 	Allocate data blocks numSectors .. "sectors"-1.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::GrowTo(BitMap *freeMap, int sectors)
+{
+    int needed = (sectors - numSectors) 
+                    + IndexSectors(sectors) - IndexSectors(numSectors);
+
+    if (needed <= 0)
         return TRUE;
+    if (freeMap->NumClear() < needed)
+        return FALSE;			// not enough space
+    for (; numSectors < sectors; numSectors++) {
+        int sector = freeMap->Find();
+        ASSERT(sector != -1);
+        SetSector(numSectors, sector, freeMap);
     }
+    SetLastModifyTime();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -88,37 +150,84 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    if (numSectors <= NumDirectI){
-        for (int i = 0; i < numSectors; i++) {
-            ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-            freeMap->Clear((int) dataSectors[i]);
-        }
-    
+    for (int i = 0; i < numSectors; i++) {
+        int sector = GetSector(i);
+        ASSERT(freeMap->Test(sector));  // ought to be marked!
+        freeMap->Clear(sector);
     }
-    else {
-        // secondary index table is used
-        int secondaryTableNum = divRoundUp((numSectors - NumDirectI), NumDirectII);
-        for (int i = 0; i < NumDirectI; i++) {
-            ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-            freeMap->Clear((int) dataSectors[i]);
-        }
-        for (int i=0; i<secondaryTableNum; ++i){
-            // read secondary index table to memory
-            int secondaryIndexTable[NumDirectII];
-            SetLastAccessTime();
-            synchDisk->ReadSector((int) dataSectors[NumDirectI + i], (char *)secondaryIndexTable);
-            for (int j=0; j<NumDirectII; ++j){
-                if (freeMap->Test((int) secondaryIndexTable[j]))
-                    freeMap->Clear((int) secondaryIndexTable[j]);
-                else
-                    break;
-            }
-            // deallocate sector of secondary table 
-            freeMap->Clear((int) dataSectors[NumDirectI + i]);
-        }
+    if (numSectors > NumDirectI)
+        freeMap->Clear(dataSectors[IndirectIndex]);
+    if (numSectors > NumDirectI + NumDirectII) {
+        int tables = divRoundUp(numSectors - NumDirectI - NumDirectII, 
+                                    NumDirectII);
+        if (doublyIndirect == NULL)
+            doublyIndirect = LoadIndex(dataSectors[DoublyIndirectIndex]);
+        for (int i = 0; i < tables; i++)
+            freeMap->Clear(doublyIndirect->entries[i]);
+        freeMap->Clear(dataSectors[DoublyIndirectIndex]);
+    }
+    DropIndexCache();
+}
+
+//----------------------------------------------------------------------
+// MarkUsed
+// 	Mark "sector" in "used", for FileHeader::MarkSectors.  Return 1,
+//	and leave "used" alone, if the sector is not on the disk or is
+//	already used by something else; 0 otherwise.
+//----------------------------------------------------------------------
+
+static int
+MarkUsed(BitMap *used, int sector)
+{
+    if (sector < 0 || sector >= NumSectors) {
+        printf("Check: sector %d out of range\n", sector);
+        return 1;
+    }
+    if (used->Test(sector)) {
+        printf("Check: sector %d used twice\n", sector);
+        return 1;
+    }
+    used->Mark(sector);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MarkSectors
+// 	Mark every sector this file uses, besides its header, in "used",
+//	checking on the way that the header makes sense.  An index table
+//	is only read once its own sector has been checked, so that a bad
+//	header cannot send us off the end of the disk.  Return the number
+//	of problems found.
+//----------------------------------------------------------------------
+
+int
+FileHeader::MarkSectors(BitMap *used)
+{
+    int problems = 0;
+
+    if (numSectors < 0 || numSectors > MaxFileSectors
+                || numSectors != divRoundUp(numBytes, SectorSize)) {
+        printf("Check: header %d has %d bytes in %d sectors\n", 
+                    hdrSector, numBytes, numSectors);
+        return 1;
     }
+    for (int i = 0; i < numSectors; i++) {
+        int n = i - NumDirectI - NumDirectII;
 
-    
+        if (i == NumDirectI 
+                && MarkUsed(used, dataSectors[IndirectIndex]))
+            return problems + 1;
+        if (n == 0 && MarkUsed(used, dataSectors[DoublyIndirectIndex]))
+            return problems + 1;
+        if (n >= 0 && n % NumDirectII == 0) {
+            if (doublyIndirect == NULL)
+                doublyIndirect = LoadIndex(dataSectors[DoublyIndirectIndex]);
+            if (MarkUsed(used, doublyIndirect->entries[n / NumDirectII]))
+                return problems + 1;
+        }
+        problems += MarkUsed(used, GetSector(i));
+    }
+    return problems;
 }
 
 //----------------------------------------------------------------------
@@ -131,6 +240,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+    DropIndexCache();
     synchDisk->ReadSector(sector, (char *)this);
     // --- lab 5 ---
     // update access time 
@@ -140,7 +250,8 @@ FileHeader::FetchFrom(int sector)
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk,
+//	along with any index tables that changed. 
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -154,6 +265,12 @@ FileHeader::WriteBack(int sector)
     SetLastModifyTime();
     // -- end lab 5 ---
     synchDisk->WriteSector(sector, (char *)this); 
+
+    FlushIndex(indirect);
+    FlushIndex(doublyIndirect);
+    if (secondLevel != NULL)
+        for (int i = 0; i < NumDirectII; i++)
+            FlushIndex(secondLevel[i]);
 }
 
 //----------------------------------------------------------------------
@@ -169,21 +286,138 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    //return(dataSectors[offset / SectorSize]);
-    int sectorIndex = offset / SectorSize;
-    if (sectorIndex < NumDirectI)
-        return(dataSectors[sectorIndex]);
-    else
-    {
-        int i = (sectorIndex - NumDirectI) / NumDirectII;
-        int offoffset = (sectorIndex - NumDirectI) % NumDirectII;
-        // read secondary index table to memory
-        int secondaryIndexTable[NumDirectII];
-        SetLastAccessTime();
-        synchDisk->ReadSector((int) dataSectors[NumDirectI + i], (char *)secondaryIndexTable);
-        int sec = secondaryIndexTable[offoffset];
-        return sec;
+    return GetSector(offset / SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::GetSector
+// 	Return the sector holding data block "n" of the file, reading
+//	the index tables on the way into the cache if they are not there.
+//----------------------------------------------------------------------
+
+int
+FileHeader::GetSector(int n)
+{
+    ASSERT(n >= 0 && n < MaxFileSectors);
+    if (n < NumDirectI)
+        return dataSectors[n];
+    n -= NumDirectI;
+    if (n < NumDirectII) {
+        if (indirect == NULL)
+            indirect = LoadIndex(dataSectors[IndirectIndex]);
+        return indirect->entries[n];
+    }
+    n -= NumDirectII;
+    if (doublyIndirect == NULL)
+        doublyIndirect = LoadIndex(dataSectors[DoublyIndirectIndex]);
+    if (secondLevel == NULL) {
+        secondLevel = new IndexTable *[NumDirectII];
+        for (int i = 0; i < NumDirectII; i++)
+            secondLevel[i] = NULL;
+    }
+    int i = n / NumDirectII;
+    if (secondLevel[i] == NULL)
+        secondLevel[i] = LoadIndex(doublyIndirect->entries[i]);
+    return secondLevel[i]->entries[n % NumDirectII];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetSector
+// 	Record that data block "n" is stored in "sector".  Blocks are
+//	always added at the end of the file, so the first block behind
+//	an index table allocates that table out of "freeMap".
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSector(int n, int sector, BitMap *freeMap)
+{
+    ASSERT(n >= 0 && n < MaxFileSectors);
+    if (n < NumDirectI) {
+        dataSectors[n] = sector;
+        return;
+    }
+    n -= NumDirectI;
+    if (n < NumDirectII) {
+        if (n == 0) {
+            indirect = NewIndex(freeMap);
+            dataSectors[IndirectIndex] = indirect->sector;
+        } else if (indirect == NULL)
+            indirect = LoadIndex(dataSectors[IndirectIndex]);
+        indirect->entries[n] = sector;
+        indirect->dirty = TRUE;
+        return;
+    }
+    n -= NumDirectII;
+    if (n == 0) {
+        doublyIndirect = NewIndex(freeMap);
+        dataSectors[DoublyIndirectIndex] = doublyIndirect->sector;
+    } else if (doublyIndirect == NULL)
+        doublyIndirect = LoadIndex(dataSectors[DoublyIndirectIndex]);
+    if (secondLevel == NULL) {
+        secondLevel = new IndexTable *[NumDirectII];
+        for (int j = 0; j < NumDirectII; j++)
+            secondLevel[j] = NULL;
     }
+    int i = n / NumDirectII;
+    if (n % NumDirectII == 0) {
+        secondLevel[i] = NewIndex(freeMap);
+        doublyIndirect->entries[i] = secondLevel[i]->sector;
+        doublyIndirect->dirty = TRUE;
+    } else if (secondLevel[i] == NULL)
+        secondLevel[i] = LoadIndex(doublyIndirect->entries[i]);
+    secondLevel[i]->entries[n % NumDirectII] = sector;
+    secondLevel[i]->dirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex / NewIndex / FlushIndex / DropIndexCache
+// 	Manage the in-memory copies of this file's index tables.
+//----------------------------------------------------------------------
+
+IndexTable *
+FileHeader::LoadIndex(int sector)
+{
+    IndexTable *table = new IndexTable;
+
+    table->sector = sector;
+    table->dirty = FALSE;
+    synchDisk->ReadSector(sector, (char *)table->entries);
+    return table;
+}
+
+IndexTable *
+FileHeader::NewIndex(BitMap *freeMap)
+{
+    IndexTable *table = new IndexTable;
+
+    table->sector = freeMap->Find();
+    ASSERT(table->sector != -1);	// GrowTo counted it already
+    table->dirty = TRUE;
+    bzero(table->entries, sizeof(table->entries));
+    return table;
+}
+
+void
+FileHeader::FlushIndex(IndexTable *table)
+{
+    if (table != NULL && table->dirty) {
+        synchDisk->WriteSector(table->sector, (char *)table->entries);
+        table->dirty = FALSE;
+    }
+}
+
+void
+FileHeader::DropIndexCache()
+{
+    delete indirect;
+    delete doublyIndirect;
+    if (secondLevel != NULL) {
+        for (int i = 0; i < NumDirectII; i++)
+            delete secondLevel[i];
+        delete [] secondLevel;
+    }
+    indirect = doublyIndirect = NULL;
+    secondLevel = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -208,60 +442,139 @@ FileHeader::Print()
 {
     int i, j, k;
     char *data = new char[SectorSize];
-    numSectors  = divRoundUp(numBytes, SectorSize);
 
     printf("FileHeader contents:\n");
     printf("File Creation Time: %s", ctime(&createTime));
     printf("File Last Access Time: %s", ctime(&lastAccessTime));
     printf("File Last Modify Time: %s", ctime(&lastModifyTime));
     printf("File size: %d\nFile blocks:\n", numBytes);
-    for (i = k = 0; i < min(numSectors, NumDirectI); i++, k++)
-	printf("%d ", dataSectors[i]);
-
-    if (numSectors > NumDirectI){
-        int secondaryTableNum = divRoundUp((numSectors - NumDirectI), NumDirectII);
-        int secondaryIndexTable[NumDirectII];
-        for (j=0; j<secondaryTableNum; ++j){
-            // read secondary index table to memory
-            SetLastAccessTime();
-            synchDisk->ReadSector((int) dataSectors[NumDirectI + j], (char *)secondaryIndexTable);
-            for (i = 0; i < NumDirectII && k < numSectors; i++, k++) {
-                printf("%d ", secondaryIndexTable[i]);
-            }
-        }
-    }
+    for (i = 0; i < numSectors; i++)
+	printf("%d ", GetSector(i));
     printf("\nFile contents:\n");
-    for (i = k = 0; i < min(numSectors, NumDirectI); i++) {
-	    synchDisk->ReadSector(dataSectors[i], data);
+    for (i = k = 0; i < numSectors; i++) {
+	synchDisk->ReadSector(GetSector(i), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-    	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-    		    printf("%c", data[j]);
+	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
+		printf("%c", data[j]);
             else
-    		    printf("\\%x", (unsigned char)data[j]);
-	    }
+		printf("\\%x", (unsigned char)data[j]);
+	}
         printf("\n"); 
     }
-    if (numSectors > NumDirectI){
-        int secondaryTableNum = divRoundUp((numSectors - NumDirectI), NumDirectII);
-        int secondaryIndexTable[NumDirectII];
-        for (int t=0; t<secondaryTableNum; ++t){
-            // read secondary index table to memory
-            SetLastAccessTime();
-            synchDisk->ReadSector((int) dataSectors[NumDirectI + t], (char *)secondaryIndexTable);
-            
-            for (i = 0; i < NumDirectII; i++) {
-                synchDisk->ReadSector(secondaryIndexTable[i], data);
-                for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-                    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-                        printf("%c", data[j]);
-                    else
-                        printf("\\%x", (unsigned char)data[j]);
-                }
-                printf("\n"); 
-                if (k >= numBytes) break;
-            }
-        }
-    }
-    printf("\n");
     delete [] data;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::FileHeaderCache
+// 	Initialize an empty i-node table.
+//----------------------------------------------------------------------
+
+FileHeaderCache::FileHeaderCache()
+{
+    for (int i = 0; i < NumSectors; i++) {
+        table[i].hdr = NULL;
+        table[i].refCount = 0;
+        table[i].dirty = FALSE;
+    }
+    lock = new Lock("file header cache");
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::~FileHeaderCache
+// 	Drop every cached header.  Lazy updates of headers that are still
+//	open are lost.
+//----------------------------------------------------------------------
+
+FileHeaderCache::~FileHeaderCache()
+{
+    for (int i = 0; i < NumSectors; i++)
+        delete table[i].hdr;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::Acquire
+// 	Return the shared in-memory header stored at "sector", reading it
+//	from disk the first time, and count one more user of it.
+//----------------------------------------------------------------------
+
+FileHeader *
+FileHeaderCache::Acquire(int sector)
+{
+    FileHeaderCacheEntry *e;
+
+    ASSERT(sector >= 0 && sector < NumSectors);
+    e = &table[sector];
+    lock->Acquire();
+    if (e->hdr == NULL) {
+        e->hdr = new FileHeader;
+        e->hdr->FetchFrom(sector);
+        e->hdr->SetHdrSector(sector);
+        e->dirty = FALSE;
+    }
+    e->refCount++;
+    lock->Release();
+    return e->hdr;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::Release
+// 	One less user of "hdr".  The last one to let go writes back any
+//	timestamp updates that were deferred by MarkDirty.
+//----------------------------------------------------------------------
+
+void
+FileHeaderCache::Release(FileHeader *hdr)
+{
+    FileHeaderCacheEntry *e = &table[hdr->GetHdrSector()];
+
+    ASSERT(e->hdr == hdr && e->refCount > 0);
+    lock->Acquire();
+    if (--e->refCount == 0 && e->dirty) {
+        synchDisk->WriteSector(hdr->GetHdrSector(), (char *)hdr);
+        e->dirty = FALSE;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::MarkDirty
+// 	Note that "hdr" has changed in a way that can be written back 
+//	later (timestamps).
+//----------------------------------------------------------------------
+
+void
+FileHeaderCache::MarkDirty(FileHeader *hdr)
+{
+    table[hdr->GetHdrSector()].dirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::IsOpen
+// 	Return TRUE if some OpenFile is using the header at "sector".
+//----------------------------------------------------------------------
+
+bool
+FileHeaderCache::IsOpen(int sector)
+{
+    return table[sector].refCount > 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderCache::Forget
+// 	The file whose header was at "sector" has been removed; drop the
+//	cached copy so that a new file there is read fresh.
+//----------------------------------------------------------------------
+
+void
+FileHeaderCache::Forget(int sector)
+{
+    FileHeaderCacheEntry *e = &table[sector];
+
+    ASSERT(e->refCount == 0);
+    lock->Acquire();
+    delete e->hdr;
+    e->hdr = NULL;
+    e->dirty = FALSE;
+    lock->Release();
+}
@@ -19,28 +19,48 @@
 #include <time.h>
 // used to be ((SectorSize - 2 * sizeof(int)) / sizeof(int))
 #define NumDirect 	((SectorSize - 3 * sizeof(int) - 3 * sizeof(time_t)) / sizeof(int))
-#define NumDirectTable 3   // # of secondary index table
-#define NumDirectI  (NumDirect - NumDirectTable) // # of direct index
-#define NumDirectII (SectorSize / sizeof(int))  // how many entries in secondary index table
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumDirectI  ((int) NumDirect - 2)   // # of direct index
+#define IndirectIndex   NumDirectI      // dataSectors[] slot of the single
+                                        //  indirect table
+#define DoublyIndirectIndex (NumDirectI + 1)  // dataSectors[] slot of the
+                                        //  doubly indirect table
+#define NumDirectII ((int) (SectorSize / sizeof(int)))  // how many entries
+                                        //  in an index table
+#define MaxFileSectors  (NumDirectI + NumDirectII + NumDirectII * NumDirectII)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
+
+// An index table (single indirect, doubly indirect, or one of the tables
+// the doubly indirect table points to), cached in memory while the file
+// header is in use so that ByteToSector does not go to disk.
+
+class IndexTable {
+  public:
+    int sector;                         // where the table lives on disk
+    bool dirty;                         // modified since it was read?
+    int entries[NumDirectII];           // sector numbers
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of pointers to data blocks:
+// the first NumDirectI entries point directly to data, the next one to
+// a single indirect table, and the last one to a doubly indirect table.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// that we assume the size of the on-disk part of this data structure
+// (everything up to and including dataSectors) to be the same
+// as one disk sector.  The index table cache that follows it is only
+// ever kept in memory.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// A file header is initialized either by allocating blocks for the file
+// (if it is a new file), or by reading it from disk.
 
 class FileHeader {
   public:
+    FileHeader();			// An empty file header
+    ~FileHeader();			// Release the index table cache
+
     bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
@@ -60,17 +80,18 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
-    bool Extend(BitMap *bitMap, int newSize);
-    void SetDataSector(int idx, int val){ 
-        dataSectors[idx] = val;
-    }
+    bool Extend(BitMap *bitMap, int newSize);	// Grow the file to "newSize"
+						//  bytes, allocating data and
+						//  index blocks as needed
+    int MarkSectors(BitMap *used);	// Mark the data and index blocks
+					//  in "used"; return the number 
+					//  of problems found
     //-----lab 5------
     void SetCreateTime(){time(&createTime);}
     void SetLastAccessTime(){time(&lastAccessTime);}
     void SetLastModifyTime(){time(&lastModifyTime);}
     void SetHdrSector(int sec){hdrSector = sec;}
     int GetHdrSector(){return hdrSector;}
-    void UpdateBytes(int bytes){numBytes += bytes;}
     //----end lab 5---
   private:
     int numBytes;			// Number of bytes in the file
@@ -83,7 +104,62 @@ class FileHeader {
     //----end lab 5---
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
-    
+
+    // in memory only -- must stay after dataSectors
+    IndexTable *indirect;		// cached single indirect table
+    IndexTable *doublyIndirect;		// cached doubly indirect table
+    IndexTable **secondLevel;		// cached tables the doubly 
+					//  indirect table points to
+
+    bool GrowTo(BitMap *freeMap, int sectors);	// Allocate data blocks 
+						//  up to "sectors"
+    int GetSector(int n);		// Sector holding data block "n"
+    void SetSector(int n, int sector, BitMap *freeMap);
+    IndexTable *LoadIndex(int sector);	// Read an index table from disk
+    IndexTable *NewIndex(BitMap *freeMap);	// Allocate an empty table
+    void FlushIndex(IndexTable *table);	// Write back "table" if dirty
+    void DropIndexCache();		// Forget all cached tables
+};
+
+int IndexSectors(int numSectors);	// # of index tables needed to 
+					//  address "numSectors" blocks
+
+// The following class is the in-memory i-node table: one shared
+// FileHeader per header sector, reference counted by the OpenFiles
+// using it.  All the OpenFiles on a file see the same length and
+// block map, and opening a file whose header is cached costs no disk
+// read.  Headers stay cached after the last close until the file is
+// removed.
+//
+// Changes that only touch timestamps mark the header dirty; it is
+// written back when the last OpenFile on it is closed.  Changes to
+// the block map are still written through by the caller (WriteBack).
+
+class FileHeaderCacheEntry {
+  public:
+    FileHeader *hdr;			// NULL if not cached
+    int refCount;			// # of OpenFiles using hdr
+    bool dirty;				// timestamps not yet on disk
+};
+
+class Lock;
+
+class FileHeaderCache {
+  public:
+    FileHeaderCache();			// An empty table
+    ~FileHeaderCache();
+
+    FileHeader *Acquire(int sector);	// Get the header at "sector", 
+					//  reading it if not cached
+    void Release(FileHeader *hdr);	// Done with "hdr"; write back 
+					//  lazy updates on the last release
+    void MarkDirty(FileHeader *hdr);	// "hdr" has lazy updates
+    bool IsOpen(int sector);		// Is the header in use?
+    void Forget(int sector);		// The file at "sector" is gone
+
+  private:
+    FileHeaderCacheEntry table[NumSectors];
+    Lock *lock;				// Mutual exclusion on the table
 };
 
 #endif // FILEHDR_H
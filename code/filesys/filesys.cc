@@ -10,7 +10,8 @@
 //	   An entry in the file system directory
 //
 // 	The file system consists of several data structures:
-//	   A bitmap of free disk sectors (cf. bitmap.h)
+//	   A bitmap of free disk sectors (cf. freemap.h), kept in memory
+//	     while the file system is mounted
 //	   A directory of file names and file headers
 //
 //      Both the bitmap and the directory are represented as normal
@@ -23,21 +24,21 @@
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back (the two files are kept open during all this
+//	time).  If the operation fails, and we have modified part of the
+//	directory and/or bitmap, we simply discard the changed version,
+//	without writing it back to disk.
+//
+//	Each such operation is a journal operation (cf. journal.h): its
+//	writes reach the disk together, through a log on the last track,
+//	so if Nachos exits in the middle of an operation the file system
+//	is still consistent after the next mount.  Only metadata is
+//	journaled; file data may be lost in a crash.
 //
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   files cannot be bigger than MaxFileSize (larger than the disk)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -47,10 +48,12 @@
 
 #include "disk.h"
 #include "synchdisk.h"
-#include "bitmap.h"
+#include "freemap.h"
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -58,12 +61,17 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 //#define NumDirEntries 		10   // now defined in directory.h 
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+					// directories grow from here
+
+// How much Create allocates inside its own journal operation, and how
+// many sectors Extend adds per operation, so that no operation writes
+// more than MaxOpBlocks sectors of metadata.
+#define CreateInlineSize	(NumDirectI * SectorSize)
+#define ExtendChunkSectors	64
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -72,7 +80,8 @@
 //	an empty directory, and a bitmap of free sectors (with almost but
 //	not all of the sectors marked as free).  
 //
-//	If format = FALSE, we just have to open the files
+//	If format = FALSE, we first replay the journal, in case Nachos
+//	crashed in the middle of a commit, and then open the files
 //	representing the bitmap and the directory.
 //
 //	"format" -- should we initialize the disk?
@@ -82,8 +91,11 @@ extern SynchDisk   *synchDisk;
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    dentryCache = new DentryCache;
+    freeMap = new FreeMap(NumSectors);
+    freeMapLock = new Lock("free map");
+    journal = new Journal(freeMap, freeMapLock);
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	    FileHeader *mapHdr = new FileHeader;
 	    FileHeader *dirHdr = new FileHeader;
@@ -94,6 +106,8 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	for (int i = JournalStart; i < NumSectors; i++)
+	    freeMap->Mark(i);		// the log
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -110,6 +124,8 @@ FileSystem::FileSystem(bool format)
     // ---- lab 5 ----
     mapHdr->SetCreateTime();
     dirHdr->SetCreateTime();
+    mapHdr->SetHdrSector(FreeMapSector);
+    dirHdr->SetHdrSector(DirectorySector);
     // --end lab 5 ----
 
         DEBUG('f', "Writing headers back to disk.\n");
@@ -132,29 +148,173 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
 	freeMap->WriteBack(freeMapFile);	 // flush changes to disk
 	directory->WriteBack(directoryFile);
+	journal->Format();
 
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
 
-        delete freeMap; 
     	delete directory; 
     	delete mapHdr; 
     	delete dirHdr;
 	}
     } else {
-    // if we are not formatting the disk, just open the files representing
-    // the bitmap and directory; these are left open while Nachos is running
+    // if we are not formatting the disk, finish the last commit if need
+    // be, then just open the files representing the bitmap and directory;
+    // these are left open while Nachos is running
+        if (!journal->Recover())
+            DEBUG('f', "No journal on this disk.\n");
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap->FetchFrom(freeMapFile);
+    }
+    freeMap->HoldFreed(journal->IsEnabled());
+    synchDisk->SetJournal(journal);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Walk "path" from the root directory and return the sector of its
+//	file header, or -1 if some component does not exist.  The walk
+//	starts from the longest prefix of "path" found in the dentry
+//	cache, and every directory read on the way is cached in turn.
+//
+//	"path" -- components separated by '/'
+//	"isDir" -- if not NULL, set to whether "path" is a directory
+//----------------------------------------------------------------------
+
+int
+FileSystem::Lookup(char *path, bool *isDir)
+{
+    char name[FileLongNameMaxLen + 1];
+    int len, start, sector = DirectorySector;
+    bool dir = TRUE;
+
+    while (*path == '/')
+        path++;
+    len = strlen(path);
+
+    // find the longest cached prefix that ends at a component boundary
+    for (start = len; start > 0; start--)
+        if ((start == len || path[start] == '/') 
+                && dentryCache->Lookup(path, start, &sector, &dir))
+            break;
+    if (start == 0) {
+        sector = DirectorySector;
+        dir = TRUE;
+    }
+
+    while (start < len) {
+        int end;
+
+        if (path[start] == '/') {
+            start++;
+            continue;
+        }
+        for (end = start; end < len && path[end] != '/'; end++)
+            ;
+        if (!dir || end - start > FileLongNameMaxLen)
+            return -1;
+        strncpy(name, path + start, end - start);
+        name[end - start] = '\0';
+
+        OpenFile *dirFile = OpenDirectory(sector);
+        Directory *directory = new Directory(NumDirEntries);
+        directory->FetchFrom(dirFile);
+        sector = directory->Find(name, &dir);
+        delete directory;
+        CloseDirectory(dirFile);
+        if (sector == -1)
+            return -1;
+        dentryCache->Insert(path, end, sector, dir);
+        start = end;
+    }
+    if (isDir != NULL)
+        *isDir = dir;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookupParent
+// 	Return the header sector of the directory that holds "path",
+//	copying the last component of "path" into "leaf".  Return -1 if
+//	the directory does not exist.
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookupParent(char *path, char *leaf)
+{
+    char *slash = strrchr(path, '/');
+    int sector;
+    bool isDir;
+
+    if (slash == NULL) {
+        if (strlen(path) > FileLongNameMaxLen)
+            return -1;
+        strcpy(leaf, path);
+        return DirectorySector;
+    }
+    if (strlen(slash + 1) > FileLongNameMaxLen)
+        return -1;
+    strcpy(leaf, slash + 1);
+
+    char *parent = new char[slash - path + 1];
+    strncpy(parent, path, slash - path);
+    parent[slash - path] = '\0';
+    sector = Lookup(parent, &isDir);
+    delete [] parent;
+    if (sector == -1 || !isDir)
+        return -1;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenDirectory / CloseDirectory
+// 	The root directory is kept open; others are opened on demand.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::OpenDirectory(int sector)
+{
+    if (sector == DirectorySector)
+        return directoryFile;
+    return new OpenFile(sector);
+}
+
+void
+FileSystem::CloseDirectory(OpenFile *file)
+{
+    if (file != directoryFile)
+        delete file;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteBackDirectory
+// 	Write "directory" back to "file", first growing the file (out of
+//	"map", which the caller writes back) if entries were added.
+//	Return FALSE if there is no room on disk.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::WriteBackDirectory(Directory *directory, OpenFile *file, 
+                                BitMap *map)
+{
+    if (directory->Size() > file->Length()) {
+        if (!file->ExtendHdr(map, directory->Size()))
+            return FALSE;
+        file->WriteBackHdr();
     }
+    directory->WriteBack(file);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	Files grow as they are written, but Create can be given an 
+//	initial size to allocate up front.  Beyond CreateInlineSize, the
+//	initial size is allocated by Extend, in operations of its own; if
+//	that runs out of space, the file is removed again.
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
@@ -168,8 +328,8 @@ FileSystem::FileSystem(bool format)
 //
 // 	Create fails if:
 //   		file is already in directory
+//		the directory holding it does not exist
 //	 	no free space for file header
-//	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
 // 	Note that this implementation assumes there is no concurrent access
@@ -177,42 +337,56 @@ FileSystem::FileSystem(bool format)
 //
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
+//	"dir" -- create a directory instead of a file
 //----------------------------------------------------------------------
 
 bool
 FileSystem::Create(char *name, int initialSize, bool dir)
 {
+    char leaf[FileLongNameMaxLen + 1];
     Directory *directory;
-    BitMap *freeMap;
+    OpenFile *parentFile;
     FileHeader *hdr;
-    int sector;
+    int sector, parentSector;
     bool success;
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
+    while (*name == '/')
+        name++;
+    parentSector = LookupParent(name, leaf);
+    if (parentSector == -1)
+        return FALSE;			// no such directory
+    journal->BeginOp();
+    parentFile = OpenDirectory(parentSector);
     directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    directory->FetchFrom(parentFile);
 
     if (dir)
         initialSize = DirectoryFileSize;
 
-    if (directory->Find(name) != -1){
+    if (directory->Find(leaf) != -1){
         success = FALSE;			// file is already in directory
     }
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
+        freeMapLock->Acquire();
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector, dir)){
-            success = FALSE;	// no space in directory
+        else if (!directory->Add(leaf, sector, dir)){
+            freeMap->Clear(sector);
+            success = FALSE;	// bad name
         }
     	else {
             hdr = new FileHeader;
-    	    if (!hdr->Allocate(freeMap, initialSize))
+    	    if (!hdr->Allocate(freeMap, min(initialSize, CreateInlineSize))) {
+                freeMap->Clear(sector);
                 success = FALSE;	// no space on disk for data
-    	    else {	
+            } else if (!WriteBackDirectory(directory, parentFile, freeMap)) {
+                hdr->Deallocate(freeMap);
+                freeMap->Clear(sector);
+                success = FALSE;	// no space to grow the directory
+    	    } else {	
     	    	success = TRUE;
                 // ---- lab 5 ----
                 hdr->SetCreateTime();
@@ -220,20 +394,32 @@ FileSystem::Create(char *name, int initialSize, bool dir)
                 // --end lab 5 ----
     		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
     	    	freeMap->WriteBack(freeMapFile);
                 // if create a new directory, we should initialize this directory
                 if (dir){
                     Directory *newdirectory = new Directory(NumDirEntries);
                     OpenFile *newdirectoryFile = new OpenFile(sector);
                     newdirectory->WriteBack(newdirectoryFile);
+                    delete newdirectoryFile;
+                    delete newdirectory;
                 }
+                dentryCache->Invalidate(name);
     	    }
             delete hdr;
     	}
-        delete freeMap;
+        freeMapLock->Release();
     }
     delete directory;
+    CloseDirectory(parentFile);
+    journal->EndOp();
+
+    if (success && initialSize > CreateInlineSize) {
+        OpenFile *openFile = new OpenFile(sector);
+        success = Extend(openFile, initialSize);
+        delete openFile;
+        if (!success)
+            Remove(name);
+    }
     return success;
 }
 
@@ -250,16 +436,13 @@ FileSystem::Create(char *name, int initialSize, bool dir)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
+    sector = Lookup(name, NULL); 
     if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
     return openFile;				// return NULL if not found
 }
 
@@ -280,38 +463,52 @@ FileSystem::Open(char *name)
 bool
 FileSystem::Remove(char *name)
 { 
+    char leaf[FileLongNameMaxLen + 1];
     Directory *directory;
-    BitMap *freeMap;
+    OpenFile *parentFile;
     FileHeader *fileHdr;
-    int sector;
+    int sector, parentSector;
     
+    while (*name == '/')
+        name++;
+    parentSector = LookupParent(name, leaf);
+    if (parentSector == -1)
+        return FALSE;			// no such directory
+    journal->BeginOp();
+    parentFile = OpenDirectory(parentSector);
     directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
+    directory->FetchFrom(parentFile);
+    sector = directory->Find(leaf);
     if (sector == -1) {
        delete directory;
+       CloseDirectory(parentFile);
+       journal->EndOp();
        return FALSE;			 // file not found 
     }
-    if (!synchDisk->CountZero(sector))
+    if (fileHeaderCache->IsOpen(sector))
     {
         printf("can't remove because it is still opened by some other thread\n");
+        delete directory;
+        CloseDirectory(parentFile);
+        journal->EndOp();
         return FALSE;
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
-
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+    fileHdr = fileHeaderCache->Acquire(sector);
 
+    freeMapLock->Acquire();
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
+    directory->Remove(leaf);
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
-    delete fileHdr;
+    freeMapLock->Release();
+    directory->WriteBack(parentFile);		// flush to disk
+    dentryCache->Invalidate(name);
+    fileHeaderCache->Release(fileHdr);
+    fileHeaderCache->Forget(sector);
     delete directory;
-    delete freeMap;
+    CloseDirectory(parentFile);
+    journal->EndOp();
     return TRUE;
 } 
 
@@ -345,7 +542,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
@@ -356,56 +552,153 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
+    freeMapLock->Acquire();
     freeMap->Print();
+    freeMapLock->Release();
 
     directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
 
-bool FileSystem::Extend(OpenFile* openfile, int newSize){
-    int numBytes = openfile->Length();
-    int curSize = numBytes + newSize;
-    int curSectorNum = divRoundUp(curSize, SectorSize);
-    int oldSectorNum = divRoundUp(numBytes, SectorSize);
-    if (oldSectorNum == curSectorNum){
-        // we do not need to allocate new sector
-        // but have to update numBytes
-        openfile->UpdateBytes(newSize);
-        openfile->WriteBackHdr();
-        return TRUE;
-    }
-    int newSectorsNum = curSectorNum - oldSectorNum;
-    BitMap *freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+//----------------------------------------------------------------------
+// FileSystem::Extend
+// 	Grow an open file to "newLength" bytes, allocating new data blocks
+//	(and single or doubly indirect index tables) from the free map.
+//	Return FALSE if the disk is full or the file would exceed 
+//	MaxFileSize.
+//
+//	The file grows by at most ExtendChunkSectors per journal
+//	operation; if the disk fills up part way, the file keeps what
+//	was allocated before.
+//
+//	"openfile" -- the file to grow
+//	"newLength" -- the new length of the file, in bytes
+//----------------------------------------------------------------------
 
-    if (freeMap->NumClear() < newSectorsNum){
-        delete freeMap;
+bool
+FileSystem::Extend(OpenFile* openfile, int newLength)
+{
+    bool success = TRUE;
+
+    DEBUG('f', "Extending file to %d bytes\n", newLength);
+    if (newLength > MaxFileSize)
         return FALSE;
+    while (success && openfile->Length() < newLength) {
+        int length = min(newLength, (divRoundUp(openfile->Length(), 
+                        SectorSize) + ExtendChunkSectors) * SectorSize);
+
+        journal->BeginOp();
+        freeMapLock->Acquire();
+        success = openfile->ExtendHdr(freeMap, length);
+        if (success) {
+            openfile->WriteBackHdr();
+            freeMap->WriteBack(freeMapFile);
+        }
+        freeMapLock->Release();
+        journal->EndOp();
     }
+    return success;
+}
 
-    if (curSectorNum < NumDirectI){
-        for (int i = 0; i < newSectorsNum; ++i){
-            int newsector = freeMap->Find();
-            openfile->SetDataSector(oldSectorNum + i, newsector);
-            printf("allocating sector %d to file\n", newsector);
-        }
-        openfile->UpdateBytes(newSize);
-        freeMap->WriteBack(freeMapFile);
-        openfile->WriteBackHdr();
-        delete freeMap;
-        return TRUE;
+//----------------------------------------------------------------------
+// FileSystem::BeginBatch / EndBatch
+// 	Let the operations in between share journal commits.  Nothing
+//	is guaranteed to be on disk until EndBatch returns.
+//----------------------------------------------------------------------
+
+void
+FileSystem::BeginBatch()
+{
+    journal->BeginBatch();
+}
+
+void
+FileSystem::EndBatch()
+{
+    journal->EndBatch();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check the file system, like UNIX fsck: walk the directory tree
+//	from the root, marking the sectors used by every file, and
+//	compare the result with the free map.  Report sectors used twice
+//	or marked free while in use, and sectors allocated but not used
+//	by any file.  Return the number of problems found.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Check()
+{
+    BitMap *used = new BitMap(NumSectors);
+    int problems = 0, leaked = 0, inUse = 0;
+
+    if (journal->IsEnabled())
+        for (int i = JournalStart; i < NumSectors; i++)
+            used->Mark(i);
+    problems += CheckTree(FreeMapSector, FALSE, used);
+    problems += CheckTree(DirectorySector, TRUE, used);
+
+    freeMapLock->Acquire();
+    for (int i = 0; i < NumSectors; i++) {
+        if (used->Test(i)) {
+            inUse++;
+            if (!freeMap->Test(i)) {
+                printf("Check: sector %d is in use but free\n", i);
+                problems++;
+            }
+        } else if (freeMap->Test(i))
+            leaked++;
     }
-    else {
-        // using secondary index
-        // not implemented yet;
-        delete freeMap;
-        return FALSE;
+    freeMapLock->Release();
+    if (leaked > 0) {
+        printf("Check: %d sectors allocated but not in use\n", leaked);
+        problems++;
+    }
+    printf("Check: %d sectors in use, %d problems\n", inUse, problems);
+    delete used;
+    return problems;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CheckTree
+// 	Mark the header and blocks of the file at "sector" in "used",
+//	and if it is a directory, those of everything below it.  Return
+//	the number of problems found.
+//----------------------------------------------------------------------
+
+int
+FileSystem::CheckTree(int sector, bool isDir, BitMap *used)
+{
+    FileHeader *hdr;
+    int problems;
+
+    if (sector < 0 || sector >= NumSectors || used->Test(sector)) {
+        printf("Check: bad or shared header sector %d\n", sector);
+        return 1;
     }
+    used->Mark(sector);
+    hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    problems = hdr->MarkSectors(used);
+    delete hdr;
+    if (isDir && problems == 0) {
+        OpenFile *dirFile = OpenDirectory(sector);
+        Directory *directory = new Directory(NumDirEntries);
 
-}
\ No newline at end of file
+        directory->FetchFrom(dirFile);
+        for (int i = 0; i < directory->NumEntries(); i++) {
+            bool dir;
+            int child = directory->EntrySector(i, &dir);
+            if (child != -1)
+                problems += CheckTree(child, dir, used);
+        }
+        delete directory;
+        CloseDirectory(dirFile);
+    }
+    return problems;
+}
@@ -65,6 +65,13 @@ class FileSystem {
 };
 
 #else // FILESYS
+class BitMap;
+class FreeMap;
+class Lock;
+class Directory;
+class DentryCache;
+class Journal;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -84,13 +91,37 @@ class FileSystem {
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
-    bool Extend(OpenFile* openfile, int newSize);
+    bool Extend(OpenFile* openfile, int newLength);
+					// Grow an open file
+
+    void BeginBatch();			// Group the metadata updates of
+    void EndBatch();			//  the operations in between
+    int Check();			// Check the file system for 
+					//  consistency (UNIX fsck)
 
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   FreeMap *freeMap;			// In-memory copy of freeMapFile
+   Lock *freeMapLock;			// Protects freeMap
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   DentryCache *dentryCache;		// Cache of path -> header sector
+   Journal *journal;			// Log of metadata updates
+
+   int Lookup(char *path, bool *isDir);	// Header sector of "path", or -1
+   int LookupParent(char *path, char *leaf);
+					// Header sector of the directory 
+					//  holding "path", or -1
+   OpenFile *OpenDirectory(int sector);	// Open a directory file
+   void CloseDirectory(OpenFile *file);
+   bool WriteBackDirectory(Directory *directory, OpenFile *file, 
+                                BitMap *map);
+					// Grow the directory file if 
+					//  needed, and write it back
+   int CheckTree(int sector, bool isDir, BitMap *used);
+					// Check the file at "sector" and
+					//  everything below it
 };
 
 #endif // FILESYS
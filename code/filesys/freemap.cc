@@ -0,0 +1,219 @@
+// freemap.cc
+//	Routines to manage the in-memory map of free disk sectors.
+//
+//	Every change to the map goes through Mark or Clear, which keep
+//	the per-track free counts and the dirty sector flags up to date.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "freemap.h"
+
+//----------------------------------------------------------------------
+// FreeMap::FreeMap
+// 	Initialize a free map with "nitems" sectors, all of them free.
+//----------------------------------------------------------------------
+
+FreeMap::FreeMap(int nitems) : BitMap(nitems)
+{
+    numTracks = divRoundUp(numBits, SectorsPerTrack);
+    trackFree = new int[numTracks];
+    numMapSectors = divRoundUp(numWords * sizeof(unsigned int), SectorSize);
+    dirty = new bool[numMapSectors];
+    for (int i = 0; i < numMapSectors; i++)
+        dirty[i] = TRUE;
+    cursor = 0;
+    freed = NULL;
+    numFreed = 0;
+    Recount();
+}
+
+//----------------------------------------------------------------------
+// FreeMap::~FreeMap
+//----------------------------------------------------------------------
+
+FreeMap::~FreeMap()
+{
+    delete [] trackFree;
+    delete [] dirty;
+    delete [] freed;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Recount
+// 	Recompute the free counts after the whole map has been replaced.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Recount()
+{
+    numClear = 0;
+    for (int t = 0; t < numTracks; t++)
+        trackFree[t] = 0;
+    for (int i = 0; i < numBits; i++)
+        if (!Test(i)) {
+            numClear++;
+            trackFree[i / SectorsPerTrack]++;
+        }
+}
+
+//----------------------------------------------------------------------
+// FreeMap::SetDirty
+// 	Remember that the sector of the bitmap file holding the bit for
+//	"which" has to be written back.
+//----------------------------------------------------------------------
+
+void
+FreeMap::SetDirty(int which)
+{
+    dirty[(which / BitsInByte) / SectorSize] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Mark / Clear
+// 	Allocate or free sector "which".  A sector freed while freed
+//	sectors are held does not count as free until ReleaseFreed.
+//----------------------------------------------------------------------
+
+void
+FreeMap::Mark(int which)
+{
+    if (freed != NULL && freed[which]) {
+        freed[which] = FALSE;
+        numFreed--;
+        BitMap::Mark(which);
+        SetDirty(which);
+    } else if (!Test(which)) {
+        BitMap::Mark(which);
+        numClear--;
+        trackFree[which / SectorsPerTrack]--;
+        SetDirty(which);
+    }
+}
+
+void
+FreeMap::Clear(int which)
+{
+    if (Test(which)) {
+        BitMap::Clear(which);
+        SetDirty(which);
+        if (freed != NULL) {
+            freed[which] = TRUE;
+            numFreed++;
+        } else {
+            numClear++;
+            trackFree[which / SectorsPerTrack]++;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// FreeMap::HoldFreed
+// 	Start or stop holding back freed sectors.  The journal turns
+//	this on, so that a sector freed by an operation is not reused,
+//	and overwritten by file data, before the operation is on disk.
+//----------------------------------------------------------------------
+
+void
+FreeMap::HoldFreed(bool on)
+{
+    if (on && freed == NULL) {
+        freed = new bool[numBits];
+        for (int i = 0; i < numBits; i++)
+            freed[i] = FALSE;
+        numFreed = 0;
+    } else if (!on && freed != NULL) {
+        ReleaseFreed();
+        delete [] freed;
+        freed = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// FreeMap::ReleaseFreed
+// 	Make the sectors held back since the last call free for Find.
+//----------------------------------------------------------------------
+
+void
+FreeMap::ReleaseFreed()
+{
+    if (freed == NULL || numFreed == 0)
+        return;
+    for (int i = 0; i < numBits; i++)
+        if (freed[i]) {
+            freed[i] = FALSE;
+            numClear++;
+            trackFree[i / SectorsPerTrack]++;
+        }
+    numFreed = 0;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Find
+// 	Allocate a free sector, starting from where the last allocation
+//	left off and skipping tracks that are full (or hold only sectors
+//	that are held back).  Return -1 if the
+//	disk is full.
+//----------------------------------------------------------------------
+
+int
+FreeMap::Find()
+{
+    int track = cursor / SectorsPerTrack;
+
+    if (numClear == 0)
+        return -1;
+    // the starting track is visited twice, in case its free sectors
+    // are all before the cursor
+    for (int n = 0; n <= numTracks; n++, track = (track + 1) % numTracks) {
+        if (trackFree[track] == 0)
+            continue;
+        int first = (n == 0) ? cursor : track * SectorsPerTrack;
+        int last = min((track + 1) * SectorsPerTrack, numBits);
+        for (int i = first; i < last; i++)
+            if (!Test(i) && (freed == NULL || !freed[i])) {
+                Mark(i);
+                cursor = (i + 1) % numBits;
+                return i;
+            }
+    }
+    ASSERT(FALSE);			// numClear says there is one
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::FetchFrom
+// 	Read the whole map from "file".
+//----------------------------------------------------------------------
+
+void
+FreeMap::FetchFrom(OpenFile *file)
+{
+    BitMap::FetchFrom(file);
+    for (int i = 0; i < numMapSectors; i++)
+        dirty[i] = FALSE;
+    cursor = 0;
+    Recount();
+}
+
+//----------------------------------------------------------------------
+// FreeMap::WriteBack
+// 	Write back only the sectors of the map that changed since the
+//	last FetchFrom or WriteBack.
+//----------------------------------------------------------------------
+
+void
+FreeMap::WriteBack(OpenFile *file)
+{
+    int size = numWords * sizeof(unsigned int);
+
+    for (int i = 0; i < numMapSectors; i++)
+        if (dirty[i]) {
+            int offset = i * SectorSize;
+            file->WriteAt((char *)map + offset,
+                                min(SectorSize, size - offset), offset);
+            dirty[i] = FALSE;
+        }
+}
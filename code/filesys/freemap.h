@@ -0,0 +1,62 @@
+// freemap.h
+//	Data structures for the file system's map of free disk sectors.
+//
+//	The free map is a bitmap that is kept in memory for as long as
+//	the file system is mounted.  On top of the plain bitmap it keeps
+//	a count of free sectors per track, so that allocation can skip
+//	full tracks, and a record of which sectors of the bitmap file
+//	changed, so that only those are written back.
+//
+//	While the journal is on, sectors that are freed are held back
+//	from Find until the operation that freed them is committed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef FREEMAP_H
+#define FREEMAP_H
+
+#include "bitmap.h"
+#include "disk.h"
+
+// The following class defines the free sector map.  Find allocates
+// next-fit: it starts looking where the last allocation left off, so
+// a file's blocks tend to be laid out one after the other, and it only
+// looks inside tracks that have a free sector.
+
+class FreeMap : public BitMap {
+  public:
+    FreeMap(int nitems);		// All sectors free
+    ~FreeMap();
+
+    void Mark(int which);		// Allocate/free a sector, keeping
+    void Clear(int which);		//  the counts up to date
+    int Find();				// Allocate a free sector, next-fit
+    int NumClear() { return numClear; }
+
+    void HoldFreed(bool on);		// Keep freed sectors from Find
+    void ReleaseFreed();		//  until this is called
+
+    void FetchFrom(OpenFile *file);	// Read the whole map
+    void WriteBack(OpenFile *file);	// Write back the sectors of the
+					//  map that changed
+
+  private:
+    int numClear;			// # of free sectors
+    int numTracks;
+    int *trackFree;			// # of free sectors in each track
+    int cursor;				// where the next Find starts
+    int numMapSectors;			// # of sectors in the bitmap file
+    bool *dirty;			// which of them changed
+    bool *freed;			// held back from Find; NULL if
+					//  freed sectors are not held
+    int numFreed;			// # of sectors held back
+
+    void Recount();			// Recompute the counts from the map
+    void SetDirty(int which);		// The bit for "which" changed
+};
+
+#endif // FREEMAP_H
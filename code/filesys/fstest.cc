@@ -7,6 +7,9 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   SmallFilesTest -- create, write and remove many small files
+//	   CrashTest -- crash Nachos at random points, and check that
+//		the file system is still consistent afterwards
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,6 +23,9 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "directory.h"
+#include "filehdr.h"
+#include "synchdisk.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -305,3 +311,138 @@ PerformanceTest()
     stats->Print();
 }
 
+
+//----------------------------------------------------------------------
+// SmallFilesTest
+// 	Create "count" small files, write a few bytes to each, then remove
+//	them all, and report the disk requests and simulated time spent
+//	per file.  This is dominated by metadata updates -- directory,
+//	file header and free map.  It is done twice: once with a journal
+//	commit per operation, and once with the operations batched.
+//----------------------------------------------------------------------
+
+static void
+SmallFilesPass(int count, bool batch)
+{
+    char name[FileNameMaxLen + 1];
+    int i, created = 0;
+    int ticks = stats->totalTicks;
+    int reads = stats->numDiskReads;
+    int writes = stats->numDiskWrites;
+
+    printf("Creating %d small files%s\n", count, batch ? ", batched" : "");
+    if (batch)
+        fileSystem->BeginBatch();
+    for (i = 0; i < count; i++) {
+        OpenFile *openFile;
+
+        snprintf(name, sizeof(name), "s%d", i);
+        if (!fileSystem->Create(name, 0)) {
+            printf("Small files test: can't create %s\n", name);
+            break;
+        }
+        created++;
+        if ((openFile = fileSystem->Open(name)) == NULL) {
+            printf("Small files test: unable to open %s\n", name);
+            break;
+        }
+        openFile->WriteAt(Contents, ContentSize, 0);
+        delete openFile;
+    }
+    if (batch)
+        fileSystem->EndBatch();
+    printf("create: %d files, %d ticks, %d disk reads, %d disk writes\n",
+        created, stats->totalTicks - ticks, stats->numDiskReads - reads,
+        stats->numDiskWrites - writes);
+
+    ticks = stats->totalTicks;
+    reads = stats->numDiskReads;
+    writes = stats->numDiskWrites;
+    if (batch)
+        fileSystem->BeginBatch();
+    for (i = 0; i < created; i++) {
+        snprintf(name, sizeof(name), "s%d", i);
+        if (!fileSystem->Remove(name))
+            printf("Small files test: unable to remove %s\n", name);
+    }
+    if (batch)
+        fileSystem->EndBatch();
+    printf("remove: %d files, %d ticks, %d disk reads, %d disk writes\n",
+        created, stats->totalTicks - ticks, stats->numDiskReads - reads,
+        stats->numDiskWrites - writes);
+}
+
+void
+SmallFilesTest(int count)
+{
+    SmallFilesPass(count, FALSE);
+    SmallFilesPass(count, TRUE);
+}
+
+//----------------------------------------------------------------------
+// CrashTest
+// 	Check that the file system survives Nachos dying at any point.
+//	Each trial forks a copy of Nachos that runs CrashWorkload and is
+//	made to exit just before a random disk write.  The parent then
+//	mounts the disk again, as if after a reboot -- dropping all of
+//	the old in-memory state without writing it back -- and checks
+//	that the file system is consistent.
+//----------------------------------------------------------------------
+
+#define CrashFiles	6		// files rewritten by each trial
+#define CrashMaxWrites	200		// crash within this many writes
+
+static void
+CrashWorkload()
+{
+    char name[20];
+    char *buf = new char[CrashFiles * 400];
+
+    for (int i = 0; i < CrashFiles * 400; i++)
+        buf[i] = Contents[i % ContentSize];
+    fileSystem->Create("crash", 0, TRUE);	// the first time round
+    for (int i = 0; i < CrashFiles; i++) {
+        OpenFile *openFile;
+
+        sprintf(name, "crash/file%d", i);
+        fileSystem->Remove(name);		// left by the last trial
+        if (!fileSystem->Create(name, (i == 0) ? 40 * SectorSize : 0))
+            continue;
+        if ((openFile = fileSystem->Open(name)) != NULL) {
+            openFile->WriteAt(buf, i * 400, 0);
+            delete openFile;
+        }
+    }
+    delete [] buf;
+}
+
+void
+CrashTest(int trials)
+{
+    int crashed = 0, failed = 0;
+
+    printf("Crash test: %d trials\n", trials);
+    for (int t = 0; t < trials; t++) {
+        int crashAt = 1 + Random() % CrashMaxWrites;
+        int pid = ForkProcess();
+
+        if (pid == 0) {
+            synchDisk->CrashAfter(crashAt);
+            CrashWorkload();
+            Exit(0);			// did not get as far as crashAt
+        }
+        if (WaitProcess(pid) == CrashExitStatus)
+            crashed++;
+
+        // reboot; the old file system is lost with the crash
+        fileHeaderCache = new FileHeaderCache();
+        fileSystem = new FileSystem(FALSE);
+        if (fileSystem->Check() > 0) {
+            printf("Crash test: trial %d, crash before write %d, "
+                    "left the disk inconsistent\n", t, crashAt);
+            failed++;
+        }
+    }
+    printf("Crash test: %d trials, %d crashed, %d inconsistent\n",
+            trials, crashed, failed);
+}
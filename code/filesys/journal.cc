@@ -0,0 +1,346 @@
+// journal.cc
+//	Routines to keep a write-ahead log of file system metadata.
+//
+//	A transaction is the group of sectors written by the operations
+//	between two commits.  It is committed in three steps:
+//
+//	   write the blocks to the log, one after the other
+//	   write the journal header listing their home sectors
+//	   copy the blocks to their home sectors, and clear the header
+//
+//	A crash before the header is written loses the whole group; a
+//	crash after it is repaired by Recover, which just does the copy
+//	again.  Copying a block twice is harmless.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "freemap.h"
+#include "synch.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty journal.  It is disabled until Format or
+//	Recover finds out whether the disk has a log.
+//
+//	"map" -- the free map, where sectors freed by an operation go
+//	  back to once the operation is committed
+//	"mapLock" -- protects "map"
+//----------------------------------------------------------------------
+
+Journal::Journal(FreeMap *map, Lock *mapLock)
+{
+    ASSERT(sizeof(JournalHeader) <= SectorSize);
+    ASSERT(MaxJournalOps >= 1);
+    enabled = FALSE;
+    count = 0;
+    blocks = new char[MaxJournalBlocks * SectorSize];
+    for (int i = 0; i < MaxJournalOps; i++)
+        opThreads[i] = NULL;
+    outstanding = 0;
+    batchDepth = 0;
+    committing = FALSE;
+    lock = new Lock("journal");
+    changed = new Condition("journal");
+    freeMap = map;
+    freeMapLock = mapLock;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  Whatever is in the current group is
+//	committed first.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    ASSERT(outstanding == 0);
+    lock->Acquire();
+    if (count > 0)
+        Commit();
+    lock->Release();
+    delete [] blocks;
+    delete lock;
+    delete changed;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty log to a disk that is being formatted.  The
+//	caller has already reserved the log sectors in the free map.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    enabled = TRUE;
+    WriteHeader(0);
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Called at mount time, before any metadata is read.  If the last
+//	transaction was committed but not completely installed, copy it
+//	to its home sectors.  Return FALSE, and leave journaling off, if
+//	the disk was formatted without a log.
+//----------------------------------------------------------------------
+
+bool
+Journal::Recover()
+{
+    JournalHeader *hdr = new JournalHeader;
+    char *buf = new char[SectorSize];
+
+    synchDisk->ReadSector(JournalStart, (char *)hdr);
+    enabled = (hdr->magic == JournalMagic);
+    if (enabled && hdr->count > 0) {
+        ASSERT(hdr->count <= MaxJournalBlocks);
+        DEBUG('f', "Replaying %d journal blocks.\n", hdr->count);
+        for (int i = 0; i < hdr->count; i++) {
+            synchDisk->ReadSector(JournalStart + 1 + i, buf);
+            synchDisk->WriteSectorNow(hdr->sectors[i], buf);
+        }
+        WriteHeader(0);
+    }
+    delete hdr;
+    delete [] buf;
+    return enabled;
+}
+
+//----------------------------------------------------------------------
+// Journal::BeginOp
+// 	Start a metadata operation in the current thread.  Wait until no
+//	commit is in progress and the log has room for MaxOpBlocks more
+//	sectors on behalf of every operation in progress, committing the
+//	held batch if that is what is taking up the room.
+//----------------------------------------------------------------------
+
+void
+Journal::BeginOp()
+{
+    if (!enabled)
+        return;
+    lock->Acquire();
+    ASSERT(!InOp());			// operations do not nest
+    while (committing || !HasRoom()) {
+        if (!committing && outstanding == 0)
+            Commit();
+        else
+            changed->Wait(lock);
+    }
+    for (int i = 0; i < MaxJournalOps; i++)
+        if (opThreads[i] == NULL) {
+            opThreads[i] = currentThread;
+            break;
+        }
+    outstanding++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::EndOp
+// 	End the current thread's operation.  The last operation to end
+//	commits the group, unless a batch is holding commits back and
+//	there is still room in the log.
+//----------------------------------------------------------------------
+
+void
+Journal::EndOp()
+{
+    int i;
+
+    if (!enabled)
+        return;
+    lock->Acquire();
+    for (i = 0; i < MaxJournalOps; i++)
+        if (opThreads[i] == currentThread)
+            break;
+    ASSERT(i < MaxJournalOps);
+    opThreads[i] = NULL;
+    outstanding--;
+    if (outstanding == 0 && (batchDepth == 0 || !HasRoom()))
+        Commit();
+    else
+        changed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::BeginBatch / EndBatch
+// 	Hold commits back, so that the operations in between share as
+//	few commits as the size of the log allows.  EndBatch commits
+//	what is left.
+//----------------------------------------------------------------------
+
+void
+Journal::BeginBatch()
+{
+    if (!enabled)
+        return;
+    lock->Acquire();
+    batchDepth++;
+    lock->Release();
+}
+
+void
+Journal::EndBatch()
+{
+    if (!enabled)
+        return;
+    lock->Acquire();
+    ASSERT(batchDepth > 0);
+    batchDepth--;
+    if (batchDepth == 0 && outstanding == 0 && !committing && count > 0)
+        Commit();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Absorb
+// 	Called by SynchDisk for every write.  Writes made inside an
+//	operation are kept in the current group; so are later writes to
+//	a sector that is already in the group, so that installing the
+//	group does not undo them.  Return FALSE if the write should go
+//	straight to the disk.
+//
+//	"sector" -- the home sector of the write
+//	"data" -- its new contents
+//----------------------------------------------------------------------
+
+bool
+Journal::Absorb(int sector, char *data)
+{
+    int i;
+
+    if (!enabled)
+        return FALSE;
+    lock->Acquire();
+    while (committing && Find(sector) != -1)
+        changed->Wait(lock);		// let the old copy be installed
+    i = Find(sector);
+    if (i == -1) {
+        if (!InOp()) {
+            lock->Release();
+            return FALSE;
+        }
+        ASSERT(count < MaxJournalBlocks);	// BeginOp saw to it
+        i = count++;
+        sectors[i] = sector;
+    }
+    bcopy(data, &blocks[i * SectorSize], SectorSize);
+    lock->Release();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Lookup
+// 	If "sector" has been written in the current group, copy the
+//	logged contents into "data" and return TRUE.
+//----------------------------------------------------------------------
+
+bool
+Journal::Lookup(int sector, char *data)
+{
+    int i;
+
+    if (!enabled)
+        return FALSE;
+    lock->Acquire();
+    i = Find(sector);
+    if (i != -1)
+        bcopy(&blocks[i * SectorSize], data, SectorSize);
+    lock->Release();
+    return i != -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Find / InOp / HasRoom
+// 	Small helpers; the caller holds "lock".
+//----------------------------------------------------------------------
+
+int
+Journal::Find(int sector)
+{
+    for (int i = 0; i < count; i++)
+        if (sectors[i] == sector)
+            return i;
+    return -1;
+}
+
+bool
+Journal::InOp()
+{
+    for (int i = 0; i < MaxJournalOps; i++)
+        if (opThreads[i] == currentThread)
+            return TRUE;
+    return FALSE;
+}
+
+bool
+Journal::HasRoom()
+{
+    return outstanding < MaxJournalOps
+        && count + (outstanding + 1) * MaxOpBlocks <= MaxJournalBlocks;
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the current group to disk: log, commit point, install.
+//	Called with "lock" held and no operation in progress; the lock
+//	is let go during the disk writes so that readers can still find
+//	the logged blocks.  Afterwards, the sectors the group freed can
+//	be allocated again.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    int n = count;
+
+    ASSERT(outstanding == 0 && !committing);
+    committing = TRUE;
+    lock->Release();
+
+    if (n > 0) {
+        DEBUG('f', "Committing %d journal blocks.\n", n);
+        for (int i = 0; i < n; i++)
+            synchDisk->WriteSectorNow(JournalStart + 1 + i,
+                                        &blocks[i * SectorSize]);
+        WriteHeader(n);			// the commit point
+        for (int i = 0; i < n; i++)
+            synchDisk->WriteSectorNow(sectors[i], &blocks[i * SectorSize]);
+        WriteHeader(0);
+    }
+    freeMapLock->Acquire();
+    freeMap->ReleaseFreed();
+    freeMapLock->Release();
+
+    lock->Acquire();
+    count = 0;
+    committing = FALSE;
+    changed->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write a journal header listing the first "n" blocks of the
+//	current group.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader(int n)
+{
+    char buf[SectorSize];
+    JournalHeader *hdr = (JournalHeader *)buf;
+
+    bzero(buf, SectorSize);
+    hdr->magic = JournalMagic;
+    hdr->count = n;
+    for (int i = 0; i < n; i++)
+        hdr->sectors[i] = sectors[i];
+    synchDisk->WriteSectorNow(JournalStart, buf);
+}
@@ -0,0 +1,111 @@
+// journal.h
+//	Data structures for the file system's metadata journal.
+//
+//	Operations that change file system metadata (file headers, index
+//	tables, directories and the free map) are bracketed by BeginOp and
+//	EndOp.  The sectors an operation writes are not sent to their home
+//	location; they are kept in memory, and when no operation is in
+//	progress the whole group is committed: first written one after the
+//	other to a log on the last track of the disk, then a header sector
+//	listing them is written (this is the commit point), and only then
+//	are they copied to where they belong.  If Nachos dies part way, the
+//	file system replays the log when it is next mounted, so that either
+//	all of an operation's changes are on disk or none are.
+//
+//	File data is not journaled; it is written straight to the disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+
+#define JournalSectors		SectorsPerTrack	// size of the log region
+#define JournalStart		(NumSectors - JournalSectors)
+					// its header sector; the logged
+					//  blocks follow it
+#define MaxJournalBlocks	((int) (SectorSize / sizeof(int)) - 2)
+					// blocks listed in one header
+#define MaxOpBlocks		12	// most sectors one operation writes
+#define MaxJournalOps		(MaxJournalBlocks / MaxOpBlocks)
+					// operations in progress at once
+#define JournalMagic		0x4a524e4c
+
+// The on-disk journal header.  "count" is non-zero only between the
+// commit point of a transaction and the end of its installation.
+
+class JournalHeader {
+  public:
+    int magic;				// JournalMagic if the disk has a log
+    int count;				// # of committed blocks in the log
+    int sectors[MaxJournalBlocks];	// home sector of each block
+};
+
+class Lock;
+class Condition;
+class Thread;
+class FreeMap;
+
+// The following class defines the journal.  SynchDisk hands it every
+// write made by a thread inside an operation (Absorb) and lets it
+// answer reads of sectors that are not installed yet (Lookup).
+//
+// Commits happen when the last operation in progress ends, so
+// operations that overlap share one commit.  BeginBatch/EndBatch hold
+// commits back further, until the log is nearly full, so that a burst
+// of small operations pays for one log write.
+//
+// Sectors freed by an operation must not be handed out again, and
+// overwritten by file data, until the operation is committed, or a
+// crash could leave the file they were freed from pointing at someone
+// else's data.  The free map holds them back, and the journal gives
+// them back after each commit.
+
+class Journal {
+  public:
+    Journal(FreeMap *map, Lock *mapLock);
+					// A journal that gives sectors back
+					//  to "map" after each commit
+    ~Journal();
+
+    void Format();			// Write an empty log to a new disk
+    bool Recover();			// Replay a committed log left by a
+					//  crash; FALSE if the disk has no log
+    bool IsEnabled() { return enabled; }
+
+    void BeginOp();			// Start/end a metadata operation
+    void EndOp();
+    void BeginBatch();			// Hold commits back
+    void EndBatch();
+
+    bool Absorb(int sector, char *data);// Keep a write in the log; FALSE
+					//  if it should go to the disk
+    bool Lookup(int sector, char *data);// Copy out a logged sector
+
+  private:
+    bool enabled;			// FALSE on disks without a log
+    int count;				// # of blocks in the current group
+    int sectors[MaxJournalBlocks];	// their home sectors
+    char *blocks;			// and their contents
+    Thread *opThreads[MaxJournalOps];	// threads inside an operation
+    int outstanding;			// # of operations in progress
+    int batchDepth;			// BeginBatch nesting
+    bool committing;			// a commit is writing the log
+    Lock *lock;
+    Condition *changed;			// signalled when the above change
+    FreeMap *freeMap;
+    Lock *freeMapLock;
+
+    int Find(int sector);		// Index of "sector" in the group
+    bool InOp();			// Is currentThread in an operation?
+    bool HasRoom();			// Can another operation start?
+    void Commit();			// Write the group to disk
+    void WriteHeader(int n);		// Write a header listing "n" blocks
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  The header is shared with every
+//	other OpenFile on the same file through the FileHeaderCache.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -29,11 +30,8 @@
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = fileHeaderCache->Acquire(sector);
     seekPosition = 0;
-    // add count
-    synchDisk->CountPlus(sector);
 }
 
 //----------------------------------------------------------------------
@@ -43,9 +41,7 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    // add count
-    synchDisk->CountSub(hdr->GetHdrSector());
-    delete hdr;
+    fileHeaderCache->Release(hdr);
 }
 
 //----------------------------------------------------------------------
@@ -134,6 +130,7 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     // --- lab 5 ---
     // update access time 
     hdr->SetLastAccessTime();
+    fileHeaderCache->MarkDirty(hdr);
     // -- end lab 5 ---
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
@@ -169,6 +166,7 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     // update modify time 
     hdr->SetLastAccessTime();
     hdr->SetLastModifyTime();
+    fileHeaderCache->MarkDirty(hdr);
     // -- end lab 5 ---
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
@@ -181,7 +179,7 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     
     if ((position + numBytes) > fileLength){
     	//numBytes = fileLength - position;
-        if (!fileSystem->Extend(this, numBytes)){
+        if (!fileSystem->Extend(this, position + numBytes)){
             printf("Fail to extend file length\n");
             return 0;
         }
@@ -228,18 +226,13 @@ OpenFile::Length()
 }
 
 // accessing hdr in OpenFile is strange ...
-void 
-OpenFile::SetDataSector(int idx, int var)
+bool
+OpenFile::ExtendHdr(BitMap *freeMap, int newLength)
 {
-    hdr->SetDataSector(idx, var);
+    return hdr->Extend(freeMap, newLength);
 }
 void
 OpenFile::WriteBackHdr()
 {
     hdr->WriteBack(hdr->GetHdrSector());
 }
-void 
-OpenFile::UpdateBytes(int bytes)
-{
-    hdr->UpdateBytes(bytes);
-}
\ No newline at end of file
@@ -60,6 +60,7 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class BitMap;
 
 class OpenFile {
   public:
@@ -85,9 +86,10 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
-    void SetDataSector(int idx, int val);
+    bool ExtendHdr(BitMap *freeMap, int newLength);
+					// Grow the file header to cover
+					// "newLength" bytes
     void WriteBackHdr();
-    void UpdateBytes(int bytes);
   private:
     FileHeader *hdr;            // Header for this file 
     int seekPosition;			// Current position within the file
@@ -16,6 +16,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -46,8 +47,8 @@ SynchDisk::SynchDisk(char* name)
     lock = new Lock("synch disk lock");
     disk = new Disk(name, DiskRequestDone, (int) this);
     RWLock = new ReaderWriterLock();
-    for (int i=0; i<NumSectors; ++i) fileOpenCount[i] = 0;
-    fileOpenCountLock = new Lock("fileOpenCount lock");
+    journal = NULL;
+    crashCountdown = 0;
 }
 
 //----------------------------------------------------------------------
@@ -75,6 +76,8 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
+    if (journal != NULL && journal->Lookup(sectorNumber, data))
+        return;				// not installed yet
     lock->Acquire();			// only one disk I/O at a time
     disk->ReadRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
@@ -84,7 +87,7 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
 // 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+//	after the data has been written, or taken by the journal.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -93,6 +96,25 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
+    if (journal != NULL && journal->Absorb(sectorNumber, data))
+        return;
+    WriteSectorNow(sectorNumber, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectorNow
+// 	Write a sector to the disk itself; the journal uses this to
+//	write the log and install it.  If a crash has been scheduled
+//	with CrashAfter, Nachos exits here without writing.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectorNow(int sectorNumber, char* data)
+{
+    if (crashCountdown > 0 && --crashCountdown == 0) {
+        DEBUG('f', "Crashing before writing sector %d.\n", sectorNumber);
+        Exit(CrashExitStatus);
+    }
     lock->Acquire();			// only one disk I/O at a time
     disk->WriteRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
@@ -110,21 +132,3 @@ SynchDisk::RequestDone()
 { 
     semaphore->V();
 }
-
-void SynchDisk::CountPlus(int sec){
-    fileOpenCountLock->Acquire();
-    fileOpenCount[sec] ++;
-    fileOpenCountLock->Release();
-}
-void SynchDisk::CountSub(int sec){
-    fileOpenCountLock->Acquire();
-    fileOpenCount[sec] --;
-    fileOpenCountLock->Release();
-}
-bool SynchDisk::CountZero(int sec){
-    bool isZero = FALSE;
-    fileOpenCountLock->Acquire();
-    isZero = (fileOpenCount[sec] == 0);
-    fileOpenCountLock->Release();
-    return isZero;
-}
\ No newline at end of file
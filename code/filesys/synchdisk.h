@@ -14,6 +14,10 @@
 #include "disk.h"
 #include "synch.h"
 
+class Journal;
+
+#define CrashExitStatus	2	// what Nachos exits with on a CrashAfter
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -24,6 +28,10 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Once the file system has set up its journal, writes made inside a
+// journaled operation are kept by the journal instead of going to the
+// disk, and reads see them.
 class SynchDisk {
   public:
     SynchDisk(char* name);    		// Initialize a synchronous disk,
@@ -37,6 +45,13 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void WriteSectorNow(int sectorNumber, char* data);
+					// Write past the journal
+    void SetJournal(Journal *j) { journal = j; }
+    void CrashAfter(int writes) { crashCountdown = writes; }
+					// Exit Nachos just before the 
+					//  "writes"th write from now, for 
+					//  crash testing
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
@@ -45,9 +60,6 @@ class SynchDisk {
     void ReaderRelease(){RWLock->ReaderRelease();}
     void WriterAcquire(){RWLock->WriterAcquire();}
     void WriterRelease(){RWLock->WriterRelease();}
-    void CountPlus(int sec);
-    void CountSub(int sec);
-    bool CountZero(int sec);
   private:
     Disk *disk;		  		// Raw disk device
     Semaphore *semaphore; 		// To synchronize requesting thread 
@@ -56,8 +68,8 @@ class SynchDisk {
 					// can be sent to the disk at a time
     // Lab 5
     ReaderWriterLock *RWLock;
-    int fileOpenCount[NumSectors];
-    Lock *fileOpenCountLock;
+    Journal *journal;			// NULL until the file system is up
+    int crashCountdown;			// writes until the crash; 0 if none
 };
 
 #endif // SYNCHDISK_H
@@ -150,48 +150,167 @@ Console::PutChar(char ch)
 }
 
 
+// Dummy functions because C++ is weird about pointers to member functions
+static void SynchConsoleReadAvail(int c)
+{ SynchConsole *console = (SynchConsole *)c; console->ReadAvail(); }
+static void SynchConsoleWriteDone(int c)
+{ SynchConsole *console = (SynchConsole *)c; console->WriteDone(); }
+
 //----------------------------------------------------------------------
-// SynchConsole
+// SynchConsole::SynchConsole
+// 	Initialize a console that threads can wait on, and its buffers.
+//
+//	"readFile", "writeFile" -- as for Console
+//	"callArg" -- unused
 //----------------------------------------------------------------------
 
-static void ReadAvail(int arg) { 
-    SynchConsole *synchconsole = (SynchConsole *)arg;
-    synchconsole->readAvail->V(); 
-}
-static void WriteDone(int arg) { 
-    SynchConsole *synchconsole = (SynchConsole *)arg;
-    synchconsole->writeDone->V(); 
-}
-
 SynchConsole::SynchConsole(char *readFile, char *writeFile, int callArg)
 {
-    readAvail = new Semaphore("read avail", 0);
-    writeDone = new Semaphore("write done", 0);
-    console = new Console(readFile, writeFile, ReadAvail, WriteDone, (int)this);
-    readLock = new Lock("read lock");
-    writeLock = new Lock("write lock");
+    readLock = new Lock("console read lock");
+    writeLock = new Lock("console write lock");
+    outHead = outCount = 0;
+    outWaiting = FALSE;
+    outRoom = new Semaphore("console out room", 0);
+    inHead = inCount = 0;
+    inStalled = inWaiting = FALSE;
+    inArrived = new Semaphore("console in arrived", 0);
+    console = new Console(readFile, writeFile, SynchConsoleReadAvail,
+				SynchConsoleWriteDone, (int)this);
 }
 
-SynchConsole::~SynchConsole(){
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	Clean up.  Output not yet displayed is lost; Flush first.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
     delete readLock;
     delete writeLock;
-    delete readAvail;
-    delete writeDone;
-    delete console;
+    delete outRoom;
+    delete inArrived;
 }
 
-void SynchConsole::PutChar(char ch){
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Copy characters into the output buffer, starting the device if it
+//	is idle.  We only wait if the buffer fills up.
+//
+//	"from" -- the characters to write
+//	"numBytes" -- how many
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *from, int numBytes)
+{
+    writeLock->Acquire();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    while (numBytes > 0) {
+	while (outCount == ConsoleBufferSize) {
+	    outWaiting = TRUE;
+	    outRoom->P();
+	}
+	int n = min(numBytes, ConsoleBufferSize - outCount);
+	for (int i = 0; i < n; i++)
+	    outBuf[(outHead + outCount + i) % ConsoleBufferSize] = from[i];
+	if (outCount == 0)			// the device is idle
+	    console->PutChar(outBuf[outHead]);
+	outCount += n;
+	from += n;
+	numBytes -= n;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    writeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Flush
+// 	Wait for the output buffer to drain.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Flush()
+{
     writeLock->Acquire();
-    console->PutChar(ch);
-    writeDone->P();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    while (outCount > 0) {
+	outWaiting = TRUE;
+	outRoom->P();
+    }
+    (void) interrupt->SetLevel(oldLevel);
     writeLock->Release();
 }
 
-char SynchConsole::GetChar()
+//----------------------------------------------------------------------
+// SynchConsole::WriteDone
+// 	Interrupt handler: a character has been displayed.  Give the
+//	device the next one, and wake up a writer waiting for room.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::WriteDone()
+{
+    outHead = (outHead + 1) % ConsoleBufferSize;
+    if (--outCount > 0)
+	console->PutChar(outBuf[outHead]);
+    if (outWaiting) {
+	outWaiting = FALSE;
+	outRoom->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Wait until at least one character has been typed, then take as
+//	many as are in the input buffer, up to "numBytes".
+//
+//	"into" -- where to put them
+//	"numBytes" -- the most to take
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *into, int numBytes)
 {
+    int n;
+
     readLock->Acquire();
-    readAvail->P();  
-    char ch = console->GetChar();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    while (inCount == 0) {
+	inWaiting = TRUE;
+	inArrived->P();
+    }
+    n = min(numBytes, inCount);
+    for (int i = 0; i < n; i++)
+	into[i] = inBuf[(inHead + i) % ConsoleBufferSize];
+    inHead = (inHead + n) % ConsoleBufferSize;
+    inCount -= n;
+    if (inStalled && n > 0) {		// there is room for it now
+	inStalled = FALSE;
+	inBuf[(inHead + inCount++) % ConsoleBufferSize] = console->GetChar();
+    }
+    (void) interrupt->SetLevel(oldLevel);
     readLock->Release();
-    return ch;
-}
\ No newline at end of file
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail
+// 	Interrupt handler: a character has been typed.  Move it into the
+//	input buffer, so the device can take the next one.  If the
+//	buffer is full, leave it in the device, which holds off input
+//	until Read makes room.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    if (inCount == ConsoleBufferSize)
+	inStalled = TRUE;
+    else
+	inBuf[(inHead + inCount++) % ConsoleBufferSize] = console->GetChar();
+    if (inWaiting) {
+	inWaiting = FALSE;
+	inArrived->V();
+    }
+}
@@ -74,25 +74,57 @@ class Console {
 };
 
 
+// The following class defines a console that threads can use without
+// handling its interrupts.  Output is buffered in the kernel: Write
+// copies the characters in and returns, and the write-done interrupt
+// hands the device the next one, so a writer only waits when the
+// buffer is full, not once per character.  Likewise the read interrupt
+// moves each character typed into an input buffer, and Read takes
+// whatever has arrived.
+
+#define ConsoleBufferSize	256	// characters buffered each way
+
 class SynchConsole {
   public:
     SynchConsole(char *readFile, char *writeFile, int callArg);
-                // initialize the hardware console device
+				// initialize the hardware console device
     ~SynchConsole();
-    void PutChar(char ch);  // Write "ch" to the console display, 
-                // and return immediately.  "writeHandler" 
-                // is called when the I/O completes. 
 
-    char GetChar();     // Poll the console input.  If a char is 
-                // available, return it.  Otherwise, return EOF.
-                    // "readHandler" is called whenever there is 
-                // a char to be gotten
-    Semaphore *readAvail;
-    Semaphore *writeDone;
+    void Write(char *from, int numBytes);
+				// Queue "numBytes" characters for display;
+				// wait only for buffer room
+    int Read(char *into, int numBytes);
+				// Wait until a character has been typed,
+				// then return up to "numBytes" of them;
+				// return how many
+    void Flush();		// Wait until everything written has
+				// been displayed
+
+    void PutChar(char ch) { Write(&ch, 1); }
+    char GetChar() { char ch; (void) Read(&ch, 1); return ch; }
+
+    void ReadAvail();		// Internal: interrupt handlers
+    void WriteDone();
 
   private:
     Console *console;
-    Lock *readLock;
-    Lock *writeLock;
+    Lock *readLock;		// one reader at a time
+    Lock *writeLock;		// one writer at a time
+
+    // The buffers are shared with the interrupt handlers, so they
+    // are used with interrupts off.
+    char outBuf[ConsoleBufferSize];
+    int outHead;		// the character being displayed
+    int outCount;		// # not yet displayed, that one included
+    bool outWaiting;		// a writer is waiting on "outRoom"
+    Semaphore *outRoom;		// V'ed when a character is displayed
+
+    char inBuf[ConsoleBufferSize];
+    int inHead;			// the next character to Read
+    int inCount;		// # typed and not yet read
+    bool inStalled;		// a character is left in the device, for
+				//   want of room
+    bool inWaiting;		// a reader is waiting on "inArrived"
+    Semaphore *inArrived;	// V'ed when a character is typed
 };
 #endif // CONSOLE_H
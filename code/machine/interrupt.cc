@@ -14,6 +14,9 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	Pending interrupts are kept in a binary heap, so scheduling one
+//	costs O(log n) and finding out whether one is due costs O(1).
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -48,6 +51,19 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     arg = param;
     when = time;
     type = kind;
+    order = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// Earlier
+// 	Return TRUE if interrupt "a" is to occur before interrupt "b".
+//----------------------------------------------------------------------
+
+static inline bool
+Earlier(PendingInterrupt *a, PendingInterrupt *b)
+{
+    return a->when < b->when || (a->when == b->when && a->order < b->order);
 }
 
 //----------------------------------------------------------------------
@@ -60,8 +76,13 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = 16;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    freePending = NULL;
+    numScheduled = 0;
     inHandler = FALSE;
+    idling = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
 }
@@ -73,9 +94,66 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    for (int i = 0; i < numPending; i++)
+	delete pending[i];
+    delete [] pending;
+    while (freePending != NULL) {
+	PendingInterrupt *p = freePending;
+	freePending = p->next;
+	delete p;
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SiftUp / SiftDown
+// 	Move pending[i] up or down the heap until it is after its parent
+//	and before its children.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SiftUp(int i)
+{
+    PendingInterrupt *p = pending[i];
+
+    while (i > 0 && Earlier(p, pending[(i - 1) / 2])) {
+	pending[i] = pending[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    pending[i] = p;
+}
+
+void
+Interrupt::SiftDown(int i)
+{
+    PendingInterrupt *p = pending[i];
+    int child;
+
+    while ((child = 2 * i + 1) < numPending) {
+	if (child + 1 < numPending && Earlier(pending[child + 1], pending[child]))
+	    child++;
+	if (!Earlier(pending[child], p))
+	    break;
+	pending[i] = pending[child];
+	i = child;
+    }
+    pending[i] = p;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RemoveFirst
+// 	Take the earliest pending interrupt out of the heap.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::RemoveFirst()
+{
+    PendingInterrupt *first = pending[0];
+
+    ASSERT(numPending > 0);
+    pending[0] = pending[--numPending];
+    if (numPending > 0)
+	SiftDown(0);
+    return first;
 }
 
 //----------------------------------------------------------------------
@@ -162,13 +240,16 @@ Interrupt::OneTick()
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
-// check any pending interrupts are now ready to fire
-    ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
+// check any pending interrupts are now ready to fire; usually
+// none are, and a glance at the top of the heap tells us so
+    if (NextDue() <= stats->totalTicks || DebugIsEnabled('i')) {
+	ChangeLevel(IntOn, IntOff);	// first, turn off interrupts
 					// (interrupt handlers run with
 					// interrupts disabled)
-    while (CheckIfDue(FALSE))		// check for pending interrupts
-	;
-    ChangeLevel(IntOff, IntOn);		// re-enable interrupts
+	while (CheckIfDue(FALSE))	// check for pending interrupts
+	    ;
+	ChangeLevel(IntOff, IntOn);	// re-enable interrupts
+    }
     if (yieldOnReturn) {		// if the timer device handler asked 
 					// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
@@ -212,9 +293,11 @@ Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
+    idling = TRUE;
     if (CheckIfDue(TRUE)) {		// check for any pending interrupts
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
+	idling = FALSE;
         yieldOnReturn = FALSE;		// since there's nothing in the
 					// ready queue, the yield is automatic
         status = SystemMode;
@@ -226,6 +309,7 @@ Interrupt::Idle()
     // queue, it is time to stop.   If the console or the network is 
     // operating, there are *always* pending interrupts, so this code
     // is not reached.  Instead, the halt must be invoked by the user program.
+    idling = FALSE;
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -250,7 +334,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it in the heap, reusing a PendingInterrupt
+//	from the free list if there is one.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -265,13 +350,33 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur;
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    if (freePending != NULL) {
+	toOccur = freePending;
+	freePending = toOccur->next;
+	toOccur->handler = handler;
+	toOccur->arg = arg;
+	toOccur->when = when;
+	toOccur->type = type;
+    } else
+	toOccur = new PendingInterrupt(handler, arg, when, type);
+    toOccur->order = numScheduled++;
+
+    if (numPending == maxPending) {	// grow the heap
+	PendingInterrupt **bigger = new PendingInterrupt *[2 * maxPending];
+	for (int i = 0; i < numPending; i++)
+	    bigger[i] = pending[i];
+	delete [] pending;
+	pending = bigger;
+	maxPending *= 2;
+    }
+    pending[numPending++] = toOccur;
+    SiftUp(numPending - 1);
 }
 
 //----------------------------------------------------------------------
@@ -292,29 +397,28 @@ Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
     int when;
+    PendingInterrupt *toOccur;
     ASSERT(level == IntOff);		// interrupts need to be disabled,
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
 
-    if (toOccur == NULL)		// no pending interrupts
+    if (numPending == 0)		// no pending interrupts
 	return FALSE;			
+    toOccur = pending[0];
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {	// not time yet, leave it
 	return FALSE;
     }
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& numPending == 1)
 	 return FALSE;
-    }
+    (void) RemoveFirst();
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -329,7 +433,8 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    toOccur->next = freePending;		// keep it for the next Schedule
+    freePending = toOccur;
     return TRUE;
 }
 
@@ -340,10 +445,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
 }
@@ -361,7 +464,19 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+
+    // the heap is only partly sorted; sort a copy, in the order the
+    // interrupts will occur
+    PendingInterrupt **sorted = new PendingInterrupt *[numPending + 1];
+    for (int i = 0; i < numPending; i++) {
+	int j;
+	for (j = i; j > 0 && Earlier(pending[i], sorted[j - 1]); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = pending[i];
+    }
+    for (int i = 0; i < numPending; i++)
+	PrintPending(sorted[i]);
+    delete [] sorted;
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
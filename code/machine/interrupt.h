@@ -55,6 +55,10 @@ enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
+//
+// Interrupts due at the same time occur in the order they were
+// scheduled; "order" records that.  Once an interrupt has occurred,
+// its PendingInterrupt is kept on a free list for the next Schedule.
 
 class PendingInterrupt {
   public:
@@ -67,8 +71,12 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned int order;		// # of interrupts scheduled before this one
+    PendingInterrupt *next;	// next on the free list
 };
 
+#define NoPendingInterrupt	0x7fffffff	// NextDue with nothing pending
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -96,9 +104,16 @@ class Interrupt {
 					// from an interrupt handler
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
+    bool Idling() { return idling; }	// Is Idle running the handlers,
+					// with no thread ready to run?
     void setStatus(MachineStatus st) { status = st; }
 
     void DumpState();			// Print interrupt state
+
+    int NextDue() { return numPending > 0 ? pending[0]->when 
+				: NoPendingInterrupt; }
+					// When the earliest pending 
+					// interrupt is to occur
     
 
     // NOTE: the following are internal to the hardware simulation code.
@@ -114,9 +129,15 @@ class Interrupt {
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur in
+				// the future, as a heap ordered by
+				// (when, order): pending[0] is next
+    int numPending;		// # of interrupts in the heap
+    int maxPending;		// size of the pending array
+    PendingInterrupt *freePending;	// PendingInterrupts to reuse
+    unsigned int numScheduled;	// # of calls to Schedule so far
     bool inHandler;		// TRUE if we are running an interrupt handler
+    bool idling;		// TRUE if Idle is running interrupt handlers
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
@@ -128,6 +149,10 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
+
+    void SiftUp(int i);			// Restore the heap order above and
+    void SiftDown(int i);		//  below pending[i]
+    PendingInterrupt *RemoveFirst();	// Take pending[0] out of the heap
 };
 
 #endif // INTERRRUPT_H
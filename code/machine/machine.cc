@@ -50,38 +50,48 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"ncpus" -- how many CPUs, each with its own registers and TLB
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, int ncpus)
 {
     int i;
 
-    for (i = 0; i < NumTotalRegs; i++)
-        registers[i] = 0;
-    mainMemory = new char[MemorySize];
-    for (i = 0; i < MemorySize; i++)
-      	mainMemory[i] = 0;
-    phyBitmap = new BitMap(NumPhysPages);
+    ASSERT(ncpus >= 1 && ncpus <= MaxCpus);
+    numCpus = ncpus;
+    for (int c = 0; c < numCpus; c++) {
+        CpuState *cpu = &cpus[c];
+
+        for (i = 0; i < NumTotalRegs; i++)
+            cpu->registers[i] = 0;
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	{
-        tlb[i].valid = FALSE;
-    }
-    pageTable = NULL;
-    tlb_miss = tlb_hit = 0;
+        cpu->tlb = new TranslationEntry[TLBSize];
+        for (i = 0; i < TLBSize; i++)
+            cpu->tlb[i].valid = FALSE;
 #ifdef TLB_LRU
-    tlb_LRUqueue = new int[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-        tlb_LRUqueue[i] = 0;
+        cpu->tlbLRUqueue = new int[TLBSize];
+        for (i = 0; i < TLBSize; i++)
+            cpu->tlbLRUqueue[i] = 0;
 #else
-    tlb_LRUqueue = NULL;
+        cpu->tlbLRUqueue = NULL;
 #endif
-    
 #else	// use linear page table
-    tlb = NULL;
-    pageTable = NULL;
+        cpu->tlb = NULL;
+        cpu->tlbLRUqueue = NULL;
 #endif
+        cpu->tlbOwner = NULL;
+        cpu->lastUsed = 0;
+    }
+    cpuClock = 0;
+    SelectCpu(0);
+
+    mainMemory = new char[MemorySize];
+    for (i = 0; i < MemorySize; i++)
+      	mainMemory[i] = 0;
+    phyBitmap = new BitMap(NumPhysPages);
+    pageTable = NULL;
+    tlb_miss = tlb_hit = 0;
+    tlb_flushes = 0;
 
     singleStep = debug;
     CheckEndian();
@@ -96,8 +106,92 @@ Machine::~Machine()
 {
     delete [] mainMemory;
     delete phyBitmap;
-    if (tlb != NULL)
-        delete [] tlb;
+    for (int c = 0; c < numCpus; c++) {
+        if (cpus[c].tlb != NULL)
+            delete [] cpus[c].tlb;
+        if (cpus[c].tlbLRUqueue != NULL)
+            delete [] cpus[c].tlbLRUqueue;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FindCpu
+// 	Choose a CPU for a program that is about to run.  If one of them
+//	still has the program's translations in its TLB, use that one;
+//	otherwise take the CPU that has gone unused the longest, as its
+//	TLB is the least likely to be wanted again.
+//
+//	"owner" -- the program's address space
+//----------------------------------------------------------------------
+
+int
+Machine::FindCpu(void *owner)
+{
+    int best = 0;
+
+    for (int c = 0; c < numCpus; c++) {
+        if (owner != NULL && cpus[c].tlbOwner == owner)
+            return c;
+        if (cpus[c].lastUsed < cpus[best].lastUsed)
+            best = c;
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Machine::SelectCpu
+// 	Make CPU "which" the one that executes: "registers" and "tlb"
+//	now refer to its registers and TLB.
+//----------------------------------------------------------------------
+
+void
+Machine::SelectCpu(int which)
+{
+    ASSERT(which >= 0 && which < numCpus);
+    current = which;
+    registers = cpus[which].registers;
+    tlb = cpus[which].tlb;
+    tlb_LRUqueue = cpus[which].tlbLRUqueue;
+    cpus[which].lastUsed = ++cpuClock;
+}
+
+//----------------------------------------------------------------------
+// Machine::ClaimTlb
+// 	Called when the address space "owner" is about to run on the
+//	executing CPU.  Its TLB is only emptied if it holds another
+//	address space's translations.  Any other CPU whose TLB held
+//	"owner"'s translations gives them up, since they may go stale
+//	while "owner" runs here.
+//----------------------------------------------------------------------
+
+void
+Machine::ClaimTlb(void *owner)
+{
+    CpuState *cpu = &cpus[current];
+
+    if (cpu->tlb == NULL || cpu->tlbOwner == owner)
+        return;
+    for (int i = 0; i < TLBSize; i++)
+        cpu->tlb[i].valid = FALSE;
+    tlb_flushes++;
+    ForgetTlbOwner(owner);
+    cpu->tlbOwner = owner;
+}
+
+//----------------------------------------------------------------------
+// Machine::ForgetTlbOwner
+// 	No TLB may be taken to hold "owner"'s translations any more,
+//	either because it is being deleted (and its address could be
+//	reused) or because it is running on another CPU.  The entries
+//	themselves are emptied the next time the TLB is claimed.
+//----------------------------------------------------------------------
+
+void
+Machine::ForgetTlbOwner(void *owner)
+{
+    for (int c = 0; c < numCpus; c++)
+        if (cpus[c].tlbOwner == owner)
+            cpus[c].tlbOwner = NULL;
 }
 
 //----------------------------------------------------------------------
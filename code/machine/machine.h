@@ -37,6 +37,7 @@
 #define maxPhyPages 15  // max physical page number for a single thread
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define MaxCpus		8		// most simulated CPUs
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -93,6 +94,22 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The state each simulated CPU has of its own: registers and TLB.  All
+// CPUs share main memory.  Only one CPU executes at a time -- the
+// simulation is still sequential -- but each keeps its TLB contents
+// while it is not in use, so a program that goes back to the CPU it
+// last ran on finds its translations still loaded.
+
+class CpuState {
+  public:
+    int registers[NumTotalRegs];	// CPU registers
+    TranslationEntry *tlb;		// TLB, NULL if there is none
+    int *tlbLRUqueue;			// LRU ages of the TLB entries
+    void *tlbOwner;			// address space the TLB entries
+					// belong to, NULL if none
+    int lastUsed;			// when a thread last got this CPU
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -108,8 +125,10 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, int ncpus = 1);
+				// Initialize the simulation of the hardware
+				// for running user programs, with "ncpus"
+				// CPUs
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -145,6 +164,15 @@ class Machine {
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
 
+    int NumCpus() { return numCpus; }
+    int CurrentCpu() { return current; }
+    int FindCpu(void *owner);	// The CPU whose TLB belongs to "owner",
+				// else the one idle the longest
+    void SelectCpu(int which);	// Make "which" the executing CPU
+    void ClaimTlb(void *owner);	// Flush the TLB unless it belongs
+				// to "owner", and make it "owner"'s
+    void ForgetTlbOwner(void *owner); // "owner" is going away
+
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
@@ -170,7 +198,8 @@ class Machine {
 
     char *mainMemory;		// physical memory to store user program,
 				// code and data, while executing
-    int registers[NumTotalRegs]; // CPU registers, for executing user programs
+    int *registers;		// CPU registers, for executing user programs;
+				// those of the executing CPU
     // ------lab 4 ---------
     BitMap *phyBitmap;
     // ----end lab 4 ---------
@@ -193,7 +222,8 @@ class Machine {
 // the contents of the TLB are free to be modified by the kernel software.
 
     TranslationEntry *tlb;		// this pointer should be considered 
-					// "read-only" to Nachos kernel code
+					// "read-only" to Nachos kernel code;
+					// it is the executing CPU's TLB
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
@@ -202,7 +232,14 @@ class Machine {
     int tlb_hit;
     int *tlb_LRUqueue;
     // ----end lab 4 ---------
+    int tlb_flushes;			// # of times a TLB was emptied
+					// on a context switch
   private:
+    CpuState cpus[MaxCpus];
+    int numCpus;
+    int current;			// the executing CPU
+    int cpuClock;			// counts SelectCpu calls, for lastUsed
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -25,12 +25,22 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Most instructions only advance the clock: no interrupt becomes
+//	due.  Until the next pending interrupt is due, we charge the tick
+//	here and skip Interrupt::OneTick, which would find nothing to do.
+//	The deadline is read again after every instruction, since a
+//	system call or page fault may schedule an interrupt or let time
+//	pass.  Simulated time comes out exactly as if OneTick had been
+//	called every time.  Single-stepping and interrupt debugging ('i')
+//	go through OneTick every time.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
     Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool fastForward = !singleStep && !DebugIsEnabled('i');
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
@@ -38,9 +48,17 @@ Machine::Run()
     interrupt->setStatus(UserMode);
     for (;;) {
         OneInstruction(instr);
+	if (fastForward && interrupt->getStatus() == UserMode
+		&& stats->totalTicks + UserTick < interrupt->NextDue()) {
+	    stats->totalTicks += UserTick;	// all OneTick would do
+	    stats->userTicks += UserTick;
+	    continue;
+	}
 	interrupt->OneTick();
-	if (singleStep && (runUntilTime <= stats->totalTicks))
+	if (singleStep && (runUntilTime <= stats->totalTicks)) {
 	  Debugger();
+	  fastForward = !singleStep && !DebugIsEnabled('i');
+	}
     }
 }
 
@@ -1,6 +1,7 @@
 // network.cc 
-//	Routines to simulate a network interface, using UNIX sockets
-//	to deliver packets between multiple invocations of nachos.
+//	Routines to simulate a network interface.  Packets are carried
+//	by a Transport: by default UNIX sockets, to deliver packets
+//	between multiple invocations of nachos.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -10,6 +11,7 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "transport.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -19,18 +21,23 @@ static void NetworkReadPoll(int arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
 static void NetworkSendDone(int arg)
 { Network *net = (Network *)arg; net->SendDone(); }
+static void NetworkArrived(int arg)
+{ Network *net = (Network *)arg; net->PacketArrived(); }
+static void NetworkReadNow(int arg)
+{ Network *net = (Network *)arg; net->ReadStalled(); }
 
 // Initialize the network emulation
 //   addr is used to generate the socket name
 //   reliability says whether we drop packets to emulate unreliable links
 //   readAvail, writeDone, callArg -- analogous to console
+//   carrier carries the packets; if NULL, we use UNIX sockets
+//   maxPacket is the largest packet we send, header included
 Network::Network(NetworkAddress addr, double reliability,
-	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg)
+	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	Transport *carrier, int maxPacket)
 {
     ident = addr;
-    if (reliability < 0) chanceToWork = 0;
-    else if (reliability > 1) chanceToWork = 1;
-    else chanceToWork = reliability;
+    SetLink(reliability, maxPacket);
 
     // set up the stuff to emulate asynchronous interrupts
     writeHandler = writeDone;
@@ -38,45 +45,106 @@ Network::Network(NetworkAddress addr, double reliability,
     handlerArg = callArg;
     sendBusy = FALSE;
     inHdr.length = 0;
+    checkPending = FALSE;
+    stalled = FALSE;
     
-    sock = OpenSocket();
-    sprintf(sockName, "SOCKET_%d", (int)addr);
-    AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
-						 // in the current directory.
+    if (carrier == NULL)
+	carrier = new SocketTransport(addr);
+    transport = carrier;
+
+    // a transport that tells us when a packet arrives saves us from
+    // polling for one; otherwise, start polling
+    if (transport->CanNotify())
+	transport->SetArrivalHandler(NetworkArrived, (int)this);
+    else
+	ScheduleCheck();
+}
+
+Network::~Network()
+{
+    delete transport;
+}
+
+// change how likely a packet is to get through, and the largest
+// packet we send
+void
+Network::SetLink(double reliability, int maxPacket)
+{
+    ASSERT(maxPacket > (int)sizeof(PacketHeader) && maxPacket <= MaxWireSize);
+    mtu = maxPacket;
+    if (reliability < 0) chanceToWork = 0;
+    else if (reliability > 1) chanceToWork = 1;
+    else chanceToWork = reliability;
+}
 
-    // start polling for incoming packets
+// arrange for CheckPktAvail to run NetworkTime from now, unless it
+// already will
+void
+Network::ScheduleCheck()
+{
+    if (checkPending)
+	return;
+    checkPending = TRUE;
     interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
 }
 
-Network::~Network()
+// the transport has queued a packet for us; it takes NetworkTime to 
+// come in
+void
+Network::PacketArrived()
 {
-    CloseSocket(sock);
-    DeAssignNameToSocket(sockName);
+    ScheduleCheck();
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
-// packet might be dropped if we can't read it in time.
+// check for an incoming packet, once every NetworkTime for as long
+// as packets keep coming in
 void
 Network::CheckPktAvail()
 {
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    checkPending = FALSE;
+    // schedule the next time to poll for a packet; but if no thread
+    // can run and nothing else is pending, only a packet can wake the
+    // machine, so wait for one if the transport lets us
+    if (!transport->CanNotify()) {
+	if (interrupt->Idling() && interrupt->NextDue() == NoPendingInterrupt
+		&& !transport->Poll())
+	    (void) transport->WaitForPacket();
+	ScheduleCheck();
+    }
 
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
-	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
-	return;
+    ReadPacket();
+    if (transport->CanNotify() && transport->Poll())
+	ScheduleCheck();	// the next one is already waiting
+}
 
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
+// the packet that was held up in ReadPacket has come in
+void
+Network::ReadStalled()
+{
+    ReadPacket();
+    if (transport->CanNotify() && transport->Poll())
+	ScheduleCheck();
+}
 
-    // divide packet into header and data
-    inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete []buffer ;
+// if a packet is already buffered, we simply delay reading 
+// the incoming packet until Receive empties the buffer.  In real 
+// life, the incoming packet might be dropped if we can't read it 
+// in time.
+void
+Network::ReadPacket()
+{
+    if (!transport->Poll()) 	// do nothing if no packet to be read
+	return;
+    if (inHdr.length != 0) { 	// do nothing if packet is already buffered
+	stalled = TRUE;		// (Receive has it read)
+	return;
+    }
+
+    // otherwise, read packet in; the data stays where it landed
+    int size = transport->Receive(inbox);
+    inHdr = *(PacketHeader *)inbox;
+    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize)
+		&& (size == (int)(sizeof(PacketHeader) + inHdr.length)));
 
     DEBUG('n', "Network received packet from %d, length %d...\n",
 	  				(int) inHdr.from, inHdr.length);
@@ -95,20 +163,33 @@ Network::SendDone()
     (*writeHandler)(handlerArg);
 }
 
-// send a packet by concatenating hdr and data, and schedule
-// an interrupt to tell the user when the next packet can be sent 
-//
-// Note we always pad out a packet to MaxWireSize before putting it into
-// the socket, because it's simpler at the receive end.
+// send a packet made of hdr and data, and schedule an interrupt to 
+// tell the user when the next packet can be sent 
 void
 Network::Send(PacketHeader hdr, char* data)
 {
-    char toName[32];
+    IoVec iov;
 
-    sprintf(toName, "SOCKET_%d", (int)hdr.to);
-    
-    ASSERT((sendBusy == FALSE) && (hdr.length > 0) 
-		&& (hdr.length <= MaxPacketSize) && (hdr.from == ident));
+    iov.base = data;
+    iov.length = hdr.length;
+    SendV(hdr, &iov, 1);
+}
+
+// send a packet made of hdr and the pieces of data in iov.  The 
+// transport gathers them straight onto the wire.
+void
+Network::SendV(PacketHeader hdr, IoVec *iov, int iovCount)
+{
+    IoVec wire[MaxIoVecs + 1];
+    unsigned length = 0;
+
+    ASSERT(iovCount <= MaxIoVecs);
+    for (int i = 0; i < iovCount; i++) {
+	wire[i + 1] = iov[i];
+	length += iov[i].length;
+    }
+    ASSERT((sendBusy == FALSE) && (hdr.length > 0) && (hdr.length == length)
+		&& ((int)hdr.length <= MaxPacket()) && (hdr.from == ident));
     DEBUG('n', "Sending to addr %d, %d bytes... ", hdr.to, hdr.length);
 
     interrupt->Schedule(NetworkSendDone, (int)this, NetworkTime, NetworkSendInt);
@@ -118,22 +199,53 @@ Network::Send(PacketHeader hdr, char* data)
 	return;
     }
 
-    // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
-    *(PacketHeader *)buffer = hdr;
-    bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete []buffer;
+    wire[0].base = (char *)&hdr;
+    wire[0].length = sizeof(PacketHeader);
+    transport->Send(hdr.to, wire, iovCount + 1);
 }
 
 // read a packet, if one is buffered
 PacketHeader
 Network::Receive(char* data)
+{
+    IoVec iov;
+
+    iov.base = data;
+    iov.length = MaxPacketSize;
+    return ReceiveV(&iov, 1);
+}
+
+// read a packet, if one is buffered, scattering its data into the 
+// pieces in iov
+PacketHeader
+Network::ReceiveV(IoVec *iov, int iovCount)
 {
     PacketHeader hdr = inHdr;
+    char *from = inbox + sizeof(PacketHeader);
+    unsigned left = hdr.length;
 
     inHdr.length = 0;
-    if (hdr.length != 0)
-    	bcopy(inbox, data, hdr.length);
+    for (int i = 0; i < iovCount && left > 0; i++) {
+	unsigned n = min(iov[i].length, left);
+
+	bcopy(from, iov[i].base, n);
+	from += n;
+	left -= n;
+    }
+    ASSERT(left == 0);
+    if (stalled) {		// the next one has been in the device 
+	stalled = FALSE;	// all along; it only needs copying
+	interrupt->Schedule(NetworkReadNow, (int)this, 1, NetworkRecvInt);
+    }
     return hdr;
 }
+
+// look at the start of the buffered packet, if there is one, without
+// reading it
+PacketHeader
+Network::Peek(char *data, int length)
+{
+    if (inHdr.length != 0)
+	bcopy(inbox + sizeof(PacketHeader), data, min(length, (int)inHdr.length));
+    return inHdr;
+}
@@ -1,7 +1,8 @@
 // network.h 
 //	Data structures to emulate a physical network connection.
 //	The network provides the abstraction of ordered, unreliable,
-//	fixed-size packet delivery to other machines on the network.
+//	packet delivery to other machines on the network.  Packets are
+//	at most the device's MTU (maximum transmission unit) in size.
 //
 //	You may note that the interface to the network is similar to 
 //	the console device -- both are full duplex channels.
@@ -37,26 +38,53 @@ class PacketHeader {
 				// MailHeader prepended by the post office)
 };
 
-#define MaxWireSize 	64	// largest packet that can go out on the wire
+#define MaxWireSize 	2048	// largest packet that can go out on the wire,
+				// whatever the MTU
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
+#define DefaultMtu	MaxWireSize
+
+// The following class describes one piece of the data of a packet.  A
+// packet can be sent from several pieces -- a header in one place and
+// the payload in another, say -- and is gathered from them as it goes
+// out on the wire, without being copied into one buffer first.
+
+class IoVec {
+  public:
+    char *base;			// where the piece is
+    unsigned length;		// how many bytes it has
+};
+
+#define MaxIoVecs	8	// most pieces in one packet
+
+class Transport;
 
 
 // The following class defines a physical network device.  The network
 // is capable of delivering fixed sized packets, in order but unreliably, 
 // to other machines connected to the network.
 //
+// How packets get to the other machines is up to a Transport (see
+// transport.h); by default, it is a UNIX socket per machine.
+//
+// The MTU, the largest packet the device sends, header included, can
+// also be given to the constructor; it is at most MaxWireSize.  Packets
+// of any size up to MaxWireSize are received.
+//
 // The "reliability" of the network can be specified to the constructor.
 // This number, between 0 and 1, is the chance that the network will lose 
 // a packet.  Note that you can change the seed for the random number 
 // generator, by changing the arguments to RandomInit() in Initialize().
 // The random number generator is used to choose which packets to drop.
+// Both the reliability and the MTU can be changed later with SetLink.
 
 class Network {
   public:
     Network(NetworkAddress addr, double reliability,
-  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg);
-				// Allocate and initialize network driver
+  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	  Transport *carrier = NULL, int maxPacket = DefaultMtu);
+				// Allocate and initialize network driver;
+				// it owns "carrier", if one is given
     ~Network();			// De-allocate the network driver data
     
     void Send(PacketHeader hdr, char* data);
@@ -68,6 +96,15 @@ class Network {
 				// dropped, and note that the "from" field of 
 				// the PacketHeader is filled in automatically 
 				// by Send().
+    void SendV(PacketHeader hdr, IoVec *iov, int iovCount);
+				// Same, but the data is gathered from 
+				// "iovCount" pieces; "hdr.length" is their
+				// total length
+    int MaxPacket() { return mtu - sizeof(PacketHeader); }
+				// Largest "hdr.length" we can send
+    void SetLink(double reliability, int maxPacket);
+				// Change the reliability and the MTU;
+				// packets already sent are not affected
 
     PacketHeader Receive(char* data);
     				// Poll the network for incoming messages.  
@@ -75,16 +112,32 @@ class Network {
 				// packet into "data" and return the header.
 				// If no packet is waiting, return a header 
 				// with length 0.
+    PacketHeader ReceiveV(IoVec *iov, int iovCount);
+				// Same, but the data is scattered into
+				// "iovCount" pieces, filled in order; they
+				// must have room for all of it
+    PacketHeader Peek(char *data, int length);
+				// Copy the first "length" bytes (at most)
+				// of the waiting packet into "data", and
+				// return its header; the packet stays
+				// waiting for Receive
 
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
     void CheckPktAvail();	// Check if there is an incoming packet
+    void PacketArrived();	// Called by the transport when it has
+				// a packet for us
+    void ReadStalled();		// Called once Receive has made room for
+				// a packet that came in while the last
+				// one was still buffered
 
   private:
     NetworkAddress ident;	// This machine's network address
     double chanceToWork;	// Likelihood packet will be dropped
-    int sock;			// UNIX socket number for incoming packets
-    char sockName[32];		// File name corresponding to UNIX socket
+    Transport *transport;	// Carries packets to other machines
+    int mtu;			// Largest packet we send, header included
+    bool checkPending;		// CheckPktAvail is scheduled
+    bool stalled;		// A packet came in while inbox was full
     VoidFunctionPtr writeHandler; // Interrupt handler, signalling next packet 
 				//      can be sent.  
     VoidFunctionPtr readHandler;  // Interrupt handler, signalling packet has 
@@ -95,7 +148,11 @@ class Network {
     bool packetAvail;		// Packet has arrived, can be pulled off of
 				//   network
     PacketHeader inHdr;		// Information about arrived packet
-    char inbox[MaxPacketSize];  // Data for arrived packet
+    char inbox[MaxWireSize];	// Arrived packet, header and data
+
+    void ScheduleCheck();	// Schedule CheckPktAvail, once
+    void ReadPacket();		// Read a packet into inbox, if there is
+				// one and inbox is empty
 };
 
 #endif // NETWORK_H
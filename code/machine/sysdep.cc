@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -45,6 +46,10 @@ extern "C" {
 #include <fcntl.h>
 #include <sys/time.h>
 #endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 
 // UNIX routines called by procedures in this file 
@@ -348,10 +353,11 @@ PollSocket(int sockID)
 
 //----------------------------------------------------------------------
 // ReadFromSocket
-// 	Read a fixed size packet off the IPC port.  Abort on error.
+// 	Read a packet of at most "maxSize" bytes off the IPC port, and
+//	return its size.  Abort on error.
 //----------------------------------------------------------------------
-void
-ReadFromSocket(int sockID, char *buffer, int packetSize)
+int
+ReadFromSocket(int sockID, char *buffer, int maxSize)
 {
     int retVal;
     //    extern int errno;	errno sometimes defined as a macro
@@ -362,19 +368,20 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
     int size = sizeof(uName);
 #endif
 
-    retVal = recvfrom(sockID, buffer, packetSize, 0,
+    retVal = recvfrom(sockID, buffer, maxSize, 0,
 				   (struct sockaddr *) &uName, &size);
 
-    if (retVal != packetSize) {
+    if (retVal <= 0) {
         perror("in recvfrom");
         printf("called: %x, got back %d, %d\n", (unsigned int) buffer, retVal, errno);
     }
-    ASSERT(retVal == packetSize);
+    ASSERT(retVal > 0);
+    return retVal;
 }
 
 //----------------------------------------------------------------------
 // SendToSocket
-// 	Transmit a fixed size packet to another Nachos' IPC port.
+// 	Transmit a packet to another Nachos' IPC port.
 //	Abort on error.
 //----------------------------------------------------------------------
 void
@@ -390,6 +397,91 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
 }
 
 
+//----------------------------------------------------------------------
+// MapSharedFile
+// 	Map "size" bytes of file "name" into our address space, so that
+//	other Nachos processes mapping the same file see what we write.
+//	If "create", the file is created (or truncated) and zero filled;
+//	otherwise, return NULL if it does not exist.
+//----------------------------------------------------------------------
+
+char *
+MapSharedFile(char *name, int size, bool create)
+{
+    int fd, retVal;
+    void *addr;
+
+    if (create) {
+	fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0666);
+	ASSERT(fd >= 0);
+	retVal = ftruncate(fd, size);
+	ASSERT(retVal == 0);
+    } else {
+	fd = open(name, O_RDWR, 0);
+	if (fd < 0)
+	    return NULL;
+    }
+    addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);				// the mapping keeps the file open
+    ASSERT(addr != MAP_FAILED);
+    return (char *)addr;
+}
+
+//----------------------------------------------------------------------
+// UnmapSharedFile
+// 	Undo MapSharedFile.
+//----------------------------------------------------------------------
+
+void
+UnmapSharedFile(char *addr, int size)
+{
+    munmap(addr, size);
+}
+
+//----------------------------------------------------------------------
+// CompareAndSwap / MemoryBarrier
+// 	Atomic operations on memory shared with other Nachos processes.
+//----------------------------------------------------------------------
+
+bool
+CompareAndSwap(volatile unsigned *addr, unsigned oldValue, unsigned newValue)
+{
+    return __sync_bool_compare_and_swap(addr, oldValue, newValue);
+}
+
+void
+MemoryBarrier()
+{
+    __sync_synchronize();
+}
+
+//----------------------------------------------------------------------
+// WaitWhileEqual / WakeWaiters
+// 	Sleep until another Nachos process changes a word in memory we
+//	share with it, and wakes us.  On Linux, the kernel queues us on
+//	the word itself (a futex); elsewhere, we look at it again every
+//	millisecond.  Either may return early; the caller checks again.
+//----------------------------------------------------------------------
+
+void
+WaitWhileEqual(volatile unsigned *addr, unsigned value)
+{
+#ifdef __linux__
+    (void) syscall(SYS_futex, addr, FUTEX_WAIT, value, NULL, NULL, 0);
+#else
+    if (*addr == value)
+	usleep(1000);
+#endif
+}
+
+void
+WakeWaiters(volatile unsigned *addr)
+{
+#ifdef __linux__
+    (void) syscall(SYS_futex, addr, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+#endif
+}
+
 //----------------------------------------------------------------------
 // CallOnUserAbort
 // 	Arrange that "func" will be called when the user aborts (e.g., by
@@ -415,6 +507,43 @@ Delay(int seconds)
     (void) sleep((unsigned) seconds);
 }
 
+//----------------------------------------------------------------------
+// ForkProcess
+// 	Make a copy of the UNIX process running Nachos, as UNIX fork.
+//	Pending output is flushed first, so that it is not printed by
+//	both copies.  Return the child's process id in the parent, and
+//	0 in the child.
+//----------------------------------------------------------------------
+
+int
+ForkProcess()
+{
+    int pid;
+
+    fflush(stdout);
+    pid = fork();
+    ASSERT(pid != -1);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// WaitProcess
+// 	Wait for the child process "pid" to exit, and return its exit
+//	status, or -1 if it was killed by a signal (or is not our child).
+//----------------------------------------------------------------------
+
+int
+WaitProcess(int pid)
+{
+    int status;
+
+    if (waitpid(pid, &status, 0) == -1)
+        return -1;
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -437,6 +566,21 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// WallClock
+// 	Return the time of day on the host, in seconds.  Used to time
+//	how fast Nachos itself runs; simulated time is in "stats".
+//----------------------------------------------------------------------
+
+double
+WallClock()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
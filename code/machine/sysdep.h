@@ -35,17 +35,42 @@ extern void CloseSocket(int sockID);
 extern void AssignNameToSocket(char *socketName, int sockID);
 extern void DeAssignNameToSocket(char *socketName);
 extern bool PollSocket(int sockID);
-extern void ReadFromSocket(int sockID, char *buffer, int packetSize);
+extern int ReadFromSocket(int sockID, char *buffer, int maxSize);
 extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
 
+// Memory shared between Nachos processes, for simulating the network
+extern char *MapSharedFile(char *name, int size, bool create);
+					// Map file "name" into memory, 
+					//  creating it if "create"; NULL 
+					//  if it does not exist
+extern void UnmapSharedFile(char *addr, int size);
+extern bool CompareAndSwap(volatile unsigned *addr, unsigned oldValue,
+			unsigned newValue);
+					// Atomically: if *addr == oldValue,
+					//  set it to newValue
+extern void MemoryBarrier();		// Order loads and stores to shared
+					//  memory
+extern void WaitWhileEqual(volatile unsigned *addr, unsigned value);
+					// Sleep until *addr != value, or
+					//  someone wakes us
+extern void WakeWaiters(volatile unsigned *addr);
+					// Wake the processes sleeping in
+					//  WaitWhileEqual on addr
+
 // Process control: abort, exit, and sleep
 extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
+extern int ForkProcess();		// UNIX fork; 0 in the child
+extern int WaitProcess(int pid);	// Wait for a child, return its 
+					//  exit status (-1 if it was killed)
 
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
+// Host (not simulated) time in seconds, for timing the simulator itself
+extern double WallClock();
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern int Random();
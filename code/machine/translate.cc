@@ -223,14 +223,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	    entry = &pageTable[vpn];
 #else
         for (int i=0; i<pageTableSize; ++i){
+            // other threads' pages may have the same vpn
             if (pageTable[i].valid &&
-                pageTable[i].virtualPage == vpn)
+                pageTable[i].virtualPage == vpn &&
+                pageTable[i].tid == currentThread->getTID())
             {
-                if (pageTable[i].tid == currentThread->getTID()){
-                    entry = &pageTable[i];
-                    break;
-                }
-                else return PageFaultException;
+                entry = &pageTable[i];
+                break;
             }
         }
        if (entry == NULL) return PageFaultException;
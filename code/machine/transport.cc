@@ -0,0 +1,330 @@
+// transport.cc
+//	Routines to carry packets between emulated network devices.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "transport.h"
+#include "system.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+//----------------------------------------------------------------------
+// Transport::Gather
+// 	Copy the pieces of a packet, one after the other, into "packet",
+//	and return the packet's size.
+//----------------------------------------------------------------------
+
+int
+Transport::Gather(char *packet, IoVec *iov, int iovCount)
+{
+    int size = 0;
+
+    for (int i = 0; i < iovCount; i++) {
+	ASSERT(size + iov[i].length <= MaxWireSize);
+	bcopy(iov[i].base, packet + size, iov[i].length);
+	size += iov[i].length;
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------
+// SocketTransport::SocketTransport
+// 	Open a UNIX socket, and bind it to a file name derived from our
+//	network address, so that other Nachos processes can find it.
+//----------------------------------------------------------------------
+
+SocketTransport::SocketTransport(NetworkAddress addr)
+{
+    sock = OpenSocket();
+    sprintf(sockName, "SOCKET_%d", (int)addr);
+    AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
+						 // in the current directory.
+}
+
+SocketTransport::~SocketTransport()
+{
+    CloseSocket(sock);
+    DeAssignNameToSocket(sockName);
+}
+
+//----------------------------------------------------------------------
+// SocketTransport::Send / Poll / Receive
+// 	Send a packet to the socket of machine "to"; check for, and read,
+//	a packet on our own socket.
+//----------------------------------------------------------------------
+
+void
+SocketTransport::Send(NetworkAddress to, IoVec *iov, int iovCount)
+{
+    char toName[32];
+    int size = Gather(wire, iov, iovCount);
+
+    sprintf(toName, "SOCKET_%d", (int)to);
+    SendToSocket(sock, wire, size, toName);
+}
+
+bool
+SocketTransport::Poll()
+{
+    return PollSocket(sock);
+}
+
+int
+SocketTransport::Receive(char *packet)
+{
+    return ReadFromSocket(sock, packet, MaxWireSize);
+}
+
+MemoryTransport **MemoryTransport::fabric = NULL;
+int MemoryTransport::fabricSize = 0;
+
+//----------------------------------------------------------------------
+// MemoryTransport::MemoryTransport
+// 	Join the in-memory fabric as machine "addr", growing the table of
+//	machines if need be.  Only one machine per address.
+//----------------------------------------------------------------------
+
+MemoryTransport::MemoryTransport(NetworkAddress addr)
+{
+    ASSERT(addr >= 0);
+    if (addr >= fabricSize) {
+        int newSize = (fabricSize == 0) ? 16 : fabricSize;
+        MemoryTransport **newFabric;
+
+        while (newSize <= addr)
+            newSize *= 2;
+        newFabric = new MemoryTransport *[newSize];
+        for (int i = 0; i < newSize; i++)
+            newFabric[i] = (i < fabricSize) ? fabric[i] : NULL;
+        delete [] fabric;
+        fabric = newFabric;
+        fabricSize = newSize;
+    }
+    ASSERT(fabric[addr] == NULL);
+    fabric[addr] = this;
+
+    ident = addr;
+    queue = new char[MemoryQueueSize * MaxWireSize];
+    sizes = new int[MemoryQueueSize];
+    head = count = 0;
+}
+
+MemoryTransport::~MemoryTransport()
+{
+    fabric[ident] = NULL;
+    delete [] queue;
+    delete [] sizes;
+}
+
+//----------------------------------------------------------------------
+// MemoryTransport::Send
+// 	Gather a packet straight into the queue of machine "to", and tell
+//	it that the packet is there.  The packet is lost if there is no
+//	such machine, or its queue is full.
+//----------------------------------------------------------------------
+
+void
+MemoryTransport::Send(NetworkAddress to, IoVec *iov, int iovCount)
+{
+    MemoryTransport *dest = (to >= 0 && to < fabricSize) ? fabric[to] : NULL;
+    int slot;
+
+    if (dest == NULL || dest->count == MemoryQueueSize) {
+        DEBUG('n', "No room at machine %d, packet lost\n", (int)to);
+        return;
+    }
+    slot = (dest->head + dest->count) % MemoryQueueSize;
+    dest->sizes[slot] = Gather(&dest->queue[slot * MaxWireSize], iov, iovCount);
+    dest->count++;
+    if (dest->arrivalHandler != NULL)
+        (*dest->arrivalHandler)(dest->arrivalArg);
+}
+
+//----------------------------------------------------------------------
+// MemoryTransport::Receive
+// 	Take the oldest packet off our queue.
+//----------------------------------------------------------------------
+
+int
+MemoryTransport::Receive(char *packet)
+{
+    int size = sizes[head];
+
+    ASSERT(count > 0);
+    bcopy(&queue[head * MaxWireSize], packet, size);
+    head = (head + 1) % MemoryQueueSize;
+    count--;
+    return size;
+}
+
+//----------------------------------------------------------------------
+// ShmTransport::ShmTransport
+// 	Create the file holding our ring, and map it.  A file left behind
+//	by an earlier machine with our address is removed first, so that
+//	senders still mapping it do not write into the new ring.
+//----------------------------------------------------------------------
+
+ShmTransport::ShmTransport(NetworkAddress addr)
+{
+    ident = addr;
+    sprintf(ringName, "RING_%d", (int)addr);
+    Unlink(ringName);
+    ring = (ShmRing *)MapSharedFile(ringName, sizeof(ShmRing), TRUE);
+    ring->live = 1;			// the file starts out zero filled
+    peers = NULL;
+    numPeers = 0;
+}
+
+ShmTransport::~ShmTransport()
+{
+    ring->live = 0;			// senders must map the file again
+    MemoryBarrier();
+    UnmapSharedFile((char *)ring, sizeof(ShmRing));
+    Unlink(ringName);
+    for (int i = 0; i < numPeers; i++)
+	if (peers[i] != NULL)
+	    UnmapSharedFile((char *)peers[i], sizeof(ShmRing));
+    delete [] peers;
+}
+
+//----------------------------------------------------------------------
+// ShmTransport::FindPeer
+// 	Return the ring of machine "to", mapping it if it is not mapped
+//	yet, or if the machine went away since.  Return NULL if "to" is
+//	not running.
+//----------------------------------------------------------------------
+
+ShmRing *
+ShmTransport::FindPeer(NetworkAddress to)
+{
+    char toName[32];
+    ShmRing *peer;
+
+    if (to == ident)
+	return ring;
+    if (to < 0)
+	return NULL;
+    if (to >= numPeers) {
+	int newSize = (numPeers == 0) ? 16 : numPeers;
+	ShmRing **newPeers;
+
+	while (newSize <= to)
+	    newSize *= 2;
+	newPeers = new ShmRing *[newSize];
+	for (int i = 0; i < newSize; i++)
+	    newPeers[i] = (i < numPeers) ? peers[i] : NULL;
+	delete [] peers;
+	peers = newPeers;
+	numPeers = newSize;
+    }
+    if (peers[to] != NULL && peers[to]->live)
+	return peers[to];
+
+    if (peers[to] != NULL) {		// it went away; it may be back
+	UnmapSharedFile((char *)peers[to], sizeof(ShmRing));
+	peers[to] = NULL;
+    }
+    sprintf(toName, "RING_%d", (int)to);
+    peer = (ShmRing *)MapSharedFile(toName, sizeof(ShmRing), FALSE);
+    if (peer != NULL && !peer->live) {
+	UnmapSharedFile((char *)peer, sizeof(ShmRing));
+	peer = NULL;
+    }
+    peers[to] = peer;
+    return peer;
+}
+
+//----------------------------------------------------------------------
+// ShmTransport::Send
+// 	Claim a slot in the ring of machine "to", gather the packet into
+//	it, and mark it ready; then ring the bell, waking "to" if it is
+//	waiting for a packet.  The packet is lost if there is no such
+//	machine, or its ring is full.
+//----------------------------------------------------------------------
+
+void
+ShmTransport::Send(NetworkAddress to, IoVec *iov, int iovCount)
+{
+    ShmRing *dest = FindPeer(to);
+    unsigned n, bell;
+
+    if (dest == NULL) {
+	DEBUG('n', "Machine %d is not running, packet lost\n", (int)to);
+	return;
+    }
+    do {
+	n = dest->tail;
+	if (n - dest->head >= ShmRingSlots) {
+	    DEBUG('n', "No room at machine %d, packet lost\n", (int)to);
+	    return;
+	}
+    } while (!CompareAndSwap(&dest->tail, n, n + 1));
+
+    dest->size[n % ShmRingSlots] = 
+		Gather(dest->slot[n % ShmRingSlots], iov, iovCount);
+    MemoryBarrier();			// the packet is there before it
+    dest->ready[n % ShmRingSlots] = n + 1;	//  is marked ready
+
+    do {
+	bell = dest->bell;
+    } while (!CompareAndSwap(&dest->bell, bell, bell + 1));
+    MemoryBarrier();			// marked ready before we look
+    if (dest->sleeping)			//  whether the owner sleeps
+	WakeWaiters(&dest->bell);
+}
+
+//----------------------------------------------------------------------
+// ShmTransport::Poll / Receive
+// 	Check whether the oldest packet in our ring is ready; take it.
+//----------------------------------------------------------------------
+
+bool
+ShmTransport::Poll()
+{
+    unsigned n = ring->head;
+
+    return ring->ready[n % ShmRingSlots] == n + 1;
+}
+
+int
+ShmTransport::Receive(char *packet)
+{
+    unsigned n = ring->head;
+    int size;
+
+    ASSERT(Poll());
+    MemoryBarrier();
+    size = ring->size[n % ShmRingSlots];
+    ASSERT(size <= MaxWireSize);
+    bcopy(ring->slot[n % ShmRingSlots], packet, size);
+    MemoryBarrier();			// done with the slot before
+    ring->head = n + 1;			//  senders may claim it again
+    return size;
+}
+
+//----------------------------------------------------------------------
+// ShmTransport::WaitForPacket
+// 	Sleep until the oldest packet in our ring is ready.  We say we are
+//	sleeping before we look at the ring, and a sender marks a packet
+//	ready before it looks whether we are, so one of us always sees
+//	the other: either we find the packet, or the sender wakes us.
+//----------------------------------------------------------------------
+
+bool
+ShmTransport::WaitForPacket()
+{
+    unsigned bell;
+
+    ring->sleeping = 1;
+    MemoryBarrier();
+    for (bell = ring->bell; !Poll(); bell = ring->bell)
+	WaitWhileEqual(&ring->bell, bell);
+    ring->sleeping = 0;
+    return TRUE;
+}
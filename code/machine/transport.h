@@ -0,0 +1,171 @@
+// transport.h
+//	Data structures to move packets between emulated network devices.
+//
+//	The Network device decides when packets go out and come in; a
+//	Transport only carries the bytes.  Three are provided:
+//
+//	   SocketTransport -- one Nachos process per machine, packets go
+//		through UNIX sockets named after the machine's address
+//	   MemoryTransport -- several machines in one Nachos process,
+//		packets are copied straight into the receiver's queue
+//	   ShmTransport -- one Nachos process per machine, packets are
+//		copied straight into a ring in memory shared with the
+//		receiver
+//
+//	A MemoryTransport knows the moment a packet arrives, so the device
+//	does not have to poll for one; the others do not.  The device
+//	still polls a ShmTransport every NetworkTime while the machine has
+//	work to do, but a poll is a load from memory rather than a system
+//	call; once nothing else can happen until a packet comes in, the
+//	Nachos process sleeps until a sender wakes it, rather than rolling
+//	simulated time forward one poll at a time.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "network.h"
+
+// The following class defines what the Network device needs from a
+// transport.  A packet is at most MaxWireSize bytes, and is sent as
+// a list of pieces, which the transport gathers into wherever the
+// packet goes.
+
+class Transport {
+  public:
+    Transport() { arrivalHandler = NULL; arrivalArg = 0; }
+    virtual ~Transport() {}
+
+    virtual void Send(NetworkAddress to, IoVec *iov, int iovCount) = 0;
+				// Deliver a packet to machine "to", or
+				// drop it if it cannot be delivered
+    virtual bool Poll() = 0;	// Is a packet waiting?
+    virtual int Receive(char *packet) = 0;
+				// Take the packet that is waiting, into
+				// MaxWireSize bytes; return its size
+
+    virtual bool CanNotify() { return FALSE; }
+				// Does it call the arrival handler?
+    virtual bool WaitForPacket() { return FALSE; }
+				// Sleep until a packet is waiting; 
+				// FALSE if we cannot
+    void SetArrivalHandler(VoidFunctionPtr handler, int arg)
+	{ arrivalHandler = handler; arrivalArg = arg; }
+				// Call "handler" when a packet arrives
+
+  protected:
+    VoidFunctionPtr arrivalHandler;
+    int arrivalArg;
+
+    static int Gather(char *packet, IoVec *iov, int iovCount);
+				// Copy the pieces into "packet"; return
+				// the packet's size
+};
+
+// The following class defines the transport between Nachos processes:
+// a UNIX datagram socket, bound to the file "SOCKET_<address>" in the
+// current directory.
+
+class SocketTransport : public Transport {
+  public:
+    SocketTransport(NetworkAddress addr);	// Open our socket
+    ~SocketTransport();				// Close and remove it
+
+    void Send(NetworkAddress to, IoVec *iov, int iovCount);
+    bool Poll();
+    int Receive(char *packet);
+
+  private:
+    int sock;			// UNIX socket number for incoming packets
+    char sockName[32];		// File name corresponding to UNIX socket
+    char wire[MaxWireSize];	// Packet being sent
+};
+
+// The following class defines the transport between machines in one
+// Nachos process.  Every MemoryTransport is registered in a table by
+// address, so a sender finds the receiver's queue directly.  The queue
+// has room for a fixed number of packets; more are dropped, as a real
+// interface would when nobody reads them.
+
+#define MemoryQueueSize	16	// packets queued at one machine
+
+class MemoryTransport : public Transport {
+  public:
+    MemoryTransport(NetworkAddress addr);	// Join the in-memory fabric
+    ~MemoryTransport();				// Leave it
+
+    void Send(NetworkAddress to, IoVec *iov, int iovCount);
+    bool Poll() { return count > 0; }
+    int Receive(char *packet);
+    bool CanNotify() { return TRUE; }
+
+  private:
+    NetworkAddress ident;
+    char *queue;		// MemoryQueueSize packets, as a ring
+    int *sizes;			// the size of each
+    int head;			// oldest queued packet
+    int count;			// # of queued packets
+
+    static MemoryTransport **fabric;	// every MemoryTransport, by address
+    static int fabricSize;
+};
+
+// The following class defines the ring of packets queued at a machine,
+// as laid out in shared memory.  Any number of senders may claim slots
+// at once, by advancing "tail"; only the owner takes packets out, by
+// advancing "head".  A claimed slot is not taken until its sender has
+// marked it ready.  A sender then rings "bell", and wakes the owner if
+// it is sleeping on it.
+
+#define ShmRingSlots	64	// packets queued at one machine
+
+class ShmRing {
+  public:
+    volatile unsigned head;	// # of packets taken by the owner
+    volatile unsigned tail;	// # of slots claimed by senders
+    volatile unsigned live;	// 0 once the owner has gone away
+    volatile unsigned bell;	// # of packets marked ready
+    volatile unsigned sleeping;	// 1 while the owner waits on "bell"
+    volatile unsigned ready[ShmRingSlots];
+				// packet number n is in slot 
+				//  n % ShmRingSlots once ready[] is n + 1
+    unsigned size[ShmRingSlots];	// size of the packet in each slot
+    char slot[ShmRingSlots][MaxWireSize];
+};
+
+// The following class defines the transport between Nachos processes
+// on one host, through shared memory.  Each machine creates the file
+// "RING_<address>" in the current directory, holding its ring, and
+// maps it; a sender maps the receiver's file the first time it sends
+// to it.  As with sockets, a packet to a machine that is not running,
+// or whose ring is full, is lost.
+
+class ShmTransport : public Transport {
+  public:
+    ShmTransport(NetworkAddress addr);	// Create and map our ring
+    ~ShmTransport();			// Unmap it and remove it; unmap 
+					//  the rings we send to
+
+    void Send(NetworkAddress to, IoVec *iov, int iovCount);
+    bool Poll();
+    int Receive(char *packet);
+    bool WaitForPacket();
+
+  private:
+    NetworkAddress ident;
+    char ringName[32];		// File holding our ring
+    ShmRing *ring;		// Our ring
+    ShmRing **peers;		// Rings of the machines we send to, by
+    int numPeers;		//  address; NULL if not mapped
+
+    ShmRing *FindPeer(NetworkAddress to);	// Map the ring of "to"
+};
+
+#endif // TRANSPORT_H
@@ -22,6 +22,10 @@
 #include "network.h"
 #include "post.h"
 #include "interrupt.h"
+#include "transport.h"
+#include "stream.h"
+#include "rpc.h"
+#include "remotefs.h"
 
 // Test out message delivery, by doing the following:
 //	1. send a message to the machine with ID "farAddr", at mail box #0
@@ -70,3 +74,643 @@ MailTest(int farAddr)
     // Then we're done!
     interrupt->Halt();
 }
+
+// Test out many machines in one Nachos process, connected by the
+// in-memory transport: "numNodes" post offices are set up in a ring,
+// and every machine sends RingRounds messages to the next one while
+// receiving as many from the one before.  All the machines share the
+// one simulated clock, so no time synchronization is needed.
+
+#define RingRounds	20
+
+static PostOffice **ringNodes;
+static int ringSize;
+static Semaphore *ringDone;
+
+static void
+RingNode(int which)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char buffer[MaxMailSize];
+
+    outPktHdr.to = (which + 1) % ringSize;
+    outMailHdr.to = 0;
+    outMailHdr.from = 1;
+    for (int i = 0; i < RingRounds; i++) {
+	sprintf(buffer, "%d from %d", i, which);
+	outMailHdr.length = strlen(buffer) + 1;
+	ringNodes[which]->Send(outPktHdr, outMailHdr, buffer);
+	ringNodes[which]->Receive(0, &inPktHdr, &inMailHdr, buffer);
+	ASSERT(inPktHdr.from == (which + ringSize - 1) % ringSize);
+    }
+    ringDone->V();
+}
+
+void
+RingTest(int numNodes)
+{
+    int ticks = stats->totalTicks;
+    double start = WallClock();
+
+    ringSize = numNodes;
+    ringNodes = new PostOffice *[numNodes];
+    ringDone = new Semaphore("ring done", 0);
+    for (int i = 0; i < numNodes; i++)
+	ringNodes[i] = new PostOffice(i, 1.0, 2, new MemoryTransport(i));
+    for (int i = 0; i < numNodes; i++)
+	(new Thread("ring node"))->Fork(RingNode, i);
+    for (int i = 0; i < numNodes; i++)
+	ringDone->P();
+    printf("%d machines, %d messages: %d ticks, %.3f seconds\n",
+	    numNodes, numNodes * RingRounds, stats->totalTicks - ticks,
+	    WallClock() - start);
+    fflush(stdout);
+    interrupt->Halt();
+}
+
+// The benchmarks below each run a pair of machines in this process,
+// connected by the in-memory transport: "from", with address PairFrom,
+// and "to", with address PairTo.  A benchmark makes its pair once, and
+// changes the link between runs with SetLink.
+
+#define PairFrom	0
+#define PairTo		1
+
+static void
+ConnectedPair(int nBoxes, PostOffice **from, PostOffice **to)
+{
+    *from = new PostOffice(PairFrom, 1.0, nBoxes, new MemoryTransport(PairFrom));
+    *to = new PostOffice(PairTo, 1.0, nBoxes, new MemoryTransport(PairTo));
+}
+
+// Time a run: StopTiming returns the ticks since StartTiming, and the
+// seconds of wall-clock time in "*seconds".
+
+static int timingTicks;
+static double timingStart;
+
+static void
+StartTiming()
+{
+    timingTicks = stats->totalTicks;
+    timingStart = WallClock();
+}
+
+static int
+StopTiming(double *seconds)
+{
+    *seconds = WallClock() - timingStart;
+    return max(stats->totalTicks - timingTicks, 1);
+}
+
+// Time sending "kbytes" kilobytes from one machine to another, in the
+// largest messages that fit the MTU, at each of the MTUs below.
+
+static int throughputMtus[] = { 64, 256, 1024, MaxWireSize };
+#define NumThroughputMtus	(int)(sizeof(throughputMtus) / sizeof(int))
+
+static PostOffice *sink;
+static int sinkBytes;
+static Semaphore *sinkDone;
+
+static void
+ThroughputSink(int bytes)
+{
+    PacketHeader inPktHdr;
+    MailHeader inMailHdr;
+    char *buffer = new char[MaxMailSize];
+    int got = 0;
+
+    while (got < bytes) {
+	sink->Receive(0, &inPktHdr, &inMailHdr, buffer);
+	got += inMailHdr.length;
+    }
+    sinkBytes = got;
+    delete [] buffer;
+    sinkDone->V();
+}
+
+void
+ThroughputTest(int kbytes)
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+    char *buffer = new char[MaxMailSize];
+    int bytes = kbytes * 1024;
+    PostOffice *source;
+
+    memset(buffer, 'x', MaxMailSize);
+    sinkDone = new Semaphore("sink done", 0);
+    ConnectedPair(1, &source, &sink);
+    outPktHdr.to = PairTo;
+    outMailHdr.to = 0;
+    outMailHdr.from = 0;
+    for (int i = 0; i < NumThroughputMtus; i++) {
+	int mtu = throughputMtus[i], packets = stats->numPacketsSent, ticks;
+	double seconds;
+
+	source->SetLink(1.0, mtu);
+	sink->SetLink(1.0, mtu);
+	StartTiming();
+	(new Thread("sink"))->Fork(ThroughputSink, bytes);
+	for (int sent = 0; sent < bytes; sent += outMailHdr.length) {
+	    outMailHdr.length = min(source->MaxMail(), bytes - sent);
+	    source->Send(outPktHdr, outMailHdr, buffer);
+	}
+	sinkDone->P();
+	ticks = StopTiming(&seconds);
+	printf("mtu %4d: %d bytes in %d packets, %d ticks, "
+		"%d bytes per 1000 ticks, %.3f seconds\n",
+		mtu, sinkBytes, stats->numPacketsSent - packets, ticks,
+		(int)(sinkBytes * 1000.0 / ticks), seconds);
+    }
+    fflush(stdout);
+    delete [] buffer;
+    interrupt->Halt();
+}
+
+// Time "numSenders" threads on one machine sending "messages" short
+// messages between them to a single mailbox on another, for 1, 4 and
+// 16 senders, on one pair of machines.
+
+#define SendersMessageSize	16
+
+static int senderCounts[] = { 1, 4, 16 };
+#define NumSenderCounts		(int)(sizeof(senderCounts) / sizeof(int))
+
+static PostOffice *senderSource;
+static int senderShare;
+
+static void
+SenderNode(int to)
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+    char buffer[SendersMessageSize];
+
+    outPktHdr.to = to;
+    outMailHdr.to = 0;
+    outMailHdr.from = 0;
+    outMailHdr.length = SendersMessageSize;
+    memset(buffer, 'x', SendersMessageSize);
+    for (int i = 0; i < senderShare; i++)
+	senderSource->Send(outPktHdr, outMailHdr, buffer);
+}
+
+void
+SendersTest(int messages)
+{
+    sinkDone = new Semaphore("sink done", 0);
+    ConnectedPair(1, &senderSource, &sink);
+    for (int i = 0; i < NumSenderCounts; i++) {
+	int n = senderCounts[i], ticks;
+	double seconds;
+
+	StartTiming();
+	senderShare = messages / n;
+	(new Thread("sink"))->Fork(ThroughputSink,
+				senderShare * n * SendersMessageSize);
+	for (int j = 0; j < n; j++)
+	    (new Thread("sender"))->Fork(SenderNode, PairTo);
+	sinkDone->P();
+	ticks = StopTiming(&seconds);
+	printf("%2d senders: %d messages, %d ticks, "
+		"%d messages per 1000 ticks, %.0f messages per second\n",
+		n, senderShare * n, ticks, (senderShare * n * 1000) / ticks,
+		(seconds > 0) ? senderShare * n / seconds : 0.0);
+    }
+    fflush(stdout);
+    interrupt->Halt();
+}
+
+// Time a reliable stream carrying "kbytes" kilobytes from one machine
+// to another, as the network loses more and more packets (both the
+// segments and the acks).  The data is checked as it is read.  Each run
+// has its own mailboxes on the one pair of machines, so that a late
+// segment or ack from one run is not taken for part of the next.
+
+#define GoodputChunk	4096
+
+static double goodputReliability[] = { 1.0, 0.9, 0.8, 0.7 };
+#define NumGoodputRuns	(int)(sizeof(goodputReliability) / sizeof(double))
+
+static Stream *goodputStream;
+static int goodputBytes;
+static Semaphore *goodputDone;
+
+static void
+GoodputWriter(int arg)
+{
+    Stream *out = (Stream *) arg;
+    char *buffer = new char[GoodputChunk];
+
+    for (int sent = 0; sent < goodputBytes; sent += GoodputChunk) {
+	for (int i = 0; i < GoodputChunk; i++)
+	    buffer[i] = (char)(sent + i);
+	out->Write(buffer, min(GoodputChunk, goodputBytes - sent));
+    }
+    out->Flush();
+    delete [] buffer;
+    goodputDone->V();
+}
+
+void
+GoodputTest(int kbytes)
+{
+    char *buffer = new char[GoodputChunk];
+    PostOffice *from, *to;
+
+    goodputBytes = kbytes * 1024;
+    goodputDone = new Semaphore("goodput done", 0);
+    ConnectedPair(NumGoodputRuns, &from, &to);
+    for (int i = 0; i < NumGoodputRuns; i++) {
+	double rely = goodputReliability[i], seconds;
+	int ticks, got = 0;
+
+	from->SetLink(rely, DefaultMtu);
+	to->SetLink(rely, DefaultMtu);
+	StartTiming();
+	Stream *in = new Stream(to, i, PairFrom, i);
+	goodputStream = new Stream(from, i, PairTo, i);
+	(new Thread("goodput writer"))->Fork(GoodputWriter,
+						(int) goodputStream);
+	while (got < goodputBytes) {
+	    int n = in->Read(buffer, GoodputChunk);
+
+	    for (int j = 0; j < n; j++)
+		ASSERT(buffer[j] == (char)(got + j));
+	    got += n;
+	}
+	goodputDone->P();
+	ticks = StopTiming(&seconds);
+	printf("reliability %.1f: %d bytes, %d ticks, "
+		"%d bytes per 1000 ticks, %d segments resent, %.3f seconds\n",
+		rely, got, ticks, (int)(got * 1000.0 / ticks),
+		goodputStream->Retransmits(), seconds);
+    }
+    fflush(stdout);
+    delete [] buffer;
+    interrupt->Halt();
+}
+
+// Time a bulk transfer of "kbytes" kilobytes -- a file's worth -- from
+// one machine to another in large messages, as the network loses more
+// packets.  The receiver asks for the file a block at a time: it posts
+// a buffer for the block, then asks for it, and asks again if the block
+// does not come whole in time.  Each block starts with its number, so
+// that a late copy of an earlier one is not taken for it.  The server
+// serves every run on the one pair of machines.
+
+#define BulkBlock	(16 * 1024)
+#define BulkTimeout	(40 * NetworkTime)
+
+static double bulkReliability[] = { 1.0, 0.99, 0.95 };
+#define NumBulkRuns	(int)(sizeof(bulkReliability) / sizeof(double))
+
+static PostOffice *bulkServer;
+static char *bulkFile;
+static int bulkBytes;
+
+static void
+BulkServer(int which)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char *reply = new char[sizeof(int) + BulkBlock];
+    int block;
+
+    for (;;) {
+	bulkServer->Receive(0, &inPktHdr, &inMailHdr, (char *)&block);
+	if (block < 0)
+	    break;
+	int offset = block * BulkBlock, n = min(BulkBlock, bulkBytes - offset);
+
+	*(int *)reply = block;
+	bcopy(bulkFile + offset, reply + sizeof(int), n);
+	outPktHdr.to = inPktHdr.from;
+	outMailHdr.to = inMailHdr.from;
+	outMailHdr.from = 0;
+	outMailHdr.length = sizeof(int) + n;
+	bulkServer->SendLarge(outPktHdr, outMailHdr, reply);
+    }
+    delete [] reply;
+}
+
+void
+BulkTest(int kbytes)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char *buffer = new char[sizeof(int) + BulkBlock];
+    char *copy;
+    PostOffice *client;
+    int done = -1;
+
+    bulkBytes = kbytes * 1024;
+    bulkFile = new char[bulkBytes];
+    copy = new char[bulkBytes];
+    for (int i = 0; i < bulkBytes; i++)
+	bulkFile[i] = (char)(i * 7);
+    ConnectedPair(2, &client, &bulkServer);
+    (new Thread("bulk server"))->Fork(BulkServer, 0);
+    outPktHdr.to = PairTo;
+    outMailHdr.to = 0;
+    outMailHdr.from = 1;
+    outMailHdr.length = sizeof(int);
+    for (int i = 0; i < NumBulkRuns; i++) {
+	double rely = bulkReliability[i], seconds;
+	int ticks, retries = 0;
+
+	client->SetLink(rely, DefaultMtu);
+	bulkServer->SetLink(rely, DefaultMtu);
+	bzero(copy, bulkBytes);
+	StartTiming();
+	for (int block = 0; block * BulkBlock < bulkBytes; ) {
+	    client->PostBuffer(1, buffer, sizeof(int) + BulkBlock);
+	    client->Send(outPktHdr, outMailHdr, (char *)&block);
+	    if (client->ReceiveLarge(1, &inPktHdr, &inMailHdr, BulkTimeout)
+			&& *(int *)buffer == block) {
+		bcopy(buffer + sizeof(int), copy + block * BulkBlock,
+			inMailHdr.length - sizeof(int));
+		block++;
+	    } else
+		retries++;
+	}
+	ticks = StopTiming(&seconds);
+	ASSERT(memcmp(bulkFile, copy, bulkBytes) == 0);
+	printf("reliability %.2f: %d bytes, %d ticks, "
+		"%d bytes per 1000 ticks, %d blocks asked for again, "
+		"%.3f seconds\n", rely, bulkBytes, ticks,
+		(int)(bulkBytes * 1000.0 / ticks), retries, seconds);
+    }
+    client->SetLink(1.0, DefaultMtu);	// stop the server, without
+    client->Send(outPktHdr, outMailHdr, (char *)&done);
+					// losing the request
+    fflush(stdout);
+    delete [] buffer;
+    delete [] copy;
+    delete [] bulkFile;
+    interrupt->Halt();
+}
+
+// Time null RPCs to the machine with ID "farAddr": "calls" of them one
+// at a time, waiting for each reply before making the next call, then
+// as many again, making up to RpcMaxCalls calls before waiting for
+// their replies, so they go out in batches.  The other machine must be
+// running the same test; when each is done with its calls, it tells
+// the other, and waits to be told in turn before halting.
+
+#define RpcServerBox	2
+#define RpcClientBox	3
+#define RpcWorkers	4
+
+enum { RpcNull, RpcDone };
+
+static Semaphore *rpcPeerDone;
+
+static int
+NullProc(NetworkAddress from, char *request, int length, char *reply)
+{
+    return 0;
+}
+
+static int
+DoneProc(NetworkAddress from, char *request, int length, char *reply)
+{
+    rpcPeerDone->V();
+    return 0;
+}
+
+static void
+RpcBench(RpcNode *node, NetworkAddress farAddr, int calls)
+{
+    RpcCall **out = new RpcCall *[RpcMaxCalls];
+    char *reply = new char[RpcMaxData];
+    int ticks = stats->totalTicks;
+    double start = WallClock(), seconds;
+
+    for (int i = 0; i < calls; i++)
+	node->Call(farAddr, RpcNull, NULL, 0, reply)->Wait();
+    ticks = stats->totalTicks - ticks;
+    seconds = WallClock() - start;
+    printf("%d calls, one at a time: %d ticks per call, "
+	    "%.0f calls per second\n", calls, ticks / max(calls, 1),
+	    (seconds > 0) ? calls / seconds : 0.0);
+
+    ticks = stats->totalTicks;
+    start = WallClock();
+    for (int i = 0; i < calls; i += RpcMaxCalls) {
+	int n = min(RpcMaxCalls, calls - i);
+
+	for (int j = 0; j < n; j++)
+	    out[j] = node->Call(farAddr, RpcNull, NULL, 0, reply);
+	for (int j = 0; j < n; j++)
+	    (void) out[j]->Wait();
+    }
+    ticks = stats->totalTicks - ticks;
+    seconds = WallClock() - start;
+    printf("%d calls, batched: %d calls per 1000 ticks, "
+	    "%.0f calls per second\n", calls, (calls * 1000) / max(ticks, 1),
+	    (seconds > 0) ? calls / seconds : 0.0);
+    fflush(stdout);
+    delete [] out;
+    delete [] reply;
+}
+
+void
+RpcTest(int farAddr, int calls)
+{
+    RpcNode *node = new RpcNode(postOffice, RpcServerBox, RpcClientBox,
+					RpcWorkers);
+    char reply[1];
+
+    rpcPeerDone = new Semaphore("rpc peer done", 0);
+    node->Register(RpcNull, NullProc);
+    node->Register(RpcDone, DoneProc);
+
+    RpcBench(node, farAddr, calls);
+
+    node->Call(farAddr, RpcDone, NULL, 0, reply)->Wait();
+    rpcPeerDone->P();			// keep serving until the other
+    interrupt->Halt();			// machine is done too
+}
+
+// Time a machine serving SelectBoxes mailboxes, into which another
+// machine sends "messages" short messages, round robin: first with a
+// thread per mailbox, each waiting in Receive, then with one thread
+// that waits on all of them with WaitAny.  The server answers each
+// message, and the sender waits for the answer before sending the next.
+// Each server thread answers only the messages of its run, so that both
+// runs use one pair of machines.
+
+#define SelectBoxes	8
+
+static PostOffice *selectServer;
+static Semaphore *selectDone;
+static int selectMessages;
+
+static void
+SelectAnswer(int box)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char buffer[MaxMailSize];
+
+    selectServer->Receive(box, &inPktHdr, &inMailHdr, buffer);
+    outPktHdr.to = inPktHdr.from;
+    outMailHdr.to = inMailHdr.from;
+    outMailHdr.from = box;
+    outMailHdr.length = inMailHdr.length;
+    selectServer->Send(outPktHdr, outMailHdr, buffer);
+}
+
+static void
+SelectThreadPerBox(int box)
+{
+    for (int i = box; i < selectMessages; i += SelectBoxes)
+	SelectAnswer(box);
+}
+
+static void
+SelectOneThread(int messages)
+{
+    int boxes[SelectBoxes];
+
+    for (int i = 0; i < SelectBoxes; i++)
+	boxes[i] = i;
+    for (int i = 0; i < messages; i++)
+	SelectAnswer(selectServer->WaitAny(boxes, SelectBoxes, WaitForever));
+    selectDone->V();
+}
+
+void
+SelectTest(int messages)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char buffer[SendersMessageSize];
+
+    PostOffice *client;
+
+    memset(buffer, 'x', SendersMessageSize);
+    selectDone = new Semaphore("select done", 0);
+    selectMessages = messages;
+    ConnectedPair(SelectBoxes + 1, &client, &selectServer);
+    outPktHdr.to = PairTo;
+    outMailHdr.from = SelectBoxes;
+    outMailHdr.length = SendersMessageSize;
+    for (int run = 0; run < 2; run++) {
+	double seconds;
+	int ticks;
+
+	StartTiming();
+	if (run == 0)
+	    for (int i = 0; i < SelectBoxes; i++)
+		(new Thread("select server"))->Fork(SelectThreadPerBox, i);
+	else
+	    (new Thread("select server"))->Fork(SelectOneThread, messages);
+
+	for (int i = 0; i < messages; i++) {
+	    outMailHdr.to = i % SelectBoxes;
+	    client->Send(outPktHdr, outMailHdr, buffer);
+	    client->Receive(SelectBoxes, &inPktHdr, &inMailHdr, buffer);
+	}
+	if (run == 1)
+	    selectDone->P();
+	ticks = StopTiming(&seconds);
+	printf("%s: %d messages to %d boxes, %d ticks per message, "
+		"%.3f seconds\n", (run == 0) ? "thread per box" : "WaitAny",
+		messages, SelectBoxes, ticks / messages, seconds);
+    }
+    fflush(stdout);
+    interrupt->Halt();
+}
+
+#ifdef FILESYS_NEEDED
+// Time reading a file of "kbytes" kilobytes from a file system exported
+// by another machine: first by a machine that does not cache, then by
+// one that does, RemotePasses times over each.  Then check that a write
+// by the first machine reaches the second, through its cache.  The
+// machines are in this process; the file system exported is this
+// Nachos' own.
+
+#define RemoteTestFile	"remotetest"
+#define RemoteChunk	4096
+#define RemotePasses	4
+
+static RemoteFileSystem *
+RemoteMount(NetworkAddress addr, NetworkAddress server, bool cache)
+{
+    PostOffice *post = new PostOffice(addr, 1.0, 4, new MemoryTransport(addr));
+
+    return new RemoteFileSystem(new RpcNode(post, RpcServerBox, RpcClientBox,
+					1), server, cache);
+}
+
+void
+RemoteFsTest(int kbytes)
+{
+    PostOffice *post = new PostOffice(0, 1.0, 4, new MemoryTransport(0));
+    RemoteFileSystem *plain, *cached;
+    RemoteFile *file, *other;
+    char *buffer = new char[RemoteChunk];
+    int bytes = kbytes * 1024;
+
+    (void) new FileServer(new RpcNode(post, RpcServerBox, RpcClientBox,
+					RpcWorkers));
+    plain = RemoteMount(1, 0, FALSE);
+    cached = RemoteMount(2, 0, TRUE);
+
+    ASSERT(plain->Create(RemoteTestFile, 0));
+    file = plain->Open(RemoteTestFile);
+    ASSERT(file != NULL);
+    for (int i = 0; i < bytes; i += RemoteChunk) {
+	for (int j = 0; j < RemoteChunk; j++)
+	    buffer[j] = (char)((i + j) / 7);
+	ASSERT(file->Write(buffer, min(RemoteChunk, bytes - i)) 
+			== min(RemoteChunk, bytes - i));
+    }
+    other = cached->Open(RemoteTestFile);
+    ASSERT(other != NULL && other->Length() == bytes);
+
+    for (int run = 0; run < 2; run++) {
+	RemoteFile *f = (run == 0) ? file : other;
+	int ticks = stats->totalTicks;
+	double start = WallClock();
+
+	for (int pass = 0; pass < RemotePasses; pass++)
+	    for (int i = 0; i < bytes; i += RemoteChunk) {
+		int n = f->ReadAt(buffer, RemoteChunk, i);
+
+		ASSERT(n == min(RemoteChunk, bytes - i));
+		for (int j = 0; j < n; j++)
+		    ASSERT(buffer[j] == (char)((i + j) / 7));
+	    }
+	ticks = stats->totalTicks - ticks;
+	printf("%s: read %d bytes %d times, %d bytes per 1000 ticks, "
+		"%.3f seconds\n", (run == 0) ? "no cache" : "cache", bytes,
+		RemotePasses, (int)(bytes * RemotePasses * 1000.0 / ticks),
+		WallClock() - start);
+    }
+
+    // the write waits for the cached reader's lease to run out; then
+    // the reader has to see it
+    int ticks = stats->totalTicks;
+    memset(buffer, 'w', RemoteChunk);
+    ASSERT(file->WriteAt(buffer, RemoteChunk, 0) == RemoteChunk);
+    ticks = stats->totalTicks - ticks;
+    ASSERT(other->ReadAt(buffer, RemoteChunk, 0) == RemoteChunk);
+    for (int j = 0; j < RemoteChunk; j++)
+	ASSERT(buffer[j] == 'w');
+    printf("write seen by the caching reader; it waited %d ticks "
+	    "for the lease\n", ticks);
+
+    delete file;
+    delete other;
+    ASSERT(plain->Remove(RemoteTestFile));
+    fflush(stdout);
+    delete [] buffer;
+    interrupt->Halt();
+}
+#endif // FILESYS_NEEDED
@@ -18,6 +18,7 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "system.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -45,13 +46,22 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 //      Initialize a single mail box within the post office, so that it
 //	can receive incoming messages.
 //
-//	Just initialize a list of messages, representing the mailbox.
+//	Just initialize a list of messages, representing the mailbox,
+//	and what is needed to wait on it.
 //----------------------------------------------------------------------
 
 
 MailBox::MailBox()
 { 
-    messages = new SynchList(); 
+    messages = new IntrusiveList<Mail, &Mail::link>;
+    lock = new Lock("mailbox lock");
+    arrived = new Condition("mailbox arrived cond");
+    large.buffer = NULL;
+    large.received = 0;
+    large.complete = FALSE;
+    large.pinned = FALSE;
+    large.done = new Semaphore("large mail done", 0);
+    large.unpinned = new Condition("large mail unpinned");
 }
 
 //----------------------------------------------------------------------
@@ -64,7 +74,15 @@ MailBox::MailBox()
 
 MailBox::~MailBox()
 { 
+    Mail *mail;
+
+    while ((mail = messages->Remove()) != NULL)
+	delete mail;
     delete messages; 
+    delete lock;
+    delete arrived;
+    delete large.done;
+    delete large.unpinned;
 }
 
 //----------------------------------------------------------------------
@@ -89,7 +107,8 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 //	arrival, wake them up!
 //
 //	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	to the data); the message carries its own link, so queueing it
+//	allocates nothing more.
 //
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
@@ -99,11 +118,18 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 void 
 MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
+    Put(new Mail(pktHdr, mailHdr, data));
+}
 
-    messages->Append((void *)mail);	// put on the end of the list of 
+void 
+MailBox::Put(Mail *mail)
+{ 
+    lock->Acquire();
+    messages->Append(mail);		// put on the end of the list of 
 					// arrived messages, and wake up 
 					// any waiters
+    arrived->Signal(lock);
+    lock->Release();
 }
 
 //----------------------------------------------------------------------
@@ -122,8 +148,13 @@ void
 MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
 { 
     DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = (Mail *) messages->Remove();	// remove message from list;
-						// will wait if list is empty
+    Mail *mail;
+
+    lock->Acquire();
+    while (messages->IsEmpty())		// wait if list is empty
+	arrived->Wait(lock);
+    mail = messages->Remove();		// remove message from list
+    lock->Release();
 
     *pktHdr = mail->pktHdr;
     *mailHdr = mail->mailHdr;
@@ -138,6 +169,187 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 					// need, we can now discard the message
 }
 
+//----------------------------------------------------------------------
+// LargeTimer
+// 	Dummy function because C++ can't indirectly invoke member functions;
+//	called by the timer interrupt set up in MailBox::GetLarge.
+//
+//	"arg" -- pointer to the mailbox
+//----------------------------------------------------------------------
+
+static void LargeTimer(int arg)
+{ MailBox* box = (MailBox *) arg; box->LargeTimeout(); }
+
+//----------------------------------------------------------------------
+// MailBox::PostBuffer
+// 	Post a buffer for the next large message to arrive in the mailbox,
+//	replacing any buffer posted before.  Fragments that come before the
+//	buffer is posted are dropped.  If a fragment is being copied into
+//	the old buffer, we wait for it, so the copy cannot land in the
+//	new one, nor be counted towards its message.
+//
+//	"data" -- where to put the message
+//	"size" -- room in "data"; longer messages are dropped
+//----------------------------------------------------------------------
+
+void
+MailBox::PostBuffer(char *data, int size)
+{
+    lock->Acquire();
+    while (large.pinned)
+	large.unpinned->Wait(lock);
+    large.buffer = data;
+    large.size = size;
+    large.received = 0;
+    large.complete = FALSE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// MailBox::GetLarge
+// 	Wait for the large message being put together in the posted
+//	buffer to be complete, for at most "timeout" ticks.  Either way,
+//	the buffer is taken back from the mailbox; to wait again, it has
+//	to be posted again.
+//
+//	The wait is on a semaphore that is V'ed either by FragmentPlaced,
+//	or by a timer interrupt at the deadline.  Timers from earlier
+//	waits can still go off, so we check why we were woken.  A
+//	fragment still being copied in holds the buffer until it is done.
+//
+//	Returns TRUE, with the headers of the message, if it came.
+//
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's, and
+//		the length of the message
+//	"timeout" -- ticks to wait
+//----------------------------------------------------------------------
+
+bool
+MailBox::GetLarge(PacketHeader *pktHdr, MailHeader *mailHdr, int timeout)
+{
+    bool complete;
+
+    lock->Acquire();
+    ASSERT(large.buffer != NULL);
+    large.deadline = stats->totalTicks + timeout;
+    interrupt->Schedule(LargeTimer, (int) this, timeout, NetworkRecvInt);
+    while (!large.complete && stats->totalTicks < large.deadline) {
+	lock->Release();
+	large.done->P();
+	lock->Acquire();
+    }
+    while (large.pinned)
+	large.unpinned->Wait(lock);
+    complete = large.complete;
+    if (complete) {
+	*pktHdr = large.pktHdr;
+	*mailHdr = large.mailHdr;
+	mailHdr->fragment = FALSE;
+    } else
+	DEBUG('n', "Large mail timed out, %d bytes in\n", large.received);
+    large.buffer = NULL;
+    large.received = 0;
+    large.complete = FALSE;
+    lock->Release();
+    return complete;
+}
+
+//----------------------------------------------------------------------
+// MailBox::LargeTimeout
+// 	Interrupt handler, called at the deadline of a GetLarge -- not
+//	necessarily the one that is waiting now.  GetLarge sorts it out.
+//----------------------------------------------------------------------
+
+void
+MailBox::LargeTimeout()
+{
+    large.done->V();
+}
+
+//----------------------------------------------------------------------
+// MailBox::PlaceFragment
+// 	Decide where the data of an arriving fragment goes, if anywhere.
+//	Called by the postal worker, before the fragment is read from the
+//	network.  A place we return is pinned: the buffer cannot be taken
+//	back or replaced until FragmentPlaced says the data is in.
+//
+//	The fragments of a message come in order, so a fragment that does
+//	not start where the last one ended means one was lost in between;
+//	the message can no longer be completed, and is dropped.  While a
+//	message is coming in, fragments of other messages are dropped,
+//	unless the one coming in has been idle for LargeIdleTime -- its 
+//	sender has likely given up on it.
+//
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's
+//	"frag" -- which message the fragment is part of, and where
+//----------------------------------------------------------------------
+
+char *
+MailBox::PlaceFragment(PacketHeader pktHdr, MailHeader mailHdr,
+			FragmentHeader *frag)
+{
+    char *place = NULL;
+    bool same;
+
+    lock->Acquire();
+    if (large.buffer == NULL || large.complete || large.pinned) {
+	lock->Release();		// nowhere to put it
+	return NULL;
+    }
+    same = large.received > 0 && pktHdr.from == large.pktHdr.from 
+		&& mailHdr.from == large.mailHdr.from && frag->id == large.id;
+    if (large.received > 0 && !same
+		&& stats->totalTicks - large.lastArrival < LargeIdleTime) {
+	lock->Release();		// the buffer is in use
+	return NULL;
+    }
+    if (same && frag->offset == large.received)
+	place = large.buffer + frag->offset;	// the next fragment
+    else if (frag->offset == 0 && (int)frag->total <= large.size) {
+	large.pktHdr = pktHdr;			// the first fragment of a
+	large.mailHdr = mailHdr;		// new message
+	large.mailHdr.length = frag->total;
+	large.id = frag->id;
+	large.received = 0;
+	place = large.buffer;
+    } else {
+	DEBUG('n', "Dropping fragment at %d of message %d\n", 
+			frag->offset, frag->id);
+	large.received = 0;			// a fragment went missing
+    }
+    large.pinned = (place != NULL);
+    lock->Release();
+    return place;
+}
+
+//----------------------------------------------------------------------
+// MailBox::FragmentPlaced
+// 	Note that the data of a fragment is in the place PlaceFragment 
+//	gave for it, unpinning the buffer.  If it was the last one, wake
+//	up GetLarge.
+//
+//	"frag" -- the fragment's header
+//	"length" -- bytes of data in the fragment
+//----------------------------------------------------------------------
+
+void
+MailBox::FragmentPlaced(FragmentHeader *frag, int length)
+{
+    lock->Acquire();
+    ASSERT(large.pinned);
+    large.pinned = FALSE;
+    large.unpinned->Broadcast(lock);
+    large.received += length;
+    large.lastArrival = stats->totalTicks;
+    if (large.received == frag->total) {
+	large.complete = TRUE;
+	large.done->V();
+    }
+    lock->Release();
+}
+
 //----------------------------------------------------------------------
 // PostalHelper, ReadAvail, WriteDone
 // 	Dummy functions because C++ can't indirectly invoke member functions
@@ -153,6 +365,8 @@ static void ReadAvail(int arg)
 { PostOffice* po = (PostOffice *) arg; po->IncomingPacket(); }
 static void WriteDone(int arg)
 { PostOffice* po = (PostOffice *) arg; po->PacketSent(); }
+static void WaitTimer(int arg)
+{ PostOffice* po = (PostOffice *) arg; po->WaitTimeout(); }
 
 //----------------------------------------------------------------------
 // PostOffice::PostOffice
@@ -171,14 +385,28 @@ static void WriteDone(int arg)
 //	  drops any packets; reliability = 0 means the network never
 //	  delivers any packets)
 //	"nBoxes" is the number of mail boxes in this Post Office
+//	"transport" is handed to the network device; NULL for sockets
+//	"mtu" is the largest packet the network device sends
 //----------------------------------------------------------------------
 
-PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
+PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+			Transport *transport, int mtu)
 {
 // First, initialize the synchronization with the interrupt handlers
     messageAvailable = new Semaphore("message available", 0);
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
+
+// Set up the frames for outgoing mail
+    txFrames = new Mail[NumTxFrames];
+    txFree = new IntrusiveList<Mail, &Mail::link>;
+    txQueue = new IntrusiveList<Mail, &Mail::link>;
+    for (int i = 0; i < NumTxFrames; i++)
+	txFree->Append(&txFrames[i]);
+    txBusy = NULL;
+    txSlots = new Semaphore("tx frames", NumTxFrames);
+    largeLock = new Lock("large mail lock");
+    largeId = 0;
+    discard = new char[MaxPacketSize];
+    waiters = new IntrusiveList<MailWaiter, &MailWaiter::link>;
 
 // Second, initialize the mailboxes
     netAddr = addr; 
@@ -186,7 +414,8 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
     boxes = new MailBox[nBoxes];
 
 // Third, initialize the network; tell it which interrupt handlers to call
-    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this);
+    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this,
+				transport, mtu);
 
 
 // Finally, create a thread whose sole job is to wait for incoming messages,
@@ -206,8 +435,13 @@ PostOffice::~PostOffice()
     delete network;
     delete [] boxes;
     delete messageAvailable;
-    delete messageSent;
-    delete sendLock;
+    delete txSlots;
+    delete txQueue;
+    delete txFree;
+    delete [] txFrames;
+    delete largeLock;
+    delete [] discard;
+    delete waiters;
 }
 
 //----------------------------------------------------------------------
@@ -215,43 +449,85 @@ PostOffice::~PostOffice()
 // 	Wait for incoming messages, and put them in the right mailbox.
 //
 //      Incoming messages have had the PacketHeader stripped off,
-//	but the MailHeader is still tacked on the front of the data.
+//	but the MailHeader is still tacked on the front of the data;
+//	they are received straight into the Mail that goes in the box.
+//
+//	Fragments of large messages are not put in Mail: we peek at
+//	their headers to find out where they go, and the network copies
+//	their data right there.
 //----------------------------------------------------------------------
 
 void
 PostOffice::PostalDelivery()
 {
-    PacketHeader pktHdr;
-    MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+    Mail *mail;
 
     for (;;) {
         // first, wait for a message
         messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+	if (DeliverFragment())
+	    continue;
+	mail = new Mail;
+	ASSERT(mail->data == (char *)&mail->mailHdr + sizeof(MailHeader));
+        mail->pktHdr = network->Receive((char *)&mail->mailHdr);
 
-        mailHdr = *(MailHeader *)buffer;
         if (DebugIsEnabled('n')) {
 	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
+	    PrintHeader(mail->pktHdr, mail->mailHdr);
         }
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail->mailHdr.to && mail->mailHdr.to < numBoxes);
+	ASSERT(mail->pktHdr.length == sizeof(MailHeader) + mail->mailHdr.length);
 
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+	// put into mailbox, and wake up anyone waiting for it
+        boxes[mail->mailHdr.to].Put(mail);
+	WakeWaiters(mail->mailHdr.to);
     }
 }
 
+//----------------------------------------------------------------------
+// PostOffice::DeliverFragment
+// 	If the packet waiting in the network is a fragment of a large
+//	message, read its data into the buffer posted for it, or drop it
+//	if there is none, and return TRUE.  Otherwise leave the packet
+//	waiting, and return FALSE.
+//----------------------------------------------------------------------
+
+bool
+PostOffice::DeliverFragment()
+{
+    char headers[sizeof(MailHeader) + sizeof(FragmentHeader)];
+    MailHeader *mailHdr = (MailHeader *)headers;
+    FragmentHeader *frag = (FragmentHeader *)&headers[sizeof(MailHeader)];
+    PacketHeader pktHdr;
+    IoVec iov[2];
+    char *place;
+
+    pktHdr = network->Peek(headers, sizeof(headers));
+    if (!mailHdr->fragment)
+	return FALSE;
+    ASSERT(0 <= mailHdr->to && mailHdr->to < numBoxes);
+    ASSERT(pktHdr.length >= sizeof(headers) && frag->offset 
+		+ (pktHdr.length - sizeof(headers)) <= frag->total);
+
+    place = boxes[mailHdr->to].PlaceFragment(pktHdr, *mailHdr, frag);
+    iov[0].base = headers;
+    iov[0].length = sizeof(headers);
+    iov[1].base = (place != NULL) ? place : discard;
+    iov[1].length = pktHdr.length - sizeof(headers);
+    (void) network->ReceiveV(iov, 2);
+    if (place != NULL)
+	boxes[mailHdr->to].FragmentPlaced(frag, iov[1].length);
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // PostOffice::Send
-// 	Concatenate the MailHeader to the front of the data, and pass 
-//	the result to the Network for delivery to the destination machine.
+// 	Queue a message for delivery to the destination machine.
 //
-//	Note that the MailHeader + data looks just like normal payload
-//	data to the Network.
+//	We wait only if all the frames are queued; once Send returns, the
+//	caller can reuse "data".
 //
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
@@ -261,33 +537,133 @@ PostOffice::PostalDelivery()
 void
 PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
+    IoVec iov;
 
     if (DebugIsEnabled('n')) {
 	printf("Post send: ");
 	PrintHeader(pktHdr, mailHdr);
     }
-    ASSERT(mailHdr.length <= MaxMailSize);
+    ASSERT((int)mailHdr.length <= MaxMail());
+
+    mailHdr.fragment = FALSE;
+    iov.base = data;
+    iov.length = mailHdr.length;
+    Queue(pktHdr, mailHdr, &iov, 1);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendLarge
+// 	Send a message of any length, as fragments that each fill a
+//	packet.  The lock keeps other threads from sending large messages
+//	until the last fragment is queued, so that the fragments of a
+//	message are sent one after another.
+//
+//	Once SendLarge returns, the caller can reuse "data".
+//
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's, and the length of
+//		the whole message
+//	"data" -- payload message data
+//----------------------------------------------------------------------
+
+void
+PostOffice::SendLarge(PacketHeader pktHdr, MailHeader mailHdr, char* data)
+{
+    int chunk = MaxMail() - sizeof(FragmentHeader);
+    FragmentHeader frag;
+    IoVec iov[2];
+    unsigned n;
+
+    if (DebugIsEnabled('n')) {
+	printf("Post send large: ");
+	PrintHeader(pktHdr, mailHdr);
+    }
+    ASSERT(chunk > 0);
+
+    largeLock->Acquire();
+    frag.id = largeId++;
+    frag.total = mailHdr.length;
+    frag.offset = 0;
+    mailHdr.fragment = TRUE;
+    iov[0].base = (char *)&frag;
+    iov[0].length = sizeof(FragmentHeader);
+    do {
+	n = min(frag.total - frag.offset, (unsigned)chunk);
+	iov[1].base = data + frag.offset;
+	iov[1].length = n;
+	mailHdr.length = sizeof(FragmentHeader) + n;
+	Queue(pktHdr, mailHdr, iov, 2);
+	frag.offset += n;
+    } while (frag.offset < frag.total);
+    largeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Queue
+// 	Copy the headers, and the data gathered from "iov", into a free
+//	frame, and queue it for delivery to the destination machine.  If
+//	the network is idle, it starts on the frame right away; otherwise
+//	PacketSent hands it over when its turn comes.
+//
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's
+//	"iov" -- where the pieces of the data are
+//	"iovCount" -- how many pieces there are
+//----------------------------------------------------------------------
+
+void
+PostOffice::Queue(PacketHeader pktHdr, MailHeader mailHdr, IoVec *iov,
+			int iovCount)
+{
+    IntStatus oldLevel;
+    Mail *frame;
+    char *to;
+
     ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
     
     // fill in pktHdr, for the Network layer
     pktHdr.from = netAddr;
     pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
-    // concatenate MailHeader and data
-    bcopy(&mailHdr, buffer, sizeof(MailHeader));
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
+    txSlots->P();			// wait for a free frame
+    oldLevel = interrupt->SetLevel(IntOff);	// the lists are shared
+    frame = txFree->Remove();			// with PacketSent
+    (void) interrupt->SetLevel(oldLevel);
+    ASSERT(frame != NULL);
+
+    frame->pktHdr = pktHdr;
+    frame->mailHdr = mailHdr;
+    to = frame->data;
+    for (int i = 0; i < iovCount; i++) {
+	bcopy(iov[i].base, to, iov[i].length);
+	to += iov[i].length;
+    }
+    ASSERT(to == frame->data + mailHdr.length);
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    txQueue->Append(frame);
+    if (txBusy == NULL)			// the network is idle
+	StartSend();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::StartSend
+// 	Hand the oldest queued frame to the network.  The MailHeader and
+//	the data are one piece, as they are on the wire.
+//
+//	Interrupts are off, and the network is idle.
+//----------------------------------------------------------------------
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
-    network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
+void
+PostOffice::StartSend()
+{
+    IoVec iov;
 
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+    txBusy = txQueue->Remove();
+    iov.base = (char *)&txBusy->mailHdr;
+    iov.length = txBusy->pktHdr.length;
+    network->SendV(txBusy->pktHdr, &iov, 1);
 }
 
 //----------------------------------------------------------------------
@@ -315,6 +691,151 @@ PostOffice::Receive(int box, PacketHeader *pktHdr,
     ASSERT(mailHdr->length <= MaxMailSize);
 }
 
+//----------------------------------------------------------------------
+// PostOffice::PostBuffer
+// 	Post a buffer to a mailbox for the next large message to arrive
+//	in it.  A large message is only taken in if its buffer is posted
+//	before its first fragment arrives; so to ask another machine for
+//	one, post the buffer first, then send the request.
+//
+//	"box" -- mailbox ID the message will arrive in
+//	"data" -- where to put it
+//	"size" -- room in "data"
+//----------------------------------------------------------------------
+
+void
+PostOffice::PostBuffer(int box, char *data, int size)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    boxes[box].PostBuffer(data, size);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::ReceiveLarge
+// 	Wait for the large message coming into the buffer posted to a
+//	box to be complete, for at most "timeout" ticks.  The buffer is
+//	no longer posted afterwards, whether or not the message came.
+//
+//	Returns TRUE if it came; its data is in the buffer.
+//
+//	"box" -- mailbox ID in which to look for the message
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's, 
+//		and the length of the message
+//	"timeout" -- ticks to wait
+//----------------------------------------------------------------------
+
+bool
+PostOffice::ReceiveLarge(int box, PacketHeader *pktHdr, MailHeader *mailHdr,
+			int timeout)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].GetLarge(pktHdr, mailHdr, timeout);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::WaitAny
+// 	Wait until one of a set of mailboxes has mail, or until "timeout"
+//	ticks have passed.  Returns the first box in the set that has
+//	mail, or -1 if there is none when the time is up.  A timeout of 0
+//	just checks.
+//
+//	The mail is not taken out of the box: Receive does that.  If
+//	other threads also Receive from the box, they may get there first.
+//
+//	The waiter is put on the post office's list, which PostalDelivery
+//	and the timer interrupt look at to see who to wake up; so the list
+//	is only touched with interrupts off.  Checking the boxes happens
+//	with interrupts off too, so no mail can slip in between the check
+//	and going to sleep.
+//
+//	"wanted" -- mailbox IDs to wait on
+//	"count" -- how many there are
+//	"timeout" -- ticks to wait, or WaitForever
+//----------------------------------------------------------------------
+
+int
+PostOffice::WaitAny(int *wanted, int count, int timeout)
+{
+    MailWaiter waiter;
+    IntStatus oldLevel;
+    int found = -1;
+
+    waiter.boxes = wanted;
+    waiter.count = count;
+    waiter.deadline = -1;
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (;;) {
+	for (int i = 0; i < count && found < 0; i++) {
+	    ASSERT((wanted[i] >= 0) && (wanted[i] < numBoxes));
+	    if (boxes[wanted[i]].HasMail())
+		found = wanted[i];
+	}
+	if (found >= 0 || timeout == 0 || (waiter.deadline >= 0
+		    && stats->totalTicks >= waiter.deadline))
+	    break;
+	if (timeout != WaitForever && waiter.deadline < 0) {
+	    waiter.deadline = stats->totalTicks + timeout;
+	    interrupt->Schedule(WaitTimer, (int) this, timeout,
+					NetworkRecvInt);
+	}
+	waiters->Append(&waiter);
+	waiter.ready.P();		// whoever wakes us takes us off
+    }					// the list
+    (void) interrupt->SetLevel(oldLevel);
+    return found;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::WakeWaiters
+// 	Mail has been put in a box; wake up the threads in WaitAny that
+//	are waiting on it.
+//
+//	"box" -- the mailbox ID
+//----------------------------------------------------------------------
+
+void
+PostOffice::WakeWaiters(int box)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    MailWaiter *w, *next;
+
+    for (w = waiters->First(); w != NULL; w = next) {
+	next = waiters->Next(w);
+	for (int i = 0; i < w->count; i++)
+	    if (w->boxes[i] == box) {
+		waiters->Remove(w);
+		w->ready.V();
+		break;
+	    }
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::WaitTimeout
+// 	Interrupt handler, called at the deadline of a WaitAny -- not
+//	necessarily of one still waiting.  Wake up every waiter whose
+//	deadline has passed.
+//----------------------------------------------------------------------
+
+void
+PostOffice::WaitTimeout()
+{
+    MailWaiter *w, *next;
+
+    for (w = waiters->First(); w != NULL; w = next) {
+	next = waiters->Next(w);
+	if (w->deadline >= 0 && stats->totalTicks >= w->deadline) {
+	    waiters->Remove(w);
+	    w->ready.V();
+	}
+    }
+}
+
 //----------------------------------------------------------------------
 // PostOffice::IncomingPacket
 // 	Interrupt handler, called when a packet arrives from the network.
@@ -336,11 +857,17 @@ PostOffice::IncomingPacket()
 //	The name of this routine is a misnomer; if "reliability < 1",
 //	the packet could have been dropped by the network, so it won't get
 //	through.
+//
+//	Free the frame that was sent, and start on the next one.
 //----------------------------------------------------------------------
 
 void 
 PostOffice::PacketSent()
 { 
-    messageSent->V();
+    txFree->Append(txBusy);		// the frame can be reused
+    txBusy = NULL;
+    txSlots->V();
+    if (!txQueue->IsEmpty())		// keep the network busy
+	StartSend();
 }
 
@@ -19,6 +19,18 @@
 //	to which you can send an acknowledgement, if your protocol requires 
 //	this.
 //
+//	Messages larger than a packet can be sent too, with SendLarge.
+//	They are cut into fragments, and put back together on the far
+//	side in a buffer the receiver has posted to the mailbox
+//	beforehand -- each fragment is copied from the network straight
+//	to its place in the buffer.  A large message is delivered whole
+//	or not at all: if a fragment is lost, the rest of the message is
+//	thrown away, and it is up to the two ends to try again.
+//
+//	A thread can also wait on several mailboxes at once, with WaitAny,
+//	and then Receive from whichever has mail; so one thread can serve
+//	many mailboxes.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -29,7 +41,8 @@
 #define POST_H
 
 #include "network.h"
-#include "synchlist.h"
+#include "synch.h"
+#include "ilist.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
@@ -45,10 +58,29 @@ class MailHeader {
     MailBoxAddress from;	// Mail box to reply to
     unsigned length;		// Bytes of message data (excluding the 
 				// mail header)
+    int fragment;		// TRUE if the data is a FragmentHeader
+				// and a piece of a large message
 };
 
+// The following class defines the header that starts the data of each
+// fragment of a large message.  The fragments of a message are sent in
+// order, and the network delivers them in order, so a fragment whose
+// "offset" is not where the last one ended means some were lost.
+
+class FragmentHeader {
+  public:
+    unsigned id;		// Which message, of those from the sender
+    unsigned offset;		// Where the fragment's data goes
+    unsigned total;		// Bytes in the whole message
+};
+
+#define LargeIdleTime	(20 * NetworkTime)	// a large message that has
+						// had no fragment for this 
+						// long is given up on
+
 // Maximum "payload" -- real data -- that can included in a single message
-// Excluding the MailHeader and the PacketHeader
+// Excluding the MailHeader and the PacketHeader.  A post office whose
+// network has a smaller MTU takes smaller messages: see MaxMail().
 
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
@@ -58,9 +90,13 @@ class MailHeader {
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// The data directly follows the MailHeader, as it does on the wire, so
+// an incoming packet can be received straight into a Mail.
 
 class Mail {
   public:
+     Mail() {}			// Filled in by the caller
      Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
 				// Initialize a mail message by
 				// concatenating the headers to the data
@@ -68,12 +104,37 @@ class Mail {
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
      char data[MaxMailSize];	// Payload -- message data
+
+     ListLink<Mail> link;	// on the list of arrived messages
+};
+
+// The following class keeps track of the large message a mailbox is
+// putting together, in the buffer posted for it.
+
+class Reassembly {
+  public:
+    char *buffer;		// Where the message goes; NULL if no
+				//   buffer is posted
+    int size;			// Room in "buffer"
+    PacketHeader pktHdr;	// Headers of the message; "mailHdr.length"
+    MailHeader mailHdr;		//   is the length of the whole message
+    unsigned id;		// FragmentHeader::id of the message
+    unsigned received;		// Bytes of it in so far; 0 if none
+    int lastArrival;		// When the last fragment came in
+    bool complete;		// Every fragment is in
+    bool pinned;		// A fragment is being copied into "buffer",
+				//   which cannot be taken back until it is
+    int deadline;		// When GetLarge gives up waiting
+    Semaphore *done;		// V'ed when the message is complete, or
+				//   the deadline may have passed
+    Condition *unpinned;	// signalled when "pinned" is cleared
 };
 
 // The following class defines a single mailbox, or temporary storage
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
-// threads on this machine.
+// threads on this machine.  A mailbox can also have a buffer posted for
+// a large message.
 
 class MailBox {
   public: 
@@ -82,14 +143,60 @@ class MailBox {
 
     void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
    				// Atomically put a message into the mailbox
+    void Put(Mail *mail);	// Same, for a message already in a Mail;
+				// the mailbox takes it over
     void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
    				// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
+
+    void PostBuffer(char *data, int size);
+				// Put the next large message, of up to
+				// "size" bytes, in "data"
+    bool GetLarge(PacketHeader *pktHdr, MailHeader *mailHdr, int timeout);
+				// Wait up to "timeout" ticks for the large
+				// message to be complete; FALSE if it is
+				// not.  Either way, the buffer is no
+				// longer posted
+    char *PlaceFragment(PacketHeader pktHdr, MailHeader mailHdr,
+			FragmentHeader *frag);
+				// Where the data of an arriving fragment
+				// goes; NULL if it should be dropped.
+				// The buffer stays posted until
+    void FragmentPlaced(FragmentHeader *frag, int length);
+				// the fragment's "length" bytes of data
+				// are in place
+    void LargeTimeout();	// Interrupt handler: a GetLarge deadline
+				// may have passed
+    bool HasMail() { return !messages->IsEmpty(); }
+				// Would Get return without waiting?
+
   private:
-    SynchList *messages;	// A mailbox is just a list of arrived messages
+    IntrusiveList<Mail, &Mail::link> *messages;
+				// A mailbox is just a list of arrived messages
+    Lock *lock;			// enforce mutual exclusive access to the list
+    Condition *arrived;		// wait in Get if the list is empty
+    Reassembly large;		// the large message being put together,
+				// also protected by "lock"
+};
+
+// The following class defines a thread waiting in PostOffice::WaitAny.
+// It is on the post office's list of waiters until mail comes in to one
+// of its boxes, or its deadline passes.
+
+class MailWaiter {
+  public:
+    MailWaiter() : ready("wait any", 0) {}
+
+    int *boxes;			// The mailboxes waited on
+    int count;			//   and how many there are
+    int deadline;		// When to give up; -1 for never
+    Semaphore ready;		// V'ed when it is woken
+    ListLink<MailWaiter> link;	// On the list of waiters
 };
 
+#define WaitForever	-1	// WaitAny timeout that never expires
+
 // The following class defines a "Post Office", or a collection of 
 // mailboxes.  The Post Office is a synchronization object that provides
 // two main operations: Send -- send a message to a mailbox on a remote 
@@ -98,25 +205,65 @@ class MailBox {
 //
 // Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, waking up any threads waiting on Receive.
+//
+// Outgoing messages are copied into one of a fixed pool of frames and
+// queued for the network; Send only waits if every frame is in use.
+// Each time the network has sent a frame, the interrupt handler hands
+// it the next one, so the network is never idle while there is mail
+// to send.
+
+#define NumTxFrames	16	// outgoing messages queued at once
 
 class PostOffice {
   public:
-    PostOffice(NetworkAddress addr, double reliability, int nBoxes);
+    PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+		Transport *transport = NULL, int mtu = DefaultMtu);
 				// Allocate and initialize Post Office
 				//   "reliability" is how many packets
 				//   get dropped by the underlying network
+				//   "transport" carries its packets, if
+				//   not UNIX sockets
+				//   "mtu" is the network's MTU
     ~PostOffice();		// De-allocate Post Office data
     
     void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
-				// the return box for ack's.
+				// the return box for ack's.  Returns once
+				// the message is queued.
     
     void Receive(int box, PacketHeader *pktHdr, 
 		MailHeader *mailHdr, char *data);
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
 
+    void SendLarge(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+				// Send a message of any length, in as many
+				// fragments as it takes.  Returns once the
+				// last fragment is queued.
+    void PostBuffer(int box, char *data, int size);
+				// Have the next large message that arrives
+				// in "box" put in "data"; it is dropped if
+				// longer than "size"
+    bool ReceiveLarge(int box, PacketHeader *pktHdr, MailHeader *mailHdr,
+		int timeout);
+				// Wait up to "timeout" ticks for the large
+				// message to arrive in the buffer posted
+				// to "box"; FALSE if it did not
+    int WaitAny(int *boxes, int count, int timeout);
+				// Wait up to "timeout" ticks (or forever,
+				// if WaitForever) until one of the "count"
+				// mailboxes in "boxes" has mail; return
+				// which, or -1 if none does
+
+    int MaxMail() { return network->MaxPacket() - sizeof(MailHeader); }
+				// Largest message we can send
+    void SetLink(double reliability, int mtu)
+	{ network->SetLink(reliability, mtu); }
+				// Change the network's reliability and
+				// MTU, while no mail is being sent
+    int NumBoxes() { return numBoxes; }
+
     void PostalDelivery();	// Wait for incoming messages, 
 				// and then put them in the correct mailbox
 
@@ -127,6 +274,8 @@ class PostOffice {
    				// packet has arrived and can be pulled
 				// off of network (i.e., time to call 
 				// PostalDelivery)
+    void WaitTimeout();		// Interrupt handler, called when a WaitAny
+				// deadline may have passed
 
   private:
     Network *network;		// Physical network connection
@@ -134,8 +283,29 @@ class PostOffice {
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
     Semaphore *messageAvailable;// V'ed when message has arrived from network
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    Mail *txFrames;		// NumTxFrames frames for outgoing mail
+    IntrusiveList<Mail, &Mail::link> *txFree;	// Frames not in use
+    IntrusiveList<Mail, &Mail::link> *txQueue;	// Frames waiting for the
+						//   network, oldest first
+    Mail *txBusy;		// Frame the network is sending, or NULL
+    Semaphore *txSlots;		// Counts the frames not in use
+    Lock *largeLock;		// Keeps the fragments of a large message
+				//   together
+    unsigned largeId;		// FragmentHeader::id of the next one
+    char *discard;		// Where dropped fragments are received
+    IntrusiveList<MailWaiter, &MailWaiter::link> *waiters;
+				// Threads in WaitAny; shared with
+				//   WaitTimeout, so interrupts are off
+				//   while it is used
+
+    void Queue(PacketHeader pktHdr, MailHeader mailHdr, IoVec *iov,
+		int iovCount);	// Copy a message, gathered from "iov",
+				// into a frame and queue it
+    void StartSend();		// Hand the next queued frame to the
+				// network
+    bool DeliverFragment();	// Take in the waiting packet, if it is
+				// a fragment of a large message
+    void WakeWaiters(int box);	// Mail has come in to "box"
 };
 
 #endif
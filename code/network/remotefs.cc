@@ -0,0 +1,767 @@
+// remotefs.cc
+//	Routines to export a file system to other machines, and to use
+//	one exported by another machine.
+//
+//	The server is a set of RPC handlers, run by the RPC worker
+//	threads.  A write that has to wait for leases to expire sleeps
+//	in its worker, so the other workers keep serving.
+//
+//	The client sends the block reads or writes of one request all at
+//	once, up to RfsMaxCalls of them, and only then waits for the
+//	replies; the RPC layer batches them into a few messages.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "remotefs.h"
+#include "system.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+#ifdef FILESYS_NEEDED
+
+static FileServer *fileServer;		// the one server in this Nachos
+
+// Dummy functions because C++ can't indirectly invoke member functions
+static int RfsOpenProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Open(from, req, len, reply); }
+static int RfsCloseProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Close(from, req, len, reply); }
+static int RfsReadProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Read(from, req, len, reply); }
+static int RfsWriteProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Write(from, req, len, reply); }
+static int RfsLeaseProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Lease(from, req, len, reply); }
+static int RfsCreateProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Create(from, req, len, reply); }
+static int RfsRemoveProc(NetworkAddress from, char *req, int len, char *reply)
+{ return fileServer->Remove(from, req, len, reply); }
+
+//----------------------------------------------------------------------
+// SleepFor
+// 	Put the current thread to sleep for "ticks" ticks.  A timer
+//	interrupt wakes it up.
+//----------------------------------------------------------------------
+
+static void
+WakeUp(int arg)
+{
+    Semaphore *asleep = (Semaphore *) arg;
+
+    asleep->V();
+}
+
+static void
+SleepFor(int ticks)
+{
+    Semaphore asleep("rfs sleep", 0);
+
+    interrupt->Schedule(WakeUp, (int) &asleep, max(ticks, 1), NetworkRecvInt);
+    asleep.P();
+}
+
+//----------------------------------------------------------------------
+// FileServer::FileServer
+// 	Export the file system, by registering the server's procedures.
+//
+//	"rpc" -- the machine's RPC node
+//----------------------------------------------------------------------
+
+FileServer::FileServer(RpcNode *rpc)
+{
+    ASSERT(fileServer == NULL);
+    ASSERT((int)sizeof(RfsReply) <= rpc->MaxData());
+    fileServer = this;
+    maxData = rpc->MaxData();
+
+    lock = new Lock("file server lock");
+    for (int i = 0; i < RfsMaxFiles; i++)
+	files[i].name = NULL;
+
+    rpc->Register(RfsOpen, RfsOpenProc);
+    rpc->Register(RfsClose, RfsCloseProc);
+    rpc->Register(RfsRead, RfsReadProc);
+    rpc->Register(RfsWrite, RfsWriteProc);
+    rpc->Register(RfsLease, RfsLeaseProc);
+    rpc->Register(RfsCreate, RfsCreateProc);
+    rpc->Register(RfsRemove, RfsRemoveProc);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Find
+// 	Return the open file with the given handle, or NULL if there is
+//	none.  The lock is held.
+//----------------------------------------------------------------------
+
+ExportedFile *
+FileServer::Find(int handle)
+{
+    if (handle < 0 || handle >= RfsMaxFiles || files[handle].name == NULL)
+	return NULL;
+    return &files[handle];
+}
+
+//----------------------------------------------------------------------
+// FileServer::Grant
+// 	Give a client a lease on a file, or extend the one it has.  No
+//	lease is given while a write is waiting for leases to run out, or
+//	if RfsMaxLeases other clients already hold one.  The lock is held.
+//
+//	Returns the term of the lease, or 0 if there is none.
+//----------------------------------------------------------------------
+
+int
+FileServer::Grant(ExportedFile *f, NetworkAddress to)
+{
+    int slot = -1;
+
+    if (f->writers > 0)
+	return 0;
+    for (int i = 0; i < RfsMaxLeases; i++)
+	if (f->holder[i] == to) {
+	    slot = i;
+	    break;
+	} else if (slot < 0 && f->expires[i] <= stats->totalTicks)
+	    slot = i;
+    if (slot < 0)
+	return 0;
+    f->holder[slot] = to;
+    f->expires[slot] = stats->totalTicks + RfsLeaseTerm;
+    return RfsLeaseTerm;
+}
+
+//----------------------------------------------------------------------
+// FileServer::Describe
+// 	Fill in a reply with the length and version of a file.
+//----------------------------------------------------------------------
+
+void
+FileServer::Describe(ExportedFile *f, RfsReply *reply)
+{
+    reply->length = f->file->Length();
+    reply->version = f->version;
+    reply->term = 0;
+}
+
+//----------------------------------------------------------------------
+// FileServer::Open
+// 	Open a file for a client, and give it a lease if it caches.  If
+//	the file is already open, the client shares it.
+//----------------------------------------------------------------------
+
+int
+FileServer::Open(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    char *name = request + sizeof(RfsRequest);
+    RfsReply *out = (RfsReply *)reply;
+    ExportedFile *f = NULL, *unused = NULL;
+
+    ASSERT(length > (int)sizeof(RfsRequest) && request[length - 1] == '\0');
+
+    lock->Acquire();
+    for (int i = 0; i < RfsMaxFiles && f == NULL; i++)
+	if (files[i].name == NULL) {
+	    if (unused == NULL)
+		unused = &files[i];
+	} else if (strcmp(files[i].name, name) == 0)
+	    f = &files[i];
+    if (f == NULL && unused != NULL) {
+	OpenFile *file = fileSystem->Open(name);
+
+	if (file != NULL) {
+	    f = unused;
+	    f->name = new char[strlen(name) + 1];
+	    strcpy(f->name, name);
+	    f->file = file;
+	    f->opens = f->version = f->writers = 0;
+	    for (int i = 0; i < RfsMaxLeases; i++) {
+		f->holder[i] = -1;
+		f->expires[i] = 0;
+	    }
+	}
+    }
+    if (f == NULL)
+	out->status = -1;
+    else {
+	f->opens++;
+	out->status = f - files;
+	Describe(f, out);
+	if (req->offset)
+	    out->term = Grant(f, from);
+    }
+    lock->Release();
+    DEBUG('n', "Remote open of %s by %d: %d\n", name, from, out->status);
+    return sizeof(RfsReply);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Close
+// 	Close a file a client opened; the last close really closes it.
+//----------------------------------------------------------------------
+
+int
+FileServer::Close(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    RfsReply *out = (RfsReply *)reply;
+    ExportedFile *f;
+
+    lock->Acquire();
+    f = Find(req->handle);
+    out->status = (f != NULL) ? TRUE : -1;
+    if (f != NULL && --f->opens == 0) {
+	delete f->file;
+	delete [] f->name;
+	f->name = NULL;
+    }
+    lock->Release();
+    return sizeof(RfsReply);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Read
+// 	Read part of a file for a client.  The reply is the data, which
+//	is shorter than asked for at the end of the file.  The file cannot
+//	be closed under us, as the client has it open.
+//----------------------------------------------------------------------
+
+int
+FileServer::Read(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    ExportedFile *f;
+
+    lock->Acquire();
+    f = Find(req->handle);
+    lock->Release();
+    if (f == NULL)
+	return 0;
+    return f->file->ReadAt(reply, min(req->length, maxData), req->offset);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Write
+// 	Write part of a file for a client.  First wait until no other
+//	client holds a lease on the file, so none of them can be using
+//	cached data the write makes stale.  Leases are not granted while
+//	we wait, so the wait is bounded by RfsLeaseTerm.
+//----------------------------------------------------------------------
+
+int
+FileServer::Write(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    RfsReply *out = (RfsReply *)reply;
+    ExportedFile *f;
+    int latest;
+
+    ASSERT(length == (int)sizeof(RfsRequest) + req->length);
+
+    lock->Acquire();
+    f = Find(req->handle);
+    if (f == NULL) {
+	lock->Release();
+	out->status = -1;
+	return sizeof(RfsReply);
+    }
+    f->writers++;
+    for (;;) {
+	latest = stats->totalTicks;
+	for (int i = 0; i < RfsMaxLeases; i++)
+	    if (f->holder[i] != from && f->expires[i] > latest)
+		latest = f->expires[i];
+	if (latest == stats->totalTicks)
+	    break;
+	DEBUG('n', "Remote write by %d waits %d ticks for leases\n", from,
+		latest - stats->totalTicks);
+	lock->Release();
+	SleepFor(latest - stats->totalTicks);
+	lock->Acquire();
+    }
+    lock->Release();
+
+    out->status = f->file->WriteAt(request + sizeof(RfsRequest), req->length,
+					req->offset);
+
+    lock->Acquire();
+    f->version++;
+    f->writers--;
+    Describe(f, out);
+    lock->Release();
+    return sizeof(RfsReply);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Lease
+// 	Tell a client the length and version of a file it has open, and
+//	give it a new lease, if it caches.
+//----------------------------------------------------------------------
+
+int
+FileServer::Lease(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    RfsReply *out = (RfsReply *)reply;
+    ExportedFile *f;
+
+    lock->Acquire();
+    f = Find(req->handle);
+    if (f == NULL)
+	out->status = -1;
+    else {
+	out->status = req->handle;
+	Describe(f, out);
+	if (req->offset)
+	    out->term = Grant(f, from);
+    }
+    lock->Release();
+    return sizeof(RfsReply);
+}
+
+//----------------------------------------------------------------------
+// FileServer::Create, FileServer::Remove
+// 	Create or remove a file for a client.
+//----------------------------------------------------------------------
+
+int
+FileServer::Create(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsRequest *req = (RfsRequest *)request;
+    RfsReply *out = (RfsReply *)reply;
+
+    ASSERT(length > (int)sizeof(RfsRequest) && request[length - 1] == '\0');
+    out->status = fileSystem->Create(request + sizeof(RfsRequest),
+					req->offset);
+    return sizeof(RfsReply);
+}
+
+int
+FileServer::Remove(NetworkAddress from, char *request, int length, char *reply)
+{
+    RfsReply *out = (RfsReply *)reply;
+
+    ASSERT(length > (int)sizeof(RfsRequest) && request[length - 1] == '\0');
+    out->status = fileSystem->Remove(request + sizeof(RfsRequest));
+    return sizeof(RfsReply);
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::RemoteFileSystem
+// 	Mount a file system exported by another machine.  There is nothing
+//	to ask the server; we only set up the cache.
+//
+//	A block is as much as one RPC can carry, up to RfsBlockSize; with
+//	a small MTU that is less.
+//
+//	"node" -- this machine's RPC node
+//	"serverAddr" -- the machine exporting the file system
+//	"cacheBlocks" -- should we cache blocks we read?
+//----------------------------------------------------------------------
+
+RemoteFileSystem::RemoteFileSystem(RpcNode *node, NetworkAddress serverAddr,
+				bool cacheBlocks)
+{
+    rpc = node;
+    server = serverAddr;
+    caching = cacheBlocks;
+    blockSize = min(RfsBlockSize, rpc->MaxData() - (int)sizeof(RfsRequest));
+    ASSERT(blockSize > 0 && (int)sizeof(RfsReply) <= rpc->MaxData());
+    lock = new Lock("remote fs lock");
+    cache = new CachedBlock[RfsCacheBlocks];
+    for (int i = 0; i < RfsCacheBlocks; i++) {
+	cache[i].handle = -1;
+	cache[i].lastUsed = 0;
+    }
+    useCount = 0;
+}
+
+RemoteFileSystem::~RemoteFileSystem()
+{
+    delete lock;
+    delete [] cache;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::ByName
+// 	Call a procedure that takes a file name, and wait for the reply.
+//
+//	"proc" -- RfsOpen, RfsCreate or RfsRemove
+//	"name" -- the file's name
+//	"arg" -- RfsRequest::offset: the size, or whether we want a lease
+//	"reply" -- where to put the reply
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::ByName(int proc, char *name, int arg, RfsReply *reply)
+{
+    char request[MaxMailSize];
+    RfsRequest *req = (RfsRequest *)request;
+    int length = sizeof(RfsRequest) + strlen(name) + 1;
+
+    if (length > rpc->MaxData())		// the name is too long to send
+	return -1;
+    req->handle = -1;
+    req->offset = arg;
+    req->length = 0;
+    strcpy(request + sizeof(RfsRequest), name);
+    (void) rpc->Call(server, proc, request, length, (char *)reply)->Wait();
+    return reply->status;
+}
+
+bool
+RemoteFileSystem::Create(char *name, int initialSize)
+{
+    RfsReply reply;
+
+    return ByName(RfsCreate, name, initialSize, &reply) == TRUE;
+}
+
+bool
+RemoteFileSystem::Remove(char *name)
+{
+    RfsReply reply;
+
+    return ByName(RfsRemove, name, 0, &reply) == TRUE;
+}
+
+RemoteFile *
+RemoteFileSystem::Open(char *name)
+{
+    int sent = stats->totalTicks;
+    RemoteFile *file;
+    RfsReply reply;
+
+    if (ByName(RfsOpen, name, caching, &reply) < 0)
+	return NULL;
+    file = new RemoteFile(this, reply.status, &reply);
+    file->leaseExpires = sent + reply.term;
+    return file;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Close
+// 	Close a file, and throw out its cached blocks: the server may give
+//	its handle to another file once no one has it open.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Close(RemoteFile *file)
+{
+    RfsRequest req;
+    RfsReply reply;
+
+    lock->Acquire();
+    for (int i = 0; i < RfsCacheBlocks; i++)
+	if (cache[i].handle == file->handle)
+	    cache[i].handle = -1;
+    req.handle = file->handle;
+    (void) rpc->Call(server, RfsClose, (char *)&req, sizeof(req),
+			(char *)&reply)->Wait();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Renew
+// 	Make sure we hold a lease on a file, and so know its length and
+//	version.  If we are not caching, we always ask.  The lock is held.
+//----------------------------------------------------------------------
+
+void
+RemoteFileSystem::Renew(RemoteFile *file)
+{
+    int sent = stats->totalTicks;
+    RfsRequest req;
+    RfsReply reply;
+
+    if (caching && sent < file->leaseExpires)
+	return;
+    req.handle = file->handle;
+    req.offset = caching;
+    (void) rpc->Call(server, RfsLease, (char *)&req, sizeof(req),
+			(char *)&reply)->Wait();
+    ASSERT(reply.status == file->handle);
+    if (reply.version != file->version)
+	DEBUG('n', "Remote file %d is now version %d\n", file->handle,
+		reply.version);
+    file->length = reply.length;
+    file->version = reply.version;
+    file->leaseExpires = sent + reply.term;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Lookup
+// 	Return a cached block of a file, if we have it and it is good.
+//	The lock is held, and Renew has been called.
+//----------------------------------------------------------------------
+
+CachedBlock *
+RemoteFileSystem::Lookup(RemoteFile *file, int block)
+{
+    if (!caching || stats->totalTicks >= file->leaseExpires)
+	return NULL;
+    for (int i = 0; i < RfsCacheBlocks; i++)
+	if (cache[i].handle == file->handle && cache[i].block == block
+		&& cache[i].version == file->version) {
+	    cache[i].lastUsed = ++useCount;
+	    return &cache[i];
+	}
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Victim
+// 	Choose a block to read into: the one least recently used.  The
+//	lock is held.
+//----------------------------------------------------------------------
+
+CachedBlock *
+RemoteFileSystem::Victim()
+{
+    CachedBlock *victim = &cache[0];
+
+    for (int i = 1; i < RfsCacheBlocks; i++)
+	if (cache[i].lastUsed < victim->lastUsed)
+	    victim = &cache[i];
+    victim->handle = -1;
+    victim->lastUsed = ++useCount;	// don't choose it again right away
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::ReadAt
+// 	Read part of a remote file.  The blocks it covers are dealt with
+//	RfsMaxCalls at a time: the ones not in the cache are all asked for
+//	before we wait for any, then everything is copied out.  Without
+//	a cache, the blocks are still read into cache blocks, but Lookup
+//	never finds them again.
+//
+//	Returns the number of bytes read.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::ReadAt(RemoteFile *file, char *into, int numBytes,
+			int position)
+{
+    RpcCall *calls[RfsMaxCalls];
+    CachedBlock *blocks[RfsMaxCalls];
+    RfsRequest req;
+    int done = 0;
+    bool shortRead = FALSE;
+
+    lock->Acquire();
+    Renew(file);
+    if (position >= file->length || numBytes <= 0) {
+	lock->Release();
+	return 0;
+    }
+    numBytes = min(numBytes, file->length - position);
+
+    int first = position / blockSize;
+    int last = (position + numBytes - 1) / blockSize;
+
+    for (int group = first; group <= last && !shortRead;
+					group += RfsMaxCalls) {
+	int count = min(RfsMaxCalls, last - group + 1);
+
+	for (int i = 0; i < count; i++) {
+	    blocks[i] = Lookup(file, group + i);
+	    if (blocks[i] != NULL) {
+		calls[i] = NULL;
+		continue;
+	    }
+	    blocks[i] = Victim();
+	    req.handle = file->handle;
+	    req.offset = (group + i) * blockSize;
+	    req.length = blockSize;
+	    calls[i] = rpc->Call(server, RfsRead, (char *)&req, sizeof(req),
+					blocks[i]->data);
+	}
+	for (int i = 0; i < count; i++) {
+	    CachedBlock *b = blocks[i];
+
+	    if (calls[i] != NULL) {
+		b->valid = calls[i]->Wait();
+		b->handle = file->handle;
+		b->block = group + i;
+		b->version = file->version;
+	    }
+	}
+	for (int i = 0; i < count; i++) {
+	    int start = (group + i) * blockSize;
+	    int from = max(position, start) - start;
+	    int n = min(position + numBytes - start, blocks[i]->valid) - from;
+
+	    if (n > 0) {
+		bcopy(blocks[i]->data + from, into + done, n);
+		done += n;
+	    }
+	    if (blocks[i]->valid < blockSize) {
+		shortRead = TRUE;	// the file ends here, maybe
+		break;			// shorter than we thought
+	    }
+	}
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::WriteAt
+// 	Write part of a remote file, blockSize bytes per RPC, sending
+//	up to RfsMaxCalls of them before waiting for the replies.
+//
+//	We stop at the first block the server writes short or not at
+//	all, even if later ones in the batch were written, so what we
+//	return is always a prefix of "from".
+//
+//	If every block was written and no one else wrote the file
+//	meanwhile -- its version went up by exactly our writes -- our
+//	cached blocks are brought up to date
+//	rather than thrown out.  Otherwise they go stale with the old
+//	version.
+//
+//	Returns the number of bytes written.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::WriteAt(RemoteFile *file, char *from, int numBytes,
+			int position)
+{
+    RpcCall *calls[RfsMaxCalls];
+    RfsReply replies[RfsMaxCalls];
+    char *request = new char[sizeof(RfsRequest) + blockSize];
+    RfsRequest *req = (RfsRequest *)request;
+    int lengths[RfsMaxCalls];
+    int done = 0, writes = 0, oldVersion, newVersion;
+    bool partial = FALSE;
+
+    lock->Acquire();
+    Renew(file);
+    oldVersion = newVersion = file->version;
+    while (done < numBytes && !partial) {
+	int count = 0;
+
+	for (int sent = done; count < RfsMaxCalls && sent < numBytes; count++) {
+	    req->handle = file->handle;
+	    req->offset = position + sent;
+	    req->length = min(blockSize, numBytes - sent);
+	    lengths[count] = req->length;
+	    bcopy(from + sent, request + sizeof(RfsRequest), req->length);
+	    calls[count] = rpc->Call(server, RfsWrite, request,
+				sizeof(RfsRequest) + req->length,
+				(char *)&replies[count]);
+	    sent += req->length;
+	}
+	for (int i = 0; i < count; i++) {
+	    (void) calls[i]->Wait();
+	    if (replies[i].status > 0) {
+		writes++;
+		newVersion = max(newVersion, replies[i].version);
+		file->length = max(file->length, replies[i].length);
+	    }
+	}
+	for (int i = 0; i < count && !partial; i++) {
+	    if (replies[i].status == lengths[i])
+		done += lengths[i];
+	    else
+		partial = TRUE;		// short or failed; stop here
+	}
+    }
+
+    if (caching && !partial && newVersion == oldVersion + writes)
+	for (int i = 0; i < RfsCacheBlocks; i++) {
+	    CachedBlock *b = &cache[i];
+	    int start = b->block * blockSize;
+	    int lo = max(position, start), hi = min(position + done,
+							start + blockSize);
+
+	    if (b->handle != file->handle || b->version != oldVersion)
+		continue;
+	    if (lo < hi && lo - start > b->valid) {
+		b->handle = -1;			// it would have a hole
+		continue;
+	    }
+	    if (lo < hi) {
+		bcopy(from + lo - position, b->data + lo - start, hi - lo);
+		b->valid = max(b->valid, hi - start);
+	    }
+	    b->version = newVersion;
+	}
+    file->version = newVersion;
+    lock->Release();
+    delete [] request;
+    return done;
+}
+
+//----------------------------------------------------------------------
+// RemoteFileSystem::Length
+// 	Return the length of a remote file.
+//----------------------------------------------------------------------
+
+int
+RemoteFileSystem::Length(RemoteFile *file)
+{
+    int length;
+
+    lock->Acquire();
+    Renew(file);
+    length = file->length;
+    lock->Release();
+    return length;
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::RemoteFile
+// 	Set up a file opened on a mounted file system.
+//
+//	"mount" -- the file system
+//	"serverHandle" -- the server's handle for the file
+//	"reply" -- the reply to RfsOpen
+//----------------------------------------------------------------------
+
+RemoteFile::RemoteFile(RemoteFileSystem *mount, int serverHandle,
+			RfsReply *reply)
+{
+    fs = mount;
+    handle = serverHandle;
+    length = reply->length;
+    version = reply->version;
+    leaseExpires = 0;
+    seekPosition = 0;
+}
+
+RemoteFile::~RemoteFile()
+{
+    fs->Close(this);
+}
+
+//----------------------------------------------------------------------
+// RemoteFile::Read, RemoteFile::Write
+// 	Read or write at the current position, and move past what was
+//	read or written.
+//----------------------------------------------------------------------
+
+int
+RemoteFile::Read(char *into, int numBytes)
+{
+    int result = ReadAt(into, numBytes, seekPosition);
+
+    seekPosition += result;
+    return result;
+}
+
+int
+RemoteFile::Write(char *from, int numBytes)
+{
+    int result = WriteAt(from, numBytes, seekPosition);
+
+    seekPosition += result;
+    return result;
+}
+
+#endif // FILESYS_NEEDED
@@ -0,0 +1,213 @@
+// remotefs.h
+//	Data structures to share a file system between machines.
+//
+//	One machine exports its file system, by making a FileServer; the
+//	others mount it, by making a RemoteFileSystem, and then open,
+//	read and write its files much as they would local ones.  Requests
+//	go to the server as RPCs (see rpc.h).
+//
+//	A client can cache the blocks it reads.  Its cache is kept right
+//	with leases: to use the cached blocks of a file, a client must
+//	hold an unexpired lease on the file, which the server grants for
+//	RfsLeaseTerm ticks at a time.  A write from one client is held up
+//	until every other client's lease on the file has expired, and
+//	bumps the file's version; a client that renews its lease and sees
+//	a new version knows its cached blocks are stale.  Writes go
+//	straight through to the server.
+//
+//	A lease is timed from when the client asked for it, which is
+//	before the server granted it, so the client always gives it up
+//	first -- provided the two clocks run at the same rate.  Machines
+//	in one Nachos share a clock; separate Nachos processes only
+//	roughly do.
+//
+//	A server serves the file system of the Nachos it runs in; there
+//	can only be one per Nachos.
+//
+//	Reads and writes go a block per RPC, a block being as much as
+//	the client's MTU allows.  The server and client should have the
+//	same MTU: a server with a smaller one sends short replies, and
+//	the client takes a short read to be the end of the file.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef REMOTEFS_H
+#define REMOTEFS_H
+
+#include "rpc.h"
+#include "filesys.h"
+
+#define RfsBlockSize	1024	// most bytes read by one RPC; also
+				// what the client caches
+#define RfsCacheBlocks	64	// blocks in a client's cache
+#define RfsMaxCalls	16	// most block RPCs a client has out at once
+#define RfsLeaseTerm	(200 * NetworkTime)	// how long a lease lasts
+#define RfsMaxFiles	16	// files a server has open at once
+#define RfsMaxLeases	8	// clients with a lease on one file
+
+// The server's procedures, numbered so as not to clash with the few a
+// test might register for itself.
+
+#define RfsProcBase	8
+enum { RfsOpen = RfsProcBase, RfsClose, RfsRead, RfsWrite, RfsLease,
+	RfsCreate, RfsRemove };
+
+// The following class defines the start of every request.  Open, Create
+// and Remove have the file's name after it, Write the data to write.
+
+class RfsRequest {
+  public:
+    int handle;			// The open file: Close, Read, Write, Lease
+    int offset;			// Read, Write: where; Create: the size;
+				//   Open, Lease: TRUE if a lease is wanted
+    int length;			// Read: bytes wanted; Write: bytes after
+				//   this header
+};
+
+// The following class defines the reply to Open, Write, Lease, Create,
+// and Remove.  The reply to Read is just the data.
+
+class RfsReply {
+  public:
+    int status;			// Open: the handle; Write: bytes written;
+				//   Create, Remove: TRUE or FALSE; -1 if
+				//   the file is not open or not there
+    int length;			// The file's length
+    int version;		// Bumped by each write to the file
+    int term;			// Open, Lease: ticks the lease lasts
+				//   (0 if the client should not cache)
+};
+
+// The following class defines a file the server has open.  Every
+// client that opens the file by the same name gets the same one.
+
+class ExportedFile {
+  public:
+    char *name;			// NULL if the slot is free
+    OpenFile *file;
+    int opens;			// # of client opens not yet closed
+    int version;		// # of writes so far
+    int writers;		// # of writes waiting for leases to expire;
+				//   no leases are granted meanwhile
+    NetworkAddress holder[RfsMaxLeases];	// who has a lease
+    int expires[RfsMaxLeases];			//   and until when
+};
+
+// The following class defines the server.
+
+class FileServer {
+  public:
+    FileServer(RpcNode *rpc);	// Export this Nachos' file system to
+				// the machines that call "rpc"
+
+    int Open(NetworkAddress from, char *request, int length, char *reply);
+    int Close(NetworkAddress from, char *request, int length, char *reply);
+    int Read(NetworkAddress from, char *request, int length, char *reply);
+    int Write(NetworkAddress from, char *request, int length, char *reply);
+    int Lease(NetworkAddress from, char *request, int length, char *reply);
+    int Create(NetworkAddress from, char *request, int length, char *reply);
+    int Remove(NetworkAddress from, char *request, int length, char *reply);
+				// Internal: RPC handlers
+
+  private:
+    int maxData;		// Longest reply the RPC node can send
+    Lock *lock;			// protects "files"
+    ExportedFile files[RfsMaxFiles];
+
+    ExportedFile *Find(int handle);	// NULL if "handle" is not open
+    int Grant(ExportedFile *f, NetworkAddress to);
+					// Give "to" a lease; return its term
+    void Describe(ExportedFile *f, RfsReply *reply);
+					// Fill in length and version
+};
+
+// The following class defines a block in a client's cache.  A block is
+// good for as long as the client holds a lease on its file, and the
+// file is still at the version the block was read at.
+
+class CachedBlock {
+  public:
+    int handle;			// Which file; -1 if the block is free
+    int block;			//   and which block of it
+    int version;		// The file's version when it was read
+    int valid;			// Bytes of it that are in the file
+    int lastUsed;		// For replacing the least recently used
+    char data[RfsBlockSize];
+};
+
+class RemoteFile;
+
+// The following class defines a client's view of a mounted file system.
+
+class RemoteFileSystem {
+  public:
+    RemoteFileSystem(RpcNode *node, NetworkAddress serverAddr,
+				bool cacheBlocks);
+				// Mount the file system exported by
+				// "serverAddr"; cache blocks if
+				// "cacheBlocks"
+    ~RemoteFileSystem();
+
+    bool Create(char *name, int initialSize);
+    RemoteFile *Open(char *name);	// NULL if there is no such file
+    bool Remove(char *name);
+				// As for FileSystem
+
+    int ReadAt(RemoteFile *file, char *into, int numBytes, int position);
+    int WriteAt(RemoteFile *file, char *from, int numBytes, int position);
+    int Length(RemoteFile *file);
+    void Close(RemoteFile *file);
+				// Internal: the work of RemoteFile
+
+  private:
+    RpcNode *rpc;
+    NetworkAddress server;
+    bool caching;		// Cache blocks?
+    int blockSize;		// Bytes per read or write RPC; at most
+				//   RfsBlockSize
+    Lock *lock;			// One request at a time; protects the
+				//   cache and the files' leases
+    CachedBlock *cache;		// RfsCacheBlocks blocks
+    int useCount;		// Ticks over on each use of a block
+
+    int ByName(int proc, char *name, int arg, RfsReply *reply);
+				// Call Open, Create or Remove; return
+				// the status
+    void Renew(RemoteFile *file);	// Make sure we hold a lease
+    CachedBlock *Lookup(RemoteFile *file, int block);
+				// The block, if it is cached and good
+    CachedBlock *Victim();	// A block to throw out
+};
+
+// The following class defines a file opened on a mounted file system.
+// Its interface is that of OpenFile.
+
+class RemoteFile {
+  public:
+    RemoteFile(RemoteFileSystem *mount, int serverHandle, RfsReply *reply);
+    ~RemoteFile();		// Close the file
+
+    void Seek(int position) { seekPosition = position; }
+    int Read(char *into, int numBytes);
+    int Write(char *from, int numBytes);
+    int ReadAt(char *into, int numBytes, int position)
+	{ return fs->ReadAt(this, into, numBytes, position); }
+    int WriteAt(char *from, int numBytes, int position)
+	{ return fs->WriteAt(this, from, numBytes, position); }
+    int Length() { return fs->Length(this); }
+
+    int handle;			// Internal: the server's handle
+    int length;			// Internal: as of the last reply
+    int version;		// Internal: likewise
+    int leaseExpires;		// Internal: when our lease runs out
+
+  private:
+    RemoteFileSystem *fs;
+    int seekPosition;
+};
+
+#endif // REMOTEFS_H
@@ -0,0 +1,372 @@
+// rpc.cc
+//	Routines to make remote procedure calls, and to serve them, on
+//	top of the post office.
+//
+//	An RpcNode has a thread that takes in the replies to its calls,
+//	and wakes up the callers; a thread that takes in batches of calls
+//	from other machines, and queues them; and a pool of workers that
+//	take the queued calls one at a time, run them, and send back the
+//	replies of each batch together.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "rpc.h"
+#include "system.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+// Calls and replies in a batch start on an int boundary
+#define RpcPad(n)	(((n) + sizeof(int) - 1) & ~(sizeof(int) - 1))
+#define RpcSize(n)	(int)(sizeof(RpcHeader) + RpcPad(n))
+
+// Dummy functions because C++ can't indirectly invoke member functions
+static void RpcReplies(int arg)
+{ RpcNode *n = (RpcNode *) arg; n->Replies(); }
+static void RpcRequests(int arg)
+{ RpcNode *n = (RpcNode *) arg; n->Requests(); }
+static void RpcWorker(int arg)
+{ RpcNode *n = (RpcNode *) arg; n->Worker(); }
+
+//----------------------------------------------------------------------
+// RpcNode::RpcNode
+// 	Set up a machine's RPC client and server, and start its threads.
+//
+//	"office" -- the post office to send and receive through
+//	"callBox" -- where calls to us arrive
+//	"replyBox" -- where replies to our calls arrive
+//	"numWorkers" -- how many calls we can serve at once
+//----------------------------------------------------------------------
+
+RpcNode::RpcNode(PostOffice *office, MailBoxAddress callBox,
+		MailBoxAddress replyBox, int numWorkers)
+{
+    post = office;
+    serverBox = callBox;
+    clientBox = replyBox;
+    maxBatch = post->MaxMail();
+    ASSERT(maxBatch >= (int)sizeof(int) + RpcSize(0));
+    maxData = (maxBatch - sizeof(int) - sizeof(RpcHeader)) & ~(sizeof(int) - 1);
+    for (int i = 0; i < RpcMaxProcs; i++)
+	handlers[i] = NULL;
+
+    lock = new Lock("rpc lock");
+
+    calls = new RpcCall[RpcMaxCalls];
+    freeCalls = NULL;
+    for (int i = RpcMaxCalls - 1; i >= 0; i--) {
+	calls[i].id = i;
+	calls[i].node = this;
+	calls[i].done = new Semaphore("rpc done", 0);
+	calls[i].next = freeCalls;
+	freeCalls = &calls[i];
+    }
+    callFree = new Condition("rpc call free");
+    batch = new char[MaxMailSize];
+    batchCount = 0;
+    batchLength = sizeof(int);
+
+    work = new IntrusiveList<RpcBatch, &RpcBatch::link>;
+    workArrived = new Condition("rpc work arrived");
+
+    (new Thread("rpc replies"))->Fork(RpcReplies, (int) this);
+    (new Thread("rpc requests"))->Fork(RpcRequests, (int) this);
+    for (int i = 0; i < numWorkers; i++)
+	(new Thread("rpc worker"))->Fork(RpcWorker, (int) this);
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Register
+// 	Serve a procedure.
+//
+//	"proc" -- the procedure's number
+//	"handler" -- the routine that runs it
+//----------------------------------------------------------------------
+
+void
+RpcNode::Register(int proc, RpcHandler handler)
+{
+    ASSERT(0 <= proc && proc < RpcMaxProcs);
+
+    handlers[proc] = handler;
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Call
+// 	Call a procedure on another machine.  The call is added to the
+//	batch; a batch to some other machine, or one that is full, is
+//	sent first.  We only wait if all RpcMaxCalls calls are out.
+//
+//	Returns the call, to Wait on; "request" can be reused at once.
+//
+//	"to" -- the machine
+//	"proc" -- the procedure's number there
+//	"request", "length" -- the data to call it with
+//	"reply" -- where to put the reply, when it comes
+//----------------------------------------------------------------------
+
+RpcCall *
+RpcNode::Call(NetworkAddress to, int proc, char *request, int length,
+		char *reply)
+{
+    RpcHeader *hdr;
+    RpcCall *call;
+
+    ASSERT(0 <= length && (int)sizeof(int) + RpcSize(length) <= maxBatch);
+
+    lock->Acquire();
+    while (freeCalls == NULL) {
+	if (batchCount > 0)		// they may be waiting for us
+	    SendBatch();
+	callFree->Wait(lock);
+    }
+    call = freeCalls;
+    freeCalls = call->next;
+
+    if (batchCount > 0 && (to != batchTo
+		|| batchLength + RpcSize(length) > maxBatch))
+	SendBatch();
+    batchTo = to;
+    hdr = (RpcHeader *)&batch[batchLength];
+    hdr->id = call->id;
+    hdr->proc = proc;
+    hdr->length = length;
+    bcopy(request, (char *)(hdr + 1), length);
+    batchLength += RpcSize(length);
+    batchCount++;
+
+    call->reply = reply;
+    call->batched = TRUE;
+    lock->Release();
+    return call;
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Flush
+// 	Send the calls in the batch, if there are any.
+//----------------------------------------------------------------------
+
+void
+RpcNode::Flush()
+{
+    lock->Acquire();
+    if (batchCount > 0)
+	SendBatch();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RpcNode::SendBatch
+// 	Send the batch of calls, and start a new one.  The lock is held.
+//----------------------------------------------------------------------
+
+void
+RpcNode::SendBatch()
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+    char *p = batch + sizeof(int);
+
+    DEBUG('n', "Sending %d calls to %d\n", batchCount, batchTo);
+    *(int *)batch = batchCount;
+    for (int i = 0; i < batchCount; i++) {
+	RpcHeader *hdr = (RpcHeader *)p;
+
+	calls[hdr->id % RpcMaxCalls].batched = FALSE;
+	p += RpcSize(hdr->length);
+    }
+
+    outPktHdr.to = batchTo;
+    outMailHdr.to = serverBox;
+    outMailHdr.from = clientBox;
+    outMailHdr.length = batchLength;
+    post->Send(outPktHdr, outMailHdr, batch);
+
+    batchCount = 0;
+    batchLength = sizeof(int);
+}
+
+//----------------------------------------------------------------------
+// RpcCall::Wait, RpcNode::Finish
+// 	Wait for the reply to a call, sending the call first if it is
+//	still in the batch.  Then free the call.
+//
+//	Returns the length of the reply, or RpcNoProc.
+//----------------------------------------------------------------------
+
+int
+RpcCall::Wait()
+{
+    return node->Finish(this);
+}
+
+int
+RpcNode::Finish(RpcCall *call)
+{
+    int length;
+
+    lock->Acquire();
+    if (call->batched)
+	SendBatch();
+    lock->Release();
+
+    call->done->P();
+
+    lock->Acquire();
+    length = call->replyLength;
+    call->id += RpcMaxCalls;		// the next use is a new call
+    call->next = freeCalls;
+    freeCalls = call;
+    callFree->Signal(lock);
+    lock->Release();
+    return length;
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Replies
+// 	Take in the batches of replies to our calls, and wake up their
+//	callers.  A call's slot cannot be reused until its caller is
+//	woken, so the reply is put in place without the lock.
+//----------------------------------------------------------------------
+
+void
+RpcNode::Replies()
+{
+    PacketHeader inPktHdr;
+    MailHeader inMailHdr;
+    char *buffer = new char[MaxMailSize];
+
+    for (;;) {
+	post->Receive(clientBox, &inPktHdr, &inMailHdr, buffer);
+	int count = *(int *)buffer;
+	char *p = buffer + sizeof(int);
+
+	for (int i = 0; i < count; i++) {
+	    RpcHeader *hdr = (RpcHeader *)p;
+	    RpcCall *call = &calls[hdr->id % RpcMaxCalls];
+
+	    ASSERT(call->id == hdr->id && !call->batched);
+	    if (hdr->length > 0)
+		bcopy((char *)(hdr + 1), call->reply, hdr->length);
+	    call->replyLength = hdr->length;
+	    call->done->V();
+	    p += RpcSize(max(hdr->length, 0));
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Requests
+// 	Take in the batches of calls from other machines, and queue them
+//	for the workers.
+//----------------------------------------------------------------------
+
+void
+RpcNode::Requests()
+{
+    RpcBatch *b;
+
+    for (;;) {
+	b = new RpcBatch;
+	b->data = new char[MaxMailSize];
+	post->Receive(serverBox, &b->pktHdr, &b->mailHdr, b->data);
+	b->count = *(int *)b->data;
+	b->taken = b->served = 0;
+	b->next = b->data + sizeof(int);
+	b->replies = new char[MaxMailSize];
+	b->replyCount = 0;
+	b->replyLength = sizeof(int);
+	DEBUG('n', "Got %d calls from %d\n", b->count, b->pktHdr.from);
+
+	lock->Acquire();
+	work->Append(b);
+	workArrived->Signal(lock);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// RpcNode::Worker
+// 	Serve calls, one at a time, for as long as Nachos runs.  A call
+//	is taken off the queue with the lock held, and run without it,
+//	so the workers run calls in parallel.  The reply is added to the
+//	replies of the call's batch; whoever finishes the last call in a
+//	batch sends them, and frees the batch.
+//----------------------------------------------------------------------
+
+void
+RpcNode::Worker()
+{
+    char *reply = new char[RpcMaxData];
+    RpcBatch *b;
+    RpcHeader *hdr, *out;
+    int length;
+
+    for (;;) {
+	lock->Acquire();
+	while (work->IsEmpty())
+	    workArrived->Wait(lock);
+	b = work->First();
+	hdr = (RpcHeader *)b->next;
+	b->next += RpcSize(hdr->length);
+	if (++b->taken == b->count)
+	    work->Remove(b);
+	else
+	    workArrived->Signal(lock);	// let another worker help
+	lock->Release();
+
+	if (0 <= hdr->proc && hdr->proc < RpcMaxProcs
+		&& handlers[hdr->proc] != NULL) {
+	    length = (*handlers[hdr->proc])(b->pktHdr.from, (char *)(hdr + 1),
+						hdr->length, reply);
+	    ASSERT(0 <= length && (int)sizeof(int) + RpcSize(length)
+						<= maxBatch);
+	} else
+	    length = RpcNoProc;
+
+	lock->Acquire();
+	if (b->replyLength + RpcSize(max(length, 0)) > maxBatch)
+	    SendReplies(b);		// no room left
+	out = (RpcHeader *)&b->replies[b->replyLength];
+	out->id = hdr->id;
+	out->proc = hdr->proc;
+	out->length = length;
+	if (length > 0)
+	    bcopy(reply, (char *)(out + 1), length);
+	b->replyLength += RpcSize(max(length, 0));
+	b->replyCount++;
+	if (++b->served == b->count) {
+	    SendReplies(b);
+	    delete [] b->data;
+	    delete [] b->replies;
+	    delete b;
+	}
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// RpcNode::SendReplies
+// 	Send the replies waiting in a batch back to its caller, and start
+//	again.  The lock is held.
+//----------------------------------------------------------------------
+
+void
+RpcNode::SendReplies(RpcBatch *b)
+{
+    PacketHeader outPktHdr;
+    MailHeader outMailHdr;
+
+    *(int *)b->replies = b->replyCount;
+    outPktHdr.to = b->pktHdr.from;
+    outMailHdr.to = b->mailHdr.from;
+    outMailHdr.from = serverBox;
+    outMailHdr.length = b->replyLength;
+    post->Send(outPktHdr, outMailHdr, b->replies);
+
+    b->replyCount = 0;
+    b->replyLength = sizeof(int);
+}
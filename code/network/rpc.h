@@ -0,0 +1,154 @@
+// rpc.h
+//	Data structures for remote procedure calls between machines, on
+//	top of the post office.
+//
+//	Each machine that takes part makes an RpcNode, which is both a
+//	client and a server.  As a server, it runs the procedures that
+//	have been registered with it, by number, on a pool of worker
+//	threads.  As a client, it sends calls to other machines; each
+//	call returns an RpcCall right away, which the caller later waits
+//	on for the reply (a "future").
+//
+//	Calls are batched: the calls made to one machine, one after
+//	another, go out together in one message, and their replies come
+//	back together too.  A batch is sent when it is full, or when a
+//	caller waits on a call in it, or on Flush.  So a thread that makes
+//	many calls before waiting on any pays for one message per batch,
+//	not one per call.
+//
+//	Like the post office, RPC does not recover lost messages: if a
+//	batch or its reply is dropped, the callers in it wait forever.
+//	Use it on a reliable network.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef RPC_H
+#define RPC_H
+
+#include "post.h"
+
+#define RpcMaxProcs	32	// procedures are numbered 0 .. RpcMaxProcs-1
+#define RpcMaxCalls	64	// most calls a node can have outstanding
+
+#define RpcNoProc	-1	// reply length when the procedure is not
+				// registered at the far end
+
+// The following class defines the header of each call or reply in a
+// batch.  A batch is a count of calls (an int), then each call's header
+// followed by its data, padded to a multiple of sizeof(int).
+
+class RpcHeader {
+  public:
+    unsigned id;		// Matches a reply to its call
+    int proc;			// Call: which procedure
+    int length;			// Bytes of data that follow; in a reply,
+				//   RpcNoProc if there was no such procedure
+};
+
+#define RpcMaxData	(int)(MaxMailSize - sizeof(int) - sizeof(RpcHeader))
+
+// A procedure is called with the machine that called it and the request
+// data, and puts its reply in "reply", which has room for RpcMaxData
+// bytes; it returns the length.
+
+typedef int (*RpcHandler)(NetworkAddress from, char *request, int length,
+			char *reply);
+
+// The following class defines an outstanding call -- the future a client
+// waits on.  They come from a fixed pool in the RpcNode.
+
+class RpcCall {
+  public:
+    int Wait();			// Wait for the reply, and return its length
+				// (or RpcNoProc); the call is then freed
+
+    unsigned id;		// Internal: # of the call
+    RpcCall *next;		// Internal: on the free list
+    class RpcNode *node;	// Internal: who made the call
+    char *reply;		// Internal: where the reply goes
+    int replyLength;		// Internal: its length
+    bool batched;		// Internal: still in the unsent batch
+    Semaphore *done;		// Internal: V'ed when the reply is in
+};
+
+// The following class defines a batch of calls that came in together,
+// and is being served by the workers.
+
+class RpcBatch {
+  public:
+    PacketHeader pktHdr;	// Where the calls came from
+    MailHeader mailHdr;
+    char *data;			// The calls, as they came
+    int count;			// # of calls in it
+    int taken;			// # handed to workers so far
+    char *next;			// Where the next one to hand out starts
+    int served;			// # that have been replied to
+    char *replies;		// Replies waiting to be sent
+    int replyCount;		// # of them
+    int replyLength;		// Bytes of "replies" used
+    ListLink<RpcBatch> link;	// On the queue of batches to serve
+};
+
+// The following class defines a machine's RPC client and server.
+
+class RpcNode {
+  public:
+    RpcNode(PostOffice *office, MailBoxAddress callBox,
+		MailBoxAddress replyBox, int numWorkers);
+				// Serve calls arriving in "callBox" of
+				// "office" on "numWorkers" threads, and take
+				// replies to our calls in "replyBox".  Every
+				// machine must use the same "callBox".
+
+    void Register(int proc, RpcHandler handler);
+				// Serve procedure # "proc" with "handler"
+    RpcCall *Call(NetworkAddress to, int proc, char *request, int length,
+		char *reply);	// Call procedure "proc" on machine "to";
+				// the reply goes in "reply", which must
+				// have room for the longest reply the
+				// procedure gives (at most RpcMaxData).
+				// Returns at once; Wait on the result.
+    void Flush();		// Send the batch now, without waiting
+				// for it to fill
+    int MaxData() { return maxData; }
+				// Longest request or reply we can send,
+				// at most RpcMaxData; it depends on the MTU
+
+    void Replies();		// Internal: take in replies to our calls
+    void Requests();		// Internal: take in calls to serve
+    void Worker();		// Internal: serve calls
+    int Finish(RpcCall *call);	// Internal: wait for a call's reply
+
+  private:
+    PostOffice *post;
+    MailBoxAddress serverBox, clientBox;
+    int maxBatch;		// largest batch, in bytes
+    int maxData;		// longest request or reply that fits
+    RpcHandler handlers[RpcMaxProcs];
+
+    Lock *lock;			// protects all of the below
+
+    // client
+    RpcCall *calls;		// RpcMaxCalls calls; call # "id" is
+				//   calls[id % RpcMaxCalls]
+    RpcCall *freeCalls;		// those not outstanding
+    Condition *callFree;	// signalled when a call is freed
+    char *batch;		// calls not sent yet, all to "batchTo"
+    NetworkAddress batchTo;
+    int batchCount;		// # of calls in "batch"
+    int batchLength;		// bytes of "batch" used
+
+    // server
+    IntrusiveList<RpcBatch, &RpcBatch::link> *work;
+				// batches with calls not yet handed out
+    Condition *workArrived;	// signalled when a batch is queued
+
+    void SendBatch();		// Send "batch", and start a new one
+    void SendReplies(RpcBatch *b);	// Send the replies in "b"
+};
+
+#endif // RPC_H
@@ -0,0 +1,431 @@
+// stream.cc
+//	Routines to provide reliable, ordered byte streams on top of the
+//	post office.
+//
+//	Each stream has two threads of its own: one takes in the mail
+//	for the stream's mailbox -- segments from the other end, and
+//	acks for ours -- and one sends segments again when the
+//	retransmit timer expires.  The timer itself is an interrupt
+//	handler; as it cannot send mail, it only wakes the second thread.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "stream.h"
+#include "system.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+// Dummy functions because C++ can't indirectly invoke member functions
+static void StreamDeliver(int arg)
+{ Stream *s = (Stream *) arg; s->Deliver(); }
+static void StreamRetransmit(int arg)
+{ Stream *s = (Stream *) arg; s->Retransmit(); }
+static void StreamTimer(int arg)
+{ Stream *s = (Stream *) arg; s->TimerExpired(); }
+
+//----------------------------------------------------------------------
+// Stream::Stream
+// 	Set up one end of a stream, and start its threads.
+//
+//	"office" -- the post office to send and receive through
+//	"ourBox" -- our mailbox, for this stream only
+//	"farMachine", "farMailBox" -- the mailbox of the other end
+//----------------------------------------------------------------------
+
+Stream::Stream(PostOffice *office, MailBoxAddress ourBox,
+		NetworkAddress farMachine, MailBoxAddress farMailBox)
+{
+    post = office;
+    box = ourBox;
+    farAddr = farMachine;
+    farBox = farMailBox;
+    segmentSize = post->MaxMail() - sizeof(StreamHeader);
+    ASSERT(segmentSize > 0);
+
+    lock = new Lock("stream lock");
+
+    sendBuf = new char[StreamWindow * MaxMailSize];
+    sentAt = new int[StreamWindow];
+    timesSent = new int[StreamWindow];
+    sentAs = new unsigned[StreamWindow];
+    transmissions = 0;
+    sacked = new bool[StreamWindow];
+    sendBase = sendNext = 0;
+    peerWindow = StreamWindow;
+    windowOpen = new Condition("stream window open");
+
+    srtt = -1;
+    rttvar = 0;
+    rto = StreamInitialRto;
+    deadline = -1;
+    timerPending = FALSE;
+    expired = new Semaphore("stream timeout", 0);
+    retransmits = 0;
+
+    recvBuf = new char[StreamWindow * MaxMailSize];
+    present = new bool[StreamWindow];
+    for (int i = 0; i < StreamWindow; i++)
+	present[i] = FALSE;
+    readSeq = readOffset = recvNext = 0;
+    dataArrived = new Condition("stream data arrived");
+
+    (new Thread("stream delivery"))->Fork(StreamDeliver, (int) this);
+    (new Thread("stream retransmit"))->Fork(StreamRetransmit, (int) this);
+}
+
+//----------------------------------------------------------------------
+// Stream::Allowed
+// 	Return how many segments may be unacknowledged at once: as many
+//	as the receiver has room for, but at least one, so that we find
+//	out when a full receiver has made room.
+//----------------------------------------------------------------------
+
+int
+Stream::Allowed()
+{
+    return min(StreamWindow, max(1, peerWindow));
+}
+
+//----------------------------------------------------------------------
+// Stream::Write
+// 	Cut "data" into segments, and send each one as soon as the
+//	window lets us.  The segments stay in the window until they are
+//	acknowledged, so the caller can reuse "data" once we return.
+//----------------------------------------------------------------------
+
+void
+Stream::Write(char *data, int length)
+{
+    lock->Acquire();
+    while (length > 0) {
+	int n = min(length, segmentSize);
+	StreamHeader *hdr;
+
+	while ((int)(sendNext - sendBase) >= Allowed())
+	    windowOpen->Wait(lock);
+	hdr = SendSlot(sendNext);
+	hdr->type = StreamData;
+	hdr->seq = sendNext;
+	hdr->length = n;
+	bcopy(data, (char *)(hdr + 1), n);
+	timesSent[sendNext % StreamWindow] = 0;
+	sacked[sendNext % StreamWindow] = FALSE;
+	sendNext++;
+	SendSegment(sendNext - 1);
+	data += n;
+	length -= n;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Stream::Flush
+// 	Wait until the other end has everything we have written.
+//----------------------------------------------------------------------
+
+void
+Stream::Flush()
+{
+    lock->Acquire();
+    while (sendBase != sendNext)
+	windowOpen->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Stream::Read
+// 	Wait until the next byte of the stream is in, then copy out as
+//	much as there is, up to "length" bytes, from the segment it is
+//	in.  Return the number of bytes copied.
+//
+//	Once a segment has been read, its slot is free for a new one; if
+//	the other end was told we had no room, we tell it we have.
+//----------------------------------------------------------------------
+
+int
+Stream::Read(char *data, int length)
+{
+    StreamHeader *hdr;
+    int n;
+
+    lock->Acquire();
+    while (readSeq == recvNext)
+	dataArrived->Wait(lock);
+    hdr = RecvSlot(readSeq);
+    n = min(length, (int)(hdr->length - readOffset));
+    bcopy((char *)(hdr + 1) + readOffset, data, n);
+    readOffset += n;
+    if (readOffset == hdr->length) {
+	bool wasFull = (recvNext == readSeq + StreamWindow);
+
+	present[readSeq % StreamWindow] = FALSE;
+	readSeq++;
+	readOffset = 0;
+	if (wasFull)
+	    SendAck();
+    }
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Stream::SendSegment
+// 	Send segment "seq", for the first time or again, and make sure
+//	the timer is running.  The lock is held.
+//----------------------------------------------------------------------
+
+void
+Stream::SendSegment(unsigned seq)
+{
+    int slot = seq % StreamWindow;
+    StreamHeader *hdr = SendSlot(seq);
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+
+    pktHdr.to = farAddr;
+    mailHdr.to = farBox;
+    mailHdr.from = box;
+    mailHdr.length = sizeof(StreamHeader) + hdr->length;
+
+    sentAt[slot] = stats->totalTicks;
+    sentAs[slot] = transmissions++;
+    if (timesSent[slot]++ > 0)
+	retransmits++;
+    DEBUG('n', "Stream sending segment %d, try %d\n", seq, timesSent[slot]);
+    post->Send(pktHdr, mailHdr, (char *)hdr);
+
+    if (deadline < 0) {
+	deadline = stats->totalTicks + rto;
+	ArmTimer();
+    }
+}
+
+//----------------------------------------------------------------------
+// Stream::SendAck
+// 	Tell the other end which segments we have: all of them before
+//	recvNext, and those of the next 32 after it that are marked in
+//	"sack".  The lock is held.
+//----------------------------------------------------------------------
+
+void
+Stream::SendAck()
+{
+    StreamHeader hdr;
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+
+    hdr.type = StreamAck;
+    hdr.seq = hdr.length = 0;
+    hdr.ack = recvNext;
+    hdr.sack = 0;
+    for (int i = 0; i < 32; i++) {
+	unsigned seq = recvNext + 1 + i;
+
+	if (seq >= readSeq + StreamWindow)
+	    break;
+	if (present[seq % StreamWindow])
+	    hdr.sack |= 1u << i;
+    }
+    hdr.window = readSeq + StreamWindow - recvNext;
+
+    pktHdr.to = farAddr;
+    mailHdr.to = farBox;
+    mailHdr.from = box;
+    mailHdr.length = sizeof(StreamHeader);
+    post->Send(pktHdr, mailHdr, (char *)&hdr);
+}
+
+//----------------------------------------------------------------------
+// Stream::Deliver
+// 	Forever take the next message from our mailbox, and hand it to
+//	TakeAck or TakeData.
+//----------------------------------------------------------------------
+
+void
+Stream::Deliver()
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char *message = new char[MaxMailSize];
+    StreamHeader *hdr = (StreamHeader *)message;
+
+    for (;;) {
+	post->Receive(box, &pktHdr, &mailHdr, message);
+	ASSERT(mailHdr.length >= sizeof(StreamHeader));
+	lock->Acquire();
+	if (hdr->type == StreamAck)
+	    TakeAck(hdr);
+	else
+	    TakeData(hdr);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Stream::TakeData
+// 	A segment has come in.  Keep it, unless we have it already or
+//	have no room for it, and acknowledge it either way; the other
+//	end may not have heard our last ack.  The lock is held.
+//----------------------------------------------------------------------
+
+void
+Stream::TakeData(StreamHeader *hdr)
+{
+    unsigned seq = hdr->seq;
+
+    if (seq >= recvNext && seq < readSeq + StreamWindow
+				&& !present[seq % StreamWindow]) {
+	bcopy((char *)hdr, (char *)RecvSlot(seq),
+			sizeof(StreamHeader) + hdr->length);
+	present[seq % StreamWindow] = TRUE;
+	if (seq == recvNext) {		// fills the gap; deliver all the
+					// segments it was holding up
+	    while (recvNext < readSeq + StreamWindow
+				&& present[recvNext % StreamWindow])
+		recvNext++;
+	    dataArrived->Broadcast(lock);
+	}
+    }
+    SendAck();
+}
+
+//----------------------------------------------------------------------
+// Stream::TakeAck
+// 	An ack has come in.  Slide the window past the segments it
+//	acknowledges, measuring the round trip on the way, and note the
+//	ones after them that are in out of order.
+//
+//	A segment is taken to be lost, and sent again at once rather than
+//	after a timeout, once StreamDupThresh segments that were sent
+//	after it have overtaken it.  Counting only segments sent after
+//	its last transmission means a lost copy is caught the same way,
+//	without sending a copy that may yet arrive again.  The lock is
+//	held.
+//----------------------------------------------------------------------
+
+void
+Stream::TakeAck(StreamHeader *hdr)
+{
+    if (hdr->ack > sendBase && hdr->ack <= sendNext) {
+	int last = (hdr->ack - 1) % StreamWindow;
+
+	if (timesSent[last] == 1)	// a resent segment's ack could
+	    MeasureRtt(stats->totalTicks - sentAt[last]);
+					// be for either copy
+	sendBase = hdr->ack;
+	deadline = (sendBase == sendNext) ? -1 : stats->totalTicks + rto;
+	ArmTimer();
+    }
+    peerWindow = hdr->window;
+    windowOpen->Broadcast(lock);
+
+    for (int i = 0; i < 32; i++) {
+	unsigned seq = hdr->ack + 1 + i;
+
+	if (seq >= sendNext)
+	    break;
+	if (seq >= sendBase && (hdr->sack & (1u << i)))
+	    sacked[seq % StreamWindow] = TRUE;
+    }
+    for (unsigned seq = sendBase; seq < sendNext; seq++) {
+	int slot = seq % StreamWindow, later = 0;
+
+	if (sacked[slot])
+	    continue;
+	for (unsigned s = seq + 1; s < sendNext; s++)
+	    if (sacked[s % StreamWindow] && sentAs[s % StreamWindow] > sentAs[slot])
+		later++;
+	if (later >= StreamDupThresh)
+	    SendSegment(seq);
+    }
+}
+
+//----------------------------------------------------------------------
+// Stream::MeasureRtt
+// 	Fold a new round trip time into the smoothed round trip time and
+//	its variation, and recompute the retransmit timeout from them, as
+//	TCP does.
+//----------------------------------------------------------------------
+
+void
+Stream::MeasureRtt(int sample)
+{
+    if (srtt < 0) {
+	srtt = sample;
+	rttvar = sample / 2;
+    } else {
+	rttvar = (3 * rttvar + abs(srtt - sample)) / 4;
+	srtt = (7 * srtt + sample) / 8;
+    }
+    rto = min(StreamMaxRto, max(StreamMinRto, srtt + 4 * rttvar));
+}
+
+//----------------------------------------------------------------------
+// Stream::ArmTimer
+// 	Make sure TimerExpired runs at the deadline.  Only one call is
+//	scheduled at a time; if the deadline has moved on by the time it
+//	runs, it schedules itself again.
+//----------------------------------------------------------------------
+
+void
+Stream::ArmTimer()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (!timerPending && deadline >= 0) {
+	timerPending = TRUE;
+	interrupt->Schedule(StreamTimer, (int) this,
+		max(1, deadline - stats->totalTicks), NetworkSendInt);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Stream::TimerExpired
+// 	Interrupt handler for the retransmit timer.  If the deadline has
+//	passed, wake up the retransmit thread.
+//----------------------------------------------------------------------
+
+void
+Stream::TimerExpired()
+{
+    timerPending = FALSE;
+    if (deadline < 0)
+	return;
+    if (stats->totalTicks >= deadline)
+	expired->V();
+    else
+	ArmTimer();
+}
+
+//----------------------------------------------------------------------
+// Stream::Retransmit
+// 	Forever wait for the retransmit timer, then send the oldest
+//	segment the other end does not have again, and back off: the
+//	timeout doubles until an ack gives us a new round trip time.
+//----------------------------------------------------------------------
+
+void
+Stream::Retransmit()
+{
+    for (;;) {
+	expired->P();
+	lock->Acquire();
+	if (deadline >= 0 && stats->totalTicks >= deadline) {
+	    rto = min(StreamMaxRto, 2 * rto);
+	    DEBUG('n', "Stream timed out, timeout now %d\n", rto);
+	    for (unsigned seq = sendBase; seq < sendNext; seq++)
+		if (!sacked[seq % StreamWindow]) {
+		    SendSegment(seq);
+		    break;
+		}
+	    deadline = stats->totalTicks + rto;
+	    ArmTimer();
+	}
+	lock->Release();
+    }
+}
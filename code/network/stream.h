@@ -0,0 +1,147 @@
+// stream.h
+//	Data structures for reliable, ordered, flow-controlled byte
+//	streams between mailboxes on different machines.
+//
+//	The post office delivers messages in order, but it loses them when
+//	the network does.  A stream cuts the bytes written to it into
+//	numbered segments, one per message, and keeps each one until the
+//	far end says it has it:
+//
+//	   - the receiver acknowledges every segment with the number of
+//	     the first segment it is missing (a cumulative ack), and a
+//	     bitmap of the segments after that one it already has (a
+//	     selective ack), so only the missing segments are sent again;
+//	   - up to StreamWindow segments can be unacknowledged at once,
+//	     fewer if the receiver says it has less room (flow control);
+//	   - a segment that is not acknowledged in time is sent again.
+//	     The timeout follows the measured round trip time, doubling
+//	     each time it expires, and is kept by Interrupt::Schedule.
+//
+//	A stream is one end of a connection: the two machines each make
+//	a Stream, naming the other's machine and mailbox.  Data and acks
+//	for a stream arrive in its mailbox, which nothing else may use.
+//	Both ends can Write and Read.  A stream lasts as long as Nachos.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "post.h"
+
+#define StreamWindow	32	// most segments in flight; also the
+				// receiver's room for segments
+
+#define StreamDupThresh	3	// a segment is lost once this many
+				// segments sent after it are acked
+
+#define StreamInitialRto (10 * NetworkTime)	// retransmit timeout,
+#define StreamMinRto	(3 * NetworkTime)	//   before any round trip
+#define StreamMaxRto	(200 * NetworkTime)	//   has been measured,
+						//   and its limits
+
+// The following class defines the stream header, which comes first
+// in the data of each message a stream sends.  A message is either
+// a segment of data or an ack; a segment carries no ack.
+
+enum StreamType { StreamData, StreamAck };
+
+class StreamHeader {
+  public:
+    int type;			// StreamData or StreamAck
+    unsigned seq;		// StreamData: # of the segment
+    unsigned length;		// StreamData: bytes of data that follow
+    unsigned ack;		// StreamAck: every segment before this is in
+    unsigned sack;		// StreamAck: bit i is set if segment
+				//   ack + 1 + i is in too
+    int window;			// StreamAck: # of segments from "ack" on
+				//   the receiver has room for
+};
+
+// The following class defines one end of a stream.
+
+class Stream {
+  public:
+    Stream(PostOffice *office, MailBoxAddress ourBox,
+		NetworkAddress farMachine, MailBoxAddress farMailBox);
+				// Set up a stream from mailbox "ourBox" of
+				// "office" to mailbox "farMailBox" at
+				// "farMachine"
+
+    void Write(char *data, int length);
+				// Send "length" bytes; return once they
+				// are in the window (not once they are
+				// acknowledged)
+    void Flush();		// Wait until everything written has been
+				// acknowledged
+    int Read(char *data, int length);
+				// Wait for data, and return up to "length"
+				// bytes of it; return how many
+
+    int Retransmits() { return retransmits; }
+
+    void Deliver();		// Internal: take in the stream's mail
+    void Retransmit();		// Internal: resend when timeouts expire
+    void TimerExpired();	// Internal: interrupt handler
+
+  private:
+    PostOffice *post;
+    MailBoxAddress box;		// where our segments and acks arrive
+    NetworkAddress farAddr;	// the other end
+    MailBoxAddress farBox;
+    int segmentSize;		// bytes of data in a full segment
+
+    Lock *lock;			// protects all of the below
+
+    // sending
+    char *sendBuf;		// StreamWindow segments, headers included;
+				//   segment "seq" is in slot 
+				//   seq % StreamWindow
+    int *sentAt;		// when each was last sent
+    int *timesSent;		// how often each was sent
+    unsigned *sentAs;		// # of the transmission that last carried
+    unsigned transmissions;	//   each; # of transmissions so far
+    bool *sacked;		// the receiver has it, out of order
+    unsigned sendBase;		// oldest unacknowledged segment
+    unsigned sendNext;		// next segment to be written
+    int peerWindow;		// room the receiver last told us of
+    Condition *windowOpen;	// signalled when segments are acked
+
+    // timing
+    int srtt, rttvar;		// smoothed round trip time and its
+				//   variation, in ticks; srtt < 0 until
+				//   the first is measured
+    int rto;			// current retransmit timeout
+    int deadline;		// when the oldest segment times out; -1
+				//   if nothing is in flight
+    bool timerPending;		// TimerExpired is scheduled
+    Semaphore *expired;		// V'ed by TimerExpired at the deadline
+    int retransmits;		// # of segments sent again
+
+    // receiving
+    char *recvBuf;		// StreamWindow segments, as for sending
+    bool *present;		// slot holds a segment not yet read
+    unsigned readSeq;		// segment Read takes data from next
+    unsigned readOffset;	//   and where in it
+    unsigned recvNext;		// first segment not yet in
+    Condition *dataArrived;	// signalled when recvNext moves
+
+    void SendSegment(unsigned seq);	// (Re)send segment "seq"
+    void SendAck();			// Tell the other end what we have
+    void TakeAck(StreamHeader *hdr);	// Process an ack
+    void TakeData(StreamHeader *hdr);	// Process a segment; its data
+					//   follows the header
+    void MeasureRtt(int sample);	// Fold a round trip into the rto
+    void ArmTimer();			// Make sure TimerExpired will run
+    int Allowed();			// # of segments we may have in flight
+    StreamHeader *SendSlot(unsigned seq)
+	{ return (StreamHeader *)&sendBuf[(seq % StreamWindow) * MaxMailSize]; }
+    StreamHeader *RecvSlot(unsigned seq)
+	{ return (StreamHeader *)&recvBuf[(seq % StreamWindow) * MaxMailSize]; }
+};
+
+#endif // STREAM_H
@@ -0,0 +1,103 @@
+/* aiocopy.c 
+ *    Test program for asynchronous I/O.
+ *
+ *    Copies a file from a single thread, with several reads and writes
+ *    under way at once: as each read completes, the write of what it
+ *    read is started.  Meanwhile a receive is kept posted on mailbox 0;
+ *    on a Nachos with a network (the one in network/), a message sent
+ *    there is reported when it arrives, without holding up the copy.
+ */
+
+#include "syscall.h"
+
+#define RING	8	/* entries in each ring */
+#define CHUNK	128	/* bytes each read or write moves */
+#define CHUNKS	64	/* chunks in the file */
+#define RECEIVE	-1	/* tag of the receive */
+
+AioRing ring;
+AioRequest requests[RING];
+AioCompletion completions[RING];
+char data[CHUNKS][CHUNK];
+char message[64];
+
+void
+Queue(int op, int id, char *buffer, int length, int offset, int tag)
+{
+    AioRequest *r = &requests[ring.submitTail % RING];
+
+    r->op = op;
+    r->id = id;
+    r->buffer = (int) buffer;
+    r->length = length;
+    r->offset = offset;
+    r->tag = tag;
+    ring.submitTail++;
+}
+
+int
+main()
+{
+    OpenFileId from, to;
+    AioCompletion *c;
+    int i, j, read = 0, written = 0, busy = 0;
+
+    /* first make a file to copy */
+    Create("aiofrom");
+    Create("aioto");
+    from = Open("aiofrom");
+    to = Open("aioto");
+    for (i = 0; i < CHUNKS; i++) {
+	for (j = 0; j < CHUNK; j++)
+	    data[i][j] = i + j;
+	Write(data[i], CHUNK, from);
+	for (j = 0; j < CHUNK; j++)
+	    data[i][j] = 0;
+    }
+
+    ring.size = RING;
+    ring.requests = (int) requests;
+    ring.completions = (int) completions;
+    AioSetup(&ring);
+    Queue(AioReceive, 0, message, sizeof(message), 0, RECEIVE);
+
+    /* then copy it; RING - 1 reads and writes are under way at once */
+    while (written < CHUNKS) {
+	while (read < CHUNKS && busy < RING - 1) {
+	    Queue(AioRead, from, data[read], CHUNK, read * CHUNK, read);
+	    read++;
+	    busy++;
+	}
+	AioSubmit();
+	AioWait();
+	while (ring.completeHead != ring.completeTail) {
+	    c = &completions[ring.completeHead % RING];
+	    if (c->tag == RECEIVE) {
+		if (c->result > 0)
+		    Write("message received\n", 17, ConsoleOutput);
+	    } else if (c->tag < CHUNKS) {	/* a read: write it out */
+		Queue(AioWrite, to, data[c->tag], c->result, c->tag * CHUNK,
+							CHUNKS + c->tag);
+	    } else {
+		written++;
+		busy--;
+	    }
+	    ring.completeHead++;
+	}
+    }
+    Close(from);
+    Close(to);
+
+    /* check the copy */
+    to = Open("aioto");
+    for (i = 0; i < CHUNKS; i++) {
+	Read(data[0], CHUNK, to);
+	for (j = 0; j < CHUNK; j++)
+	    if (data[0][j] != (char)(i + j)) {
+		Write("copy is wrong\n", 14, ConsoleOutput);
+		Halt();
+	    }
+    }
+    Write("copy is right\n", 14, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,51 @@
+/* mapsort.c 
+ *    Test program to sort a file of integers in place, through Mmap.
+ *
+ *    The array is written to a file, which is mapped and sorted where
+ *    it lies: its pages are faulted in from the file, and written back
+ *    to it when they are paged out and on Munmap.  Then the file is
+ *    read back to check it.
+ */
+
+#include "syscall.h"
+
+#define N	1024	/* more memory than a program gets; it will page */
+
+int
+main()
+{
+    OpenFileId f;
+    int *A;
+    int i, j, tmp;
+
+    Create("sortdata");
+    f = Open("sortdata");
+
+    /* first write the array, in reverse sorted order */
+    for (i = 0; i < N; i++) {
+	tmp = N - i;
+	Write((char *) &tmp, sizeof(int), f);
+    }
+
+    /* then sort it in the file! */
+    A = (int *) Mmap(f, N * sizeof(int));
+    for (i = 0; i < N - 1; i++)
+        for (j = 0; j < (N - 1 - i); j++)
+	   if (A[j] > A[j + 1]) {	/* out of order -> need to swap ! */
+	      tmp = A[j];
+	      A[j] = A[j + 1];
+	      A[j + 1] = tmp;
+    	   }
+    Munmap((char *) A);
+    Close(f);
+
+    /* the smallest should now come first */
+    f = Open("sortdata");
+    Read((char *) &tmp, sizeof(int), f);
+    Close(f);
+    if (tmp == 1)
+	Write("sorted\n", 7, ConsoleOutput);
+    else
+	Write("not sorted\n", 11, ConsoleOutput);
+    Halt();
+}
@@ -0,0 +1,31 @@
+/* piperead.c 
+ *    Reader half of the pipe test (see pipewrite.c).
+ *
+ *    Reads into a page-aligned buffer until the writer closes its end,
+ *    so that whole pages the writer gave the pipe can be mapped here
+ *    rather than copied, and checks every byte.  Exits with the
+ *    number of bad bytes.
+ */
+
+#include "syscall.h"
+
+#define PIPE	2	/* the read end */
+#define PAGE	128	/* PageSize */
+#define BATCH	4	/* most pages per Read */
+
+char space[(BATCH + 1) * PAGE];
+
+int
+main()
+{
+    char *buffer = (char *) (((int) space + PAGE - 1) & ~(PAGE - 1));
+    int got = 0, bad = 0, n, j;
+
+    while ((n = Read(buffer, BATCH * PAGE, PIPE)) > 0) {
+	for (j = 0; j < n; j++)
+	    if (buffer[j] != (char) ((got + j) % 251))
+		bad++;
+	got += n;
+    }
+    Exit(bad);
+}
@@ -0,0 +1,34 @@
+/* pipewrite.c 
+ *    Writer half of the pipe test: run it with piperead, under
+ *    "nachos -xp pipewrite piperead", which gives it the write end of
+ *    a pipe as OpenFileId 2.
+ *
+ *    Writes PAGES pages, a few at a time, from a page-aligned buffer,
+ *    so that each page can be handed to the pipe rather than copied.
+ *    A page given away must be written again before it is reused.
+ */
+
+#include "syscall.h"
+
+#define PIPE	2	/* the write end */
+#define PAGE	128	/* PageSize */
+#define BATCH	4	/* pages per Write */
+#define PAGES	256	/* pages in all */
+
+char space[(BATCH + 1) * PAGE];
+
+int
+main()
+{
+    char *buffer = (char *) (((int) space + PAGE - 1) & ~(PAGE - 1));
+    int sent, j;
+
+    for (sent = 0; sent < PAGES * PAGE; sent += BATCH * PAGE) {
+	for (j = 0; j < BATCH * PAGE; j++)
+	    buffer[j] = (sent + j) % 251;
+	if (Write(buffer, BATCH * PAGE, PIPE) != BATCH * PAGE)
+	    Exit(1);
+    }
+    Close(PIPE);
+    Exit(0);
+}
@@ -130,6 +130,54 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl Mmap
+	.ent	Mmap
+Mmap:
+	addiu $2,$0,SC_Mmap
+	syscall
+	j	$31
+	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:
+	addiu $2,$0,SC_Munmap
+	syscall
+	j	$31
+	.end Munmap
+
+	.globl AioSetup
+	.ent	AioSetup
+AioSetup:
+	addiu $2,$0,SC_AioSetup
+	syscall
+	j	$31
+	.end AioSetup
+
+	.globl AioSubmit
+	.ent	AioSubmit
+AioSubmit:
+	addiu $2,$0,SC_AioSubmit
+	syscall
+	j	$31
+	.end AioSubmit
+
+	.globl AioWait
+	.ent	AioWait
+AioWait:
+	addiu $2,$0,SC_AioWait
+	syscall
+	j	$31
+	.end AioWait
+
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
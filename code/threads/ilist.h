@@ -0,0 +1,217 @@
+// ilist.h
+//	Data structures to manage intrusive lists.
+//
+//	A List allocates a ListElement every time something is put on
+//	it, which is too slow for the queues the kernel touches on every
+//	context switch, P and V.  Here the links live inside the items
+//	themselves: a class that wants to be queued declares a ListLink
+//	member, and an IntrusiveList is told which member to use:
+//
+//		class Thread { ... ListLink<Thread> queueLink; ... };
+//		IntrusiveList<Thread, &Thread::queueLink> readyList;
+//
+//	Putting an item on a list, or taking it off, never allocates
+//	memory.  The price is that an item can only be on one list per
+//	link at a time; this is checked.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ILIST_H
+#define ILIST_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The following class defines the link embedded in an item.  The
+// fields are only touched by IntrusiveList.
+
+template <class T>
+class ListLink {
+  public:
+    ListLink() { next = prev = NULL; key = 0; onList = FALSE; }
+
+    T *next;			// neighbours on the list, NULL at the ends
+    T *prev;
+    int key;			// priority, for a sorted list
+    bool onList;		// is the item on a list?
+};
+
+// The following class defines an intrusive list -- a doubly linked
+// list of items of type T, threaded through their "link" member.
+// Apart from the item type, the interface is that of List; Remove of
+// a given item, and First/Next for walking the list, are extra.
+
+template <class T, ListLink<T> T::*link>
+class IntrusiveList {
+  public:
+    IntrusiveList() { first = last = NULL; }
+    ~IntrusiveList() {}		// the items are not ours to free
+
+    void Prepend(T *item);	// Put item at the beginning of the list
+    void Append(T *item);	// Put item at the end of the list
+    T *Remove();		// Take item off the front of the list,
+				// NULL if it is empty
+    void Remove(T *item);	// Take "item" off, wherever it is
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every item
+    bool IsEmpty() { return first == NULL; }
+
+    T *First() { return first; }	// Walk the list: First, then Next
+    T *Next(T *item) { return (item->*link).next; }	// until NULL
+
+    // Routines to put/get items on/off list in order (sorted by key)
+    void SortedInsert(T *item, int sortKey);	// Put item into list
+    T *SortedRemove(int *keyPtr);		// Remove first item from list
+
+  private:
+    T *first;			// Head of the list, NULL if list is empty
+    T *last;			// Last item of list
+
+    void InsertAfter(T *prev, T *item);	// Link "item" in after "prev",
+					// or at the front if "prev" is NULL
+};
+
+//----------------------------------------------------------------------
+// IntrusiveList::InsertAfter
+//	Link "item" into the list after "prev", or at the front if "prev"
+//	is NULL.  Every insertion goes through here.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::InsertAfter(T *prev, T *item)
+{
+    ListLink<T> *l = &(item->*link);
+    T *next = (prev == NULL) ? first : (prev->*link).next;
+
+    ASSERT(!l->onList);		// only one list per link
+    l->onList = TRUE;
+    l->prev = prev;
+    l->next = next;
+    if (prev == NULL)
+	first = item;
+    else
+	(prev->*link).next = item;
+    if (next == NULL)
+	last = item;
+    else
+	(next->*link).prev = item;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Prepend / Append
+//	Put an item at the beginning or the end of the list.  The item
+//	must not be on another list through the same link.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::Prepend(T *item)
+{
+    (item->*link).key = 0;
+    InsertAfter(NULL, item);
+}
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::Append(T *item)
+{
+    (item->*link).key = 0;
+    InsertAfter(last, item);
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Remove
+//	Take an item off the list: the first one, returning NULL if
+//	there is none, or the given one, which must be on this list.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+T *
+IntrusiveList<T, link>::Remove()
+{
+    T *item = first;
+
+    if (item != NULL)
+	Remove(item);
+    return item;
+}
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::Remove(T *item)
+{
+    ListLink<T> *l = &(item->*link);
+
+    ASSERT(l->onList);
+    if (l->prev == NULL)
+	first = l->next;
+    else
+	(l->prev->*link).next = l->next;
+    if (l->next == NULL)
+	last = l->prev;
+    else
+	(l->next->*link).prev = l->prev;
+    l->next = l->prev = NULL;
+    l->onList = FALSE;
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::Mapcar
+//	Apply a function to each item on the list, by walking through
+//	the list, one item at a time.  As with List::Mapcar, the item is
+//	passed to "func" as an int.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::Mapcar(VoidFunctionPtr func)
+{
+    for (T *item = first; item != NULL; item = (item->*link).next) {
+	DEBUG('l', "In mapcar, about to invoke %x(%x)\n", func, item);
+	(*func)((int)item);
+    }
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::SortedInsert
+//	Insert an item into the list, so that the list elements are
+//	sorted in increasing order by "sortKey".  Items with equal keys
+//	stay in FIFO order, as with List::SortedInsert.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+void
+IntrusiveList<T, link>::SortedInsert(T *item, int sortKey)
+{
+    T *prev = last;
+
+    // walk from the back: new items usually go at or near the end
+    while (prev != NULL && (prev->*link).key > sortKey)
+	prev = (prev->*link).prev;
+    (item->*link).key = sortKey;
+    InsertAfter(prev, item);
+}
+
+//----------------------------------------------------------------------
+// IntrusiveList::SortedRemove
+//	Remove the first item from the list, returning NULL if there is
+//	none.  If "keyPtr" is not NULL, the item's key is stored there.
+//----------------------------------------------------------------------
+
+template <class T, ListLink<T> T::*link>
+T *
+IntrusiveList<T, link>::SortedRemove(int *keyPtr)
+{
+    T *item = first;
+
+    if (item != NULL) {
+	if (keyPtr != NULL)
+	    *keyPtr = (item->*link).key;
+	Remove(item);
+    }
+    return item;
+}
+
+#endif // ILIST_H
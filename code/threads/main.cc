@@ -9,11 +9,14 @@
 // 	Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+//		-s -cpus <n> -x <nachos file> -c <consoleIn> <consoleOut>
+//		-xp <writer> <reader> -xpc <writer> <reader>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
-//              -n <network reliability> -m <machine id>
-//              -o <other machine id>
+//		-p <nachos file> -r <nachos file> -l -D -t -ts <count> -tc <trials>
+//              -n <network reliability> -m <machine id> -net <socket|shm>
+//              -mtu <bytes> -o <other machine id> -or <machines> -ot <kbytes>
+//              -os <messages> -og <kbytes> -ob <kbytes>
+//              -oc <other machine id> <calls> -ow <messages> -of <kbytes>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
@@ -22,7 +25,12 @@
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -cpus simulates <n> CPUs, each with its own registers and TLB
 //    -x runs a user program
+//    -xp runs two user programs, the writer's OpenFileId 2 the write end
+//	of a pipe and the reader's the read end, and times the pipe;
+//	whole pages move through it by remapping
+//    -xpc does the same, copying every page instead
 //    -c tests the console
 //
 //  FILESYS
@@ -33,11 +41,27 @@
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -ts times creating and removing <count> small files
+//    -tc crashes Nachos <trials> times, checking the disk after each
 //
 //  NETWORK
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
+//    -net picks how packets get to the other Nachos: UNIX sockets (the
+//	default), or rings in memory shared with them
+//    -mtu sets the largest packet this machine sends, header included
 //    -o runs a simple test of the Nachos network software
+//    -or runs a ring of <machines> machines inside this one process
+//    -ot times sending <kbytes> between two machines, at several MTUs
+//    -os times sending <messages> from 1, 4 and 16 threads at once
+//    -og times a reliable stream of <kbytes>, as the network loses more
+//    -ob times a bulk transfer of <kbytes> in large messages, likewise
+//    -oc times <calls> null RPCs to the other machine, one at a time and
+//	then batched; run it on both machines
+//    -ow times serving <messages> to several mailboxes, with a thread per
+//	mailbox and then with one thread in WaitAny
+//    -of times reading <kbytes> from a remote file system, with and
+//	without a client cache
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -61,8 +85,14 @@ extern int testnum;
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
+extern void SmallFilesTest(int count), CrashTest(int trials);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
-extern void MailTest(int networkID);
+extern void PipeTest(char *writer, char *reader, bool remap);
+extern void MailTest(int networkID), RingTest(int numNodes);
+extern void ThroughputTest(int kbytes), SendersTest(int messages);
+extern void GoodputTest(int kbytes), BulkTest(int kbytes);
+extern void RpcTest(int farAddr, int calls), SelectTest(int messages);
+extern void RemoteFsTest(int kbytes);
 
 //----------------------------------------------------------------------
 // main
@@ -113,6 +143,10 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-xp") || !strcmp(*argv, "-xpc")) {
+	    ASSERT(argc > 2);		// time a pipe between two programs
+	    PipeTest(*(argv + 1), *(argv + 2), !strcmp(*argv, "-xp"));
+	    argCount = 3;
         } else if (!strcmp(*argv, "-c")) {      // test the console
 	    if (argc == 1)
 	        ConsoleTest(NULL, NULL);
@@ -145,6 +179,14 @@ main(int argc, char **argv)
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-ts")) {	// small files test
+	    ASSERT(argc > 1);
+            SmallFilesTest(atoi(*(argv + 1)));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tc")) {	// crash test
+	    ASSERT(argc > 1);
+            CrashTest(atoi(*(argv + 1)));
+	    argCount = 2;
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -155,6 +197,41 @@ main(int argc, char **argv)
 						// start up another nachos
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-or")) {
+	    ASSERT(argc > 1);
+            RingTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ot")) {
+	    ASSERT(argc > 1);
+            ThroughputTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-os")) {
+	    ASSERT(argc > 1);
+            SendersTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-og")) {
+	    ASSERT(argc > 1);
+            GoodputTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ob")) {
+	    ASSERT(argc > 1);
+            BulkTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-oc")) {
+	    ASSERT(argc > 2);
+            Delay(2); 				// as for -o
+            RpcTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-ow")) {
+	    ASSERT(argc > 1);
+            SelectTest(atoi(*(argv + 1)));
+            argCount = 2;
+#ifdef FILESYS_NEEDED
+        } else if (!strcmp(*argv, "-of")) {
+	    ASSERT(argc > 1);
+            RemoteFsTest(atoi(*(argv + 1)));
+            argCount = 2;
+#endif
         }
 #endif // NETWORK
     }
@@ -11,8 +11,8 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Threads are kept in per-priority FIFO queues, so that every
+//	operation takes constant time.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,6 +22,75 @@
 #include "scheduler.h"
 #include "system.h"
 
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// RunQueue::RunQueue
+// 	Initialize a run queue with no threads on it.
+//----------------------------------------------------------------------
+
+RunQueue::RunQueue()
+{
+    for (int i = 0; i < PriorityWords; i++)
+        nonEmpty[i] = 0;
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Append
+// 	Put a thread at the end of the queue for its priority.
+//
+//	"thread" is the thread to be queued.
+//	"prio" is its priority, already clipped to the valid range.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Append(Thread *thread, int prio)
+{
+    ASSERT(prio >= 0 && prio < NumPriorities);
+    queue[prio].Append(thread);
+    nonEmpty[prio / 32] |= 1u << (prio % 32);
+    count++;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::RemoveFirst
+// 	Take the first thread off the most urgent non-empty queue.  The
+//	bitmap says which queue that is; ffs finds the lowest set bit.
+//----------------------------------------------------------------------
+
+Thread *
+RunQueue::RemoveFirst()
+{
+    Thread *thread;
+    int prio;
+
+    if (count == 0)
+        return NULL;
+    for (int i = 0; ; i++)
+        if (nonEmpty[i] != 0) {
+            prio = i * 32 + ffs(nonEmpty[i]) - 1;
+            break;
+        }
+    thread = queue[prio].Remove();
+    if (queue[prio].IsEmpty())
+        nonEmpty[prio / 32] &= ~(1u << (prio % 32));
+    count--;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// RunQueue::Print
+// 	Print the queued threads, most urgent first.
+//----------------------------------------------------------------------
+
+void
+RunQueue::Print()
+{
+    for (int prio = 0; prio < NumPriorities; prio++)
+        queue[prio].Mapcar((VoidFunctionPtr) ThreadPrint);
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
@@ -29,11 +98,8 @@
 
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
-    // -------Lab 2 ------
-    notimeList = new List; 
-    // If a thread used all its time slice, put it in this list
-    //--------end Lab2----
+    active = new RunQueue;
+    expired = new RunQueue;
 } 
 
 //----------------------------------------------------------------------
@@ -43,10 +109,8 @@ Scheduler::Scheduler()
 
 Scheduler::~Scheduler()
 { 
-    delete readyList;
-    // -------Lab 2 ------
-    delete notimeList;
-    //--------end Lab2---- 
+    delete active;
+    delete expired;
 } 
 
 //----------------------------------------------------------------------
@@ -54,25 +118,33 @@ Scheduler::~Scheduler()
 // 	Mark a thread as ready, but not running.
 //	Put it on the ready list, for later scheduling onto the CPU.
 //
+//	A thread that has used up its time slice loses some of its
+//	interactive bonus, and waits on the expired queue with a fresh
+//	slice.
+//
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
 
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    int prio;
+
     thread->setStatus(READY);
-    //readyList->Append((void *)thread);
-    //------------Lab 2--------------
-    if (thread->ifDue())
-    {
-        DEBUG('t', "Putting thread %s on notime-ready-List.\n", thread->getName());
+    prio = thread->getPriority() - thread->getBonus();
+    if (prio < 0)
+        prio = 0;
+    else if (prio >= NumPriorities)
+        prio = NumPriorities - 1;
+    if (thread->ifDue()) {
+        DEBUG('t', "Putting thread %s on expired queue.\n", thread->getName());
         thread->resetTicks();
-        notimeList->SortedInsert((void *)thread, thread->getPriority());
-    }else{
+        thread->dropBonus();
+        expired->Append(thread, prio);
+    } else {
         DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
-        readyList->SortedInsert((void *)thread, thread->getPriority());
+        active->Append(thread, prio);
     }
-    //----------end Lab 2--------------
 }
 
 //----------------------------------------------------------------------
@@ -86,27 +158,13 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    //return (Thread *)readyList->Remove();
-    // ------------Lab 2------------
-    Thread *find;
-    //Print();
-    if (!readyList->IsEmpty())
-        find = (Thread *)(readyList->Remove());
-    else{
-        if (!notimeList->IsEmpty()){
-            // swap these two List
-            DEBUG('t', "No thread in Ready List, Swap two lists.\n");
-            List *tmp = readyList;
-            readyList = notimeList;
-            notimeList = tmp;
-            find = (Thread *)(readyList->Remove());
-        }
-        else{
-            find = NULL;
-        }
+    if (active->IsEmpty() && !expired->IsEmpty()) {
+        DEBUG('t', "No active thread left, swap run queues.\n");
+        RunQueue *tmp = active;
+        active = expired;
+        expired = tmp;
     }
-    // ------------end Lab 2------------
-    return find;
+    return active->RemoveFirst();
 }
 
 //----------------------------------------------------------------------
@@ -163,6 +221,8 @@ Scheduler::Run (Thread *nextThread)
     
 #ifdef USER_PROGRAM
     if (currentThread->space != NULL) {		// if there is an address space
+        // run on the CPU that has its translations, if one does
+        machine->SelectCpu(machine->FindCpu(currentThread->space));
         currentThread->RestoreUserState();     // to restore, do it.
 	currentThread->space->RestoreState();
     }
@@ -178,5 +238,7 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    active->Print();
+    printf("Expired list contents:\n");
+    expired->Print();
 }
\ No newline at end of file
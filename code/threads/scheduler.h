@@ -10,12 +10,48 @@
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
 
+// Thread priorities run from 0 (most urgent) to NumPriorities - 1;
+// priorities outside that range are treated as the nearest end.
+
+#define NumPriorities	64
+#define PriorityWords	(NumPriorities / 32)	// words in a priority bitmap
+
+// The following class defines a run queue -- one FIFO queue of threads
+// per priority, and a bitmap of which queues are not empty, so that
+// both putting a thread on the queue and finding the most urgent one
+// take constant time, however many threads are ready.
+
+class RunQueue {
+  public:
+    RunQueue();
+
+    void Append(Thread *thread, int prio); // Queue "thread" at "prio"
+    Thread *RemoveFirst();		// Dequeue the most urgent thread,
+					// NULL if there is none
+    bool IsEmpty() { return count == 0; }
+    void Print();			// Print the queued threads
+
+  private:
+    ThreadList queue[NumPriorities];	// ready threads, by priority
+    unsigned int nonEmpty[PriorityWords]; // bit p set if queue[p] has
+					// a thread
+    int count;				// # of threads queued
+};
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// Ready threads wait on the "active" run queue until they have used up
+// their time slice; then they wait on the "expired" one.  When no
+// active thread is left the two queues trade places, so every thread
+// gets its slice before anyone gets a second one.
+//
+// A thread's priority is improved by up to MaxBonus while it keeps
+// blocking before its slice is used up, so that interactive threads
+// are picked ahead of CPU-bound ones of the same priority.
 
 class Scheduler {
   public:
@@ -27,17 +63,12 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
-    //---Lab2---
-    void RemoveFirstThread(){readyList->Remove();}  
-        // when the highest-priority process Yield(), it put himself in Readylist,
-        // but his is still the one to run, so we simply remove this from Readylist and 
-        // continues running.
-    //--- end Lab 2---
+
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
-    List *notimeList;     // queue of threads that are ready to run,
-        // but have used up pf their time slice.
+    RunQueue *active;			// threads ready to run, with some of
+					// their time slice left
+    RunQueue *expired;			// threads ready to run, that have
+					// used up their time slice
 };
 
 #endif // SCHEDULER_H
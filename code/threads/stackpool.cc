@@ -0,0 +1,111 @@
+// stackpool.cc
+//	Routines to hand out and recycle thread execution stacks.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "stackpool.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// StackPool::StackPool
+// 	Initialize an empty pool.
+//----------------------------------------------------------------------
+
+StackPool::StackPool()
+{
+    buckets = NULL;
+    numAllocated = 0;
+}
+
+//----------------------------------------------------------------------
+// StackPool::~StackPool
+// 	Free every idle stack, guard pages and all.
+//----------------------------------------------------------------------
+
+StackPool::~StackPool()
+{
+    while (buckets != NULL) {
+        StackBucket *b = buckets;
+
+        while (b->free != NULL) {
+            int *stack = b->free;
+
+            b->free = *(int **) stack;
+            DeallocBoundedArray((char *) stack, b->words * sizeof(int));
+        }
+        buckets = b->next;
+        delete b;
+    }
+}
+
+//----------------------------------------------------------------------
+// StackPool::Find
+// 	Return the bucket for stacks of "words" words, making one if
+//	this is a new size.  Threads use few different sizes, so a list
+//	is enough.
+//----------------------------------------------------------------------
+
+StackBucket *
+StackPool::Find(int words)
+{
+    StackBucket *b;
+
+    for (b = buckets; b != NULL; b = b->next)
+        if (b->words == words)
+            return b;
+    b = new StackBucket;
+    b->words = words;
+    b->free = NULL;
+    b->count = 0;
+    b->next = buckets;
+    buckets = b;
+    return b;
+}
+
+//----------------------------------------------------------------------
+// StackPool::Get
+// 	Return a stack of "words" words, with guard pages either side.
+//	An idle one is reused if there is one; otherwise a new one is
+//	allocated.
+//----------------------------------------------------------------------
+
+int *
+StackPool::Get(int words)
+{
+    StackBucket *b = Find(words);
+    int *stack = b->free;
+
+    if (stack != NULL) {
+        b->free = *(int **) stack;
+        b->count--;
+        return stack;
+    }
+    numAllocated++;
+    return (int *) AllocBoundedArray(words * sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// StackPool::Put
+// 	Take back a stack that is no longer in use.  If there are already
+//	MaxPooledStacks idle ones of its size, free it for real.
+//
+//	"stack" -- the stack, as returned by Get
+//	"words" -- its size
+//----------------------------------------------------------------------
+
+void
+StackPool::Put(int *stack, int words)
+{
+    StackBucket *b = Find(words);
+
+    if (b->count == MaxPooledStacks) {
+        DeallocBoundedArray((char *) stack, words * sizeof(int));
+        return;
+    }
+    *(int **) stack = b->free;
+    b->free = stack;
+    b->count++;
+}
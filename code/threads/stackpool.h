@@ -0,0 +1,52 @@
+// stackpool.h
+//	Data structures to recycle thread execution stacks.
+//
+//	Allocating a stack with AllocBoundedArray costs two mprotect
+//	calls to set up its guard pages, and freeing it two more.  Rather
+//	than give a finished thread's stack back, we keep it, guard pages
+//	and all, for the next thread that wants a stack of the same size.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef STACKPOOL_H
+#define STACKPOOL_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxPooledStacks	64	// most idle stacks kept of each size
+
+// Idle stacks of one size.  They are chained through their first word,
+// which StackAllocate overwrites with the fencepost anyway.
+
+class StackBucket {
+  public:
+    int words;			// size of the stacks, in words
+    int *free;			// first idle stack, NULL if none
+    int count;			// # of idle stacks
+    StackBucket *next;		// bucket for another size
+};
+
+// The following class defines the pool of idle stacks.
+
+class StackPool {
+  public:
+    StackPool();
+    ~StackPool();		// Really free every idle stack
+
+    int *Get(int words);	// A guarded stack of "words" words
+    void Put(int *stack, int words);	// Recycle a stack from Get
+
+    int NumAllocated() { return numAllocated; }	// # of times Get had
+				// to allocate a new stack
+
+  private:
+    StackBucket *buckets;	// one per stack size seen so far
+    int numAllocated;
+
+    StackBucket *Find(int words);	// The bucket for "words"
+};
+
+#endif // STACKPOOL_H
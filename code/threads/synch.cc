@@ -37,7 +37,7 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List;
+    queue = new ThreadList;
 }
 
 //----------------------------------------------------------------------
@@ -67,7 +67,7 @@ Semaphore::P()
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue->Append(currentThread);		// so go to sleep
 	currentThread->Sleep();
     } 
     value--; 					// semaphore available, 
@@ -90,7 +90,7 @@ Semaphore::V()
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    thread = (Thread *)queue->Remove();
+    thread = queue->Remove();
     if (thread != NULL)	   // make thread ready, consuming the V immediately
 	scheduler->ReadyToRun(thread);
     value++;
@@ -130,7 +130,7 @@ bool Lock::isHeldByCurrentThread(){return owner == currentThread;}
 
 Condition::Condition(char* debugName) {
     name = debugName;
-    waitlist = new List();
+    waitlist = new ThreadList();
 }
 Condition::~Condition() {
     delete waitlist;
@@ -140,7 +140,7 @@ void Condition::Wait(Lock* conditionLock) {
     ASSERT(conditionLock->isHeldByCurrentThread());
     conditionLock->Release();
     DEBUG('t', "%s waits on list %s\n", currentThread->getName(), name);
-    waitlist->Append((void *)currentThread);
+    waitlist->Append(currentThread);
     currentThread->Sleep();
     conditionLock->Acquire();
     (void)interrupt->SetLevel(oldLevel);
@@ -150,7 +150,7 @@ void Condition::Signal(Lock* conditionLock) {
     ASSERT(conditionLock->isHeldByCurrentThread());
     if (!waitlist->IsEmpty())
     {
-        Thread* waitingThread = (Thread*)waitlist->Remove();
+        Thread* waitingThread = waitlist->Remove();
         DEBUG('t', "%s signals %s on list %s\n", currentThread->getName(), waitingThread->getName(), name);
         scheduler->ReadyToRun(waitingThread);
     }
@@ -162,7 +162,7 @@ void Condition::Broadcast(Lock* conditionLock) {
     Thread* waitingThread;
     while (!waitlist->IsEmpty())
     {
-        waitingThread = (Thread*)waitlist->Remove();
+        waitingThread = waitlist->Remove();
         scheduler->ReadyToRun(waitingThread);
     }
     (void)interrupt->SetLevel(oldLevel);
@@ -48,7 +48,7 @@ class Semaphore {
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    ThreadList *queue; // threads waiting in P() for the value to be > 0
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -136,7 +136,7 @@ class Condition {
 
   private:
     char* name;
-    List *waitlist;
+    ThreadList *waitlist;
     // plus some other stuff you'll need to define
 };
 
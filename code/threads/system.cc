@@ -7,6 +7,9 @@
 
 #include "copyright.h"
 #include "system.h"
+#ifdef NETWORK
+#include "transport.h"
+#endif
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -20,7 +23,8 @@ Timer *timer;				// the hardware timer device,
 					// for invoking context switches
 
 //----------LAB 1---------------
-Thread *allThreads[MaxThreadsNum];  // for allocating TID, if true, then this tid is used by other thread.
+ThreadTable *threadTable;		// for allocating TIDs
+StackPool *stackPool;			// stacks of finished threads
 //----------end LAB 1---------------
 
 #ifdef FILESYS_NEEDED
@@ -29,10 +33,12 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+FileHeaderCache *fileHeaderCache;	// in-memory i-node table
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+SynchConsole *synchConsole;	// the console user programs read and write
 #endif
 
 #ifdef NETWORK
@@ -99,6 +105,7 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    int numCpus = 1;		// # of simulated CPUs
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -106,6 +113,8 @@ Initialize(int argc, char **argv)
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
+    bool sharedRing = FALSE;	// carry packets through shared memory
+    int mtu = DefaultMtu;	// largest packet we send
 #endif
 
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -127,6 +136,11 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-cpus")) {
+	    ASSERT(argc > 1);
+	    numCpus = atoi(*(argv + 1));
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -141,6 +155,17 @@ Initialize(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    netname = atoi(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-net")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "shm"))
+		sharedRing = TRUE;
+	    else
+		ASSERT(!strcmp(*(argv + 1), "socket"));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mtu")) {
+	    ASSERT(argc > 1);
+	    mtu = atoi(*(argv + 1));
+	    argCount = 2;
 	}
 #endif
     }
@@ -155,8 +180,8 @@ Initialize(int argc, char **argv)
     threadToBeDestroyed = NULL;
     
     //----------LAB 1---------------
-    // Initialize ThreadArray
-    for (int i=0; i<MaxThreadsNum; ++i) allThreads[i] = NULL;
+    threadTable = new ThreadTable;
+    stackPool = new StackPool;
     //--------end LAB 1---------------
 
     // We didn't explicitly allocate the current thread we are running in.
@@ -168,11 +193,13 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, numCpus);	// this must come first
+    synchConsole = NULL;
 #endif
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
+    fileHeaderCache = new FileHeaderCache();
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -180,7 +207,8 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef NETWORK
-    postOffice = new PostOffice(netname, rely, 10);
+    postOffice = new PostOffice(netname, rely, 10,
+		sharedRing ? new ShmTransport(netname) : NULL, mtu);
 #endif
 }
 
@@ -197,6 +225,7 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete synchConsole;
     delete machine;
 #endif
 
@@ -205,6 +234,7 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete fileHeaderCache;
     delete synchDisk;
 #endif
     
@@ -214,26 +244,3 @@ Cleanup()
     
     Exit(0);
 }
-
-//----------LAB 1---------------
-int
-AllocateTID()
-{
-    for (int i=0; i<MaxThreadsNum; ++i)
-    {
-        if (allThreads[i] == NULL)
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
-void 
-DeallocateTID(int TID)
-{
-    ASSERT(allThreads[TID]);
-    allThreads[TID] = NULL;
-    //printf("deallocating %d\n", TID);
-}
-//----------end LAB 1---------------
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include "copyright.h"
 #include "utility.h"
 #include "thread.h"
+#include "threadtable.h"
+#include "stackpool.h"
 #include "scheduler.h"
 #include "interrupt.h"
 #include "stats.h"
@@ -31,16 +33,17 @@ extern Timer *timer;				// the hardware alarm clock
 
 
 //------------LAB 1---------------
-#define MaxThreadsNum 128
-extern Thread *allThreads[MaxThreadsNum];
-extern int AllocateTID();
-extern void DeallocateTID(int TID);
+extern ThreadTable *threadTable;		// every thread, by TID
+extern StackPool *stackPool;			// idle thread stacks
 //----------end LAB 1---------------
 
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "console.h"
 extern Machine* machine;	// user program memory and registers
+extern SynchConsole *synchConsole;	// user programs' console, made
+					// when one first uses it
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -50,7 +53,9 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "filehdr.h"
 extern SynchDisk   *synchDisk;
+extern FileHeaderCache *fileHeaderCache;
 #endif
 
 #ifdef NETWORK
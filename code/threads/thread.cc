@@ -32,27 +32,24 @@
 //	Thread::Fork.
 //
 //	"threadName" is an arbitrary string, useful for debugging.
+//	"prio" is its priority, 0 being the most urgent.
+//	"ticks" is the length of its time slice, in timer interrupts.
+//	"stackWords" is the size of the stack it gets when forked.
 //----------------------------------------------------------------------
 
-Thread::Thread(char* threadName, int prio, int ticks)
+Thread::Thread(char* threadName, int prio, int ticks, int stackWords)
 {
     name = threadName;
     stackTop = NULL;
     stack = NULL;
+    stackSize = stackWords;
     status = JUST_CREATED;
     UID = getuid();
-    TID = AllocateTID();
     priority = prio;
     allowedTicks = ticks;
     usedTicks = 0;
-    if (TID < 0)
-    {
-        printf("Error: threads' number exceeds limit!\n");
-        ASSERT(TID > 0);
-    }
-    else{
-        allThreads[TID] = this;
-    }
+    bonus = 0;
+    TID = threadTable->Allocate(this);
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -76,8 +73,8 @@ Thread::~Thread()
     //printf("Deleting %s\n", this->getName());
     ASSERT(this != currentThread);
     if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
-    DeallocateTID(TID);
+	stackPool->Put(stack, stackSize);	// keep it for the next Fork
+    threadTable->Free(this);
 }
 
 //----------------------------------------------------------------------
@@ -135,7 +132,7 @@ Thread::CheckOverflow()
 {
     if (stack != NULL)
 #ifdef HOST_SNAKE			// Stacks grow upward on the Snakes
-	ASSERT(stack[StackSize - 1] == STACK_FENCEPOST);
+	ASSERT(stack[stackSize - 1] == STACK_FENCEPOST);
 #else
 	ASSERT((int) *stack == (int) STACK_FENCEPOST);
 #endif
@@ -205,13 +202,10 @@ Thread::Yield ()
     //---------------Lab 2---------------
     scheduler->ReadyToRun(this);
     nextThread = scheduler->FindNextToRun();
-    if (nextThread != NULL){
-        if (nextThread == this)
-            scheduler->RemoveFirstThread();
-            // still run itself
-        else
-            scheduler->Run(nextThread);
-    }
+    if (nextThread == this)
+        status = RUNNING;	// still the most urgent, keep running
+    else
+        scheduler->Run(nextThread);
     //-------------end Lab 2---------------
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -246,6 +240,7 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
     //printf("Sleeping %s\n", getName());
     status = BLOCKED;
+    addBonus();				// it gave up the CPU by itself
     while ((nextThread = scheduler->FindNextToRun()) == NULL)
 	interrupt->Idle();	// no one to run, wait for an interrupt
 
@@ -265,7 +260,8 @@ static void InterruptEnable() { interrupt->Enable(); }
 void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 //----------------------------------------------------------------------
 // Thread::StackAllocate
-//	Allocate and initialize an execution stack.  The stack is
+//	Allocate and initialize an execution stack, recycling the stack
+//	of a finished thread if one of the right size is idle.  The stack is
 //	initialized with an initial stack frame for ThreadRoot, which:
 //		enables interrupts
 //		calls (*func)(arg)
@@ -278,19 +274,19 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    stack = stackPool->Get(stackSize);
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
     stackTop = stack + 16;	// HP requires 64-byte frame marker
-    stack[StackSize - 1] = STACK_FENCEPOST;
+    stack[stackSize - 1] = STACK_FENCEPOST;
 #else
     // i386 & MIPS & SPARC stack works from high addresses to low addresses
 #ifdef HOST_SPARC
     // SPARC stack must contains at least 1 activation record to start with.
-    stackTop = stack + StackSize - 96;
+    stackTop = stack + stackSize - 96;
 #else  // HOST_MIPS  || HOST_i386
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
 #ifdef HOST_i386
     // the 80386 passes the return address on the stack.  In order for
     // SWITCH() to go to ThreadRoot when we switch to this thread, the
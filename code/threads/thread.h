@@ -39,6 +39,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "ilist.h"
 
 #ifdef USER_PROGRAM
 #include "machine.h"
@@ -51,11 +52,16 @@
 #define MachineStateSize 18 
 
 
-// Size of the thread's private execution stack.
+// Default size of the thread's private execution stack; a thread can
+// ask for another size when it is created.
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 #define StackSize	(4 * 1024)	// in words
 
 
+// Most a thread's priority can be improved for blocking often.
+#define MaxBonus	5
+
+
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 	 
@@ -81,7 +87,8 @@ class Thread {
     int machineState[MachineStateSize];  // all registers except for stackTop
 
   public:
-    Thread(char* debugName, int prio=32, int ticks=1);		// initialize a Thread 
+    Thread(char* debugName, int prio=32, int ticks=1,
+                        int stackWords=StackSize);	// initialize a Thread 
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
@@ -112,14 +119,22 @@ class Thread {
     bool ifDue() {return usedTicks >= allowedTicks;}
     int tick() {usedTicks++;}
     void resetTicks() {usedTicks = 0;}
+    int getBonus() {return bonus;}
+    void addBonus() {if (bonus < MaxBonus) bonus++;}	// it blocked
+    void dropBonus() {if (bonus > 0) bonus--;}	// it used up its slice
     //------end Lab 2-------------
 
+    ListLink<Thread> queueLink;		// on the ready list, or waiting
+					// on a semaphore or condition
+    ListLink<Thread> liveLink;		// on the thread table's list
+
   private:
     // some of the private data for this class is listed above
     
     int* stack; 	 		// Bottom of the stack 
 					// NULL if this is the main thread
 					// (If NULL, don't deallocate stack)
+    int stackSize;			// Size of the stack, in words
     ThreadStatus status;		// ready, running or blocked
     char* name;
     //--------Lab 1-------------
@@ -130,6 +145,7 @@ class Thread {
     int priority;
     int allowedTicks;
     int usedTicks;
+    int bonus;				// interactive bonus, 0..MaxBonus
     //------end Lab 2-----------
     void StackAllocate(VoidFunctionPtr func, int arg);
     					// Allocate a stack for thread.
@@ -150,6 +166,10 @@ class Thread {
 #endif
 };
 
+// A queue of threads.  A thread is on at most one at a time.
+
+typedef IntrusiveList<Thread, &Thread::queueLink> ThreadList;
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
@@ -0,0 +1,119 @@
+// threadtable.cc
+//	Routines to hand out thread IDs and find threads by them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadtable.h"
+
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize a thread table with no threads in it.
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    size = InitialThreads;
+    table = new Thread *[size];
+    freeTids = new int[size];
+    for (int i = 0; i < size; i++)
+        table[i] = NULL;
+    used = 0;
+    numFree = 0;
+    numThreads = 0;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::~ThreadTable
+// 	De-allocate the table.  The threads still in it are not ours.
+//----------------------------------------------------------------------
+
+ThreadTable::~ThreadTable()
+{
+    while (live.Remove() != NULL)
+        ;
+    delete [] table;
+    delete [] freeTids;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Allocate
+// 	Give "thread" a TID: the one given back most recently, if any,
+//	or else the lowest one never used, growing the table if it is
+//	full.  Returns the TID.
+//----------------------------------------------------------------------
+
+int
+ThreadTable::Allocate(Thread *thread)
+{
+    int tid;
+
+    if (numFree > 0)
+        tid = freeTids[--numFree];
+    else {
+        if (used == size)
+            Grow();
+        tid = used++;
+    }
+    ASSERT(table[tid] == NULL);
+    table[tid] = thread;
+    live.Append(thread);
+    numThreads++;
+    return tid;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Free
+// 	Take "thread" out of the table, and keep its TID for reuse.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Free(Thread *thread)
+{
+    int tid = thread->getTID();
+
+    ASSERT(tid >= 0 && tid < used && table[tid] == thread);
+    table[tid] = NULL;
+    freeTids[numFree++] = tid;		// room for every slot, so no check
+    live.Remove(thread);
+    numThreads--;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Lookup
+// 	Return the thread with TID "tid", or NULL if there is none.
+//----------------------------------------------------------------------
+
+Thread *
+ThreadTable::Lookup(int tid)
+{
+    if (tid < 0 || tid >= used)
+        return NULL;
+    return table[tid];
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Grow
+// 	Double the number of slots.  Only called when every slot is in
+//	use, so the free stack is empty.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Grow()
+{
+    Thread **newTable = new Thread *[2 * size];
+
+    ASSERT(numFree == 0);
+    for (int i = 0; i < size; i++)
+        newTable[i] = table[i];
+    for (int i = size; i < 2 * size; i++)
+        newTable[i] = NULL;
+    delete [] table;
+    delete [] freeTids;
+    table = newTable;
+    freeTids = new int[2 * size];
+    size *= 2;
+    DEBUG('t', "Thread table grown to %d slots\n", size);
+}
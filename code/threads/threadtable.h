@@ -0,0 +1,52 @@
+// threadtable.h
+//	Data structures to keep track of all the threads in the system.
+//
+//	Every thread gets a thread ID (TID) when it is created, and gives
+//	it back when it is destroyed.  The table maps TIDs to threads; it
+//	grows as needed, so the number of threads is only limited by
+//	memory.  IDs that are given back go on a free stack, so allocating
+//	one takes constant time, and the live threads are kept on a list,
+//	so walking them does not visit the unused slots.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADTABLE_H
+#define THREADTABLE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define InitialThreads	128	// slots in a new thread table
+
+// The following class defines the thread table.
+
+class ThreadTable {
+  public:
+    ThreadTable();			// An empty table
+    ~ThreadTable();
+
+    int Allocate(Thread *thread);	// Give "thread" a TID
+    void Free(Thread *thread);		// Give its TID back
+    Thread *Lookup(int tid);		// The thread with "tid", or NULL
+
+    int NumThreads() { return numThreads; }
+    Thread *First() { return live.First(); }	// Walk the live threads:
+    Thread *Next(Thread *thread) { return live.Next(thread); }	// in
+					// order of creation, until NULL
+
+  private:
+    Thread **table;			// the thread with each TID
+    int size;				// # of slots in "table"
+    int used;				// slots at or above this were never
+					// handed out
+    int *freeTids;			// TIDs given back, used LIFO
+    int numFree;
+    int numThreads;			// # of live threads
+    IntrusiveList<Thread, &Thread::liveLink> live;
+
+    void Grow();			// Double the size of the table
+};
+
+#endif // THREADTABLE_H
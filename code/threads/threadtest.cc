@@ -51,30 +51,27 @@ ThreadStatus(int which)
 {
     printf(" Thread %d execute ts command.\n", which);
     printf(" PID  UID        state name\n");
-    for (int i=0; i<MaxThreadsNum; ++i)
+    for (Thread *t = threadTable->First(); t != NULL; t = threadTable->Next(t))
     {
-        if (allThreads[i] != NULL)
+        char status_string[20];
+        switch(t->getStatus())
         {
-            char status_string[20];
-            switch(allThreads[i]->getStatus())
-            {
-            case JUST_CREATED:
-                sprintf(status_string, "JUST CREATED");
-                break;
-            case RUNNING:
-                sprintf(status_string, "RUNNING");
-                break;
-            case READY:
-                sprintf(status_string, "READY");
-                break;
-            case BLOCKED:
-                sprintf(status_string, "BLOCKED");
-                break;
-            default:
-                break;
-            };
-            printf("%4d %4d %12s %s\n", allThreads[i]->getTID(), allThreads[i]->getUID(), status_string, allThreads[i]->getName());
-        }
+        case JUST_CREATED:
+            sprintf(status_string, "JUST CREATED");
+            break;
+        case RUNNING:
+            sprintf(status_string, "RUNNING");
+            break;
+        case READY:
+            sprintf(status_string, "READY");
+            break;
+        case BLOCKED:
+            sprintf(status_string, "BLOCKED");
+            break;
+        default:
+            break;
+        };
+        printf("%4d %4d %12s %s\n", t->getTID(), t->getUID(), status_string, t->getName());
     }
 }
 
@@ -445,6 +442,174 @@ ThreadTest9()
     w2->Fork(writer, 4);
 }
 //------------end Lab 3------------
+
+//----------------------------------------------------------------------
+// ThreadTest10
+// 	Time the pending interrupt queue.  BenchPending fake device
+//	interrupts are kept outstanding; each one, when it fires,
+//	schedules another one up to BenchPending ticks ahead, until
+//	BenchEvents have been scheduled.  Simulated time is advanced by
+//	turning interrupts off and on, as kernel code does.
+//----------------------------------------------------------------------
+
+#define BenchPending	64
+#define BenchEvents	(2 * 1000 * 1000)
+
+static int benchScheduled, benchFired;
+
+static void
+BenchInterrupt(int which)
+{
+    benchFired++;
+    if (benchScheduled < BenchEvents) {
+        benchScheduled++;
+        interrupt->Schedule(BenchInterrupt, which, 
+                                1 + Random() % BenchPending, DiskInt);
+    }
+}
+
+void
+ThreadTest10()
+{
+    int ticks = stats->totalTicks;
+    double start, elapsed;
+
+    benchScheduled = benchFired = 0;
+    for (int i = 0; i < BenchPending; i++) {
+        benchScheduled++;
+        interrupt->Schedule(BenchInterrupt, i, 
+                                1 + Random() % BenchPending, DiskInt);
+    }
+    start = WallClock();
+    while (benchFired < BenchEvents) {
+        (void) interrupt->SetLevel(IntOff);
+        (void) interrupt->SetLevel(IntOn);
+    }
+    elapsed = WallClock() - start;
+    printf("%d interrupts in %d ticks: %.3f seconds, %.0f interrupts/second\n",
+            benchFired, stats->totalTicks - ticks, elapsed, 
+            benchFired / elapsed);
+}
+
+//----------------------------------------------------------------------
+// ThreadTest11
+// 	Time semaphore ping-pong.  Two threads take turns, each V'ing
+//	the other's semaphore and P'ing its own, so every round trip is
+//	two sleeps, two wakeups and two context switches -- and, before
+//	the wait and ready queues became intrusive, four allocations.
+//----------------------------------------------------------------------
+
+#define PingPongRounds	(200 * 1000)
+
+static Semaphore *pingSem, *pongSem;
+
+static void
+Ponger(int rounds)
+{
+    for (int i = 0; i < rounds; i++) {
+        pongSem->P();
+        pingSem->V();
+    }
+}
+
+void
+ThreadTest11()
+{
+    Thread *t = new Thread("ponger");
+    double start, elapsed;
+
+    pingSem = new Semaphore("ping", 0);
+    pongSem = new Semaphore("pong", 0);
+    t->Fork(Ponger, PingPongRounds);
+    currentThread->Yield();		// let the ponger wait on its semaphore
+    start = WallClock();
+    for (int i = 0; i < PingPongRounds; i++) {
+        pongSem->V();
+        pingSem->P();
+    }
+    elapsed = WallClock() - start;
+    printf("%d ping-pong rounds: %.3f seconds, %.0f rounds/second\n",
+            PingPongRounds, elapsed, PingPongRounds / elapsed);
+    delete pingSem;
+    delete pongSem;
+}
+
+//----------------------------------------------------------------------
+// ThreadTest12
+// 	Time the scheduler as the number of ready threads grows.  For
+//	each size, that many threads of random priority are made ready,
+//	and then one is repeatedly taken off the ready list and put back,
+//	as a context switch would.  The cost per switch should not depend
+//	on the number of threads.
+//----------------------------------------------------------------------
+
+#define SchedSwitches	(1000 * 1000)
+#define SchedMaxThreads	4096
+
+void
+ThreadTest12()
+{
+    Thread *t;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (int n = 2; n <= SchedMaxThreads; n *= 2) {
+        double start, elapsed;
+
+        for (int i = 0; i < n; i++) {
+            t = new Thread("sched bench", Random() % NumPriorities);
+            scheduler->ReadyToRun(t);
+        }
+        start = WallClock();
+        for (int i = 0; i < SchedSwitches; i++) {
+            t = scheduler->FindNextToRun();
+            scheduler->ReadyToRun(t);
+        }
+        elapsed = WallClock() - start;
+        printf("%4d ready threads: %.0f switches/second\n",
+                n, SchedSwitches / elapsed);
+        for (int i = 0; i < n; i++)
+            delete scheduler->FindNextToRun();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ThreadTest13
+// 	Time thread creation and destruction.  Short-lived threads are
+//	forked and finished one after the other, with the default stack
+//	size and with a larger one; after the first of each size, their
+//	stacks should all come from the stack pool.
+//----------------------------------------------------------------------
+
+#define ForkRounds	(100 * 1000)
+
+static void
+ShortLived(int which)
+{
+}
+
+void
+ThreadTest13()
+{
+    int sizes[2] = { StackSize, 4 * StackSize };
+
+    for (int s = 0; s < 2; s++) {
+        int allocated = stackPool->NumAllocated();
+        double start, elapsed;
+
+        start = WallClock();
+        for (int i = 0; i < ForkRounds; i++) {
+            Thread *t = new Thread("short lived", 32, 1, sizes[s]);
+            t->Fork(ShortLived, i);	// runs and finishes in our Yield
+        }
+        currentThread->Yield();		// let the last one be destroyed
+        elapsed = WallClock() - start;
+        printf("%d threads of %d words: %.0f threads/second, %d stacks allocated\n",
+                ForkRounds, sizes[s], ForkRounds / elapsed,
+                stackPool->NumAllocated() - allocated);
+    }
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -482,6 +647,19 @@ ThreadTest()
     break;
     case 9:
     ThreadTest9();
+    break;
+    case 10:
+    ThreadTest10();     // interrupt queue benchmark
+    break;
+    case 11:
+    ThreadTest11();     // semaphore ping-pong benchmark
+    break;
+    case 12:
+    ThreadTest12();     // scheduler scalability benchmark
+    break;
+    case 13:
+    ThreadTest13();     // thread create/destroy benchmark
+    break;
     default:
 	printf("No test specified.\n");
 	break;
@@ -18,7 +18,10 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
+#include "asyncio.h"
+#include "pipe.h"
 #include "noff.h"
+#include "syscall.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -64,6 +67,16 @@ AddrSpace::AddrSpace(char *name)
 {
     NoffHeader noffH;
     unsigned int i, size;
+    for (i = 0; i < MaxOpenFiles; i++) {
+	openFiles[i] = NULL;
+	pipes[i] = NULL;
+    }
+    for (i = 0; i < MaxMappings; i++)
+	mappings[i].file = NULL;
+    asyncIo = NULL;
+    numPages = programPages = 0;
+    pageTable = NULL;
+    swapfilename[0] = '\0';
     OpenFile *executable = fileSystem->Open(name); 
     if (executable == NULL) {
     printf("Unable to open file %s\n", name);
@@ -113,6 +126,7 @@ AddrSpace::AddrSpace(char *name)
             + UserStackSize;    // we need to increase the size
                         // to leave room for the stack
     numPages = divRoundUp(size, PageSize);
+    programPages = numPages;
     size = numPages * PageSize;
 
     allocatedPages = 0;
@@ -217,12 +231,40 @@ AddrSpace::AddrSpace(char *name)
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, writing back the files it has mapped,
+//	closing the files and pipe ends it has open, and freeing its
+//	frames and swap file.  No TLB may think it still holds our
+//	translations.
+//
+//	The space must be running, as for DropMapping.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+   if (asyncIo != NULL) {
+	asyncIo->Cancel();	// its threads use our files
+	delete asyncIo;
+	asyncIo = NULL;
+   }
+   for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL)
+	    DropMapping(&mappings[i]);
+   for (int i = 0; i < MaxOpenFiles; i++)
+	CloseFile(i);
+   for (unsigned int vpn = 0; vpn < numPages; vpn++) {
+	TranslationEntry *entry = Entry(vpn);
+
+	if (entry != NULL) {
+	    entry->valid = FALSE;
+	    machine->DeallocPhyPage(entry->physicalPage);
+	}
+   }
+   if (swapfilename[0] != '\0')
+	fileSystem->Remove(swapfilename);
+   machine->ForgetTlbOwner(this);
+#ifndef REVERSE
+   delete [] pageTable;
+#endif			// else it is the machine's
 }
 
 //----------------------------------------------------------------------
@@ -262,20 +304,25 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	The TLB is left as it is, in case we run on this CPU again before
+//	anyone else does; RestoreState empties it if someone else does.
+//	So that no write is lost when that happens, the TLB's dirty bits
+//	are folded into our page table now, while the TLB is still ours.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
 {
-    //------- Lab 4------
-    // disable TLB, because they are all of no use now.
-#ifdef USE_TLB
-    for (int i=0; i<TLBSize; ++i){
-        machine->tlb[i].valid = FALSE;
-    }
-#endif
-    // do not need to do: pageTable = machine->pageTable
-    //------- end Lab 4----
+    TranslationEntry *entry;
+
+    if (machine->tlb == NULL)
+	return;
+    for (int i = 0; i < TLBSize; i++)
+	if (machine->tlb[i].valid && machine->tlb[i].dirty) {
+	    entry = InMemory(machine->tlb[i].virtualPage);
+	    if (entry != NULL)
+		entry->dirty = TRUE;
+	    machine->tlb[i].dirty = FALSE;
+	}
 }
 
 //----------------------------------------------------------------------
@@ -283,7 +330,8 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	empty the TLB if it holds another address space's translations.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
@@ -292,4 +340,496 @@ void AddrSpace::RestoreState()
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
 #endif
+    machine->ClaimTlb(this);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddFile, AddrSpace::GetFile, AddrSpace::CloseFile
+// 	Keep track of the files the program has open.  An OpenFileId is
+//	an index into "openFiles", or "pipes" for a pipe end;
+//	ConsoleInput and ConsoleOutput are never in either.  Closing a
+//	file unmaps it, after waiting for any asynchronous I/O on it.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FreeId()
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if (openFiles[id] == NULL && pipes[id] == NULL)
+	    return id;
+    return -1;
+}
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    int id = FreeId();
+
+    if (id >= 0)
+	openFiles[id] = file;
+    return id;
+}
+
+OpenFile *
+AddrSpace::GetFile(int id)
+{
+    if (id < 0 || id >= MaxOpenFiles)
+	return NULL;
+    return openFiles[id];
+}
+
+bool
+AddrSpace::CloseFile(int id)
+{
+    OpenFile *file = GetFile(id);
+    bool writing;
+    KernelPipe *pipe = GetPipe(id, &writing);
+
+    if (pipe != NULL) {
+	pipes[id] = NULL;
+	pipe->Close(writing);
+	return TRUE;
+    }
+    if (file == NULL)
+	return FALSE;
+    if (asyncIo != NULL)
+	asyncIo->WaitFile(id);
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file == file)
+	    DropMapping(&mappings[i]);
+    delete file;
+    openFiles[id] = NULL;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddPipe, AddrSpace::GetPipe
+// 	Keep track of the pipe ends the program has open; they share
+//	OpenFileIds with its files.
+//
+//	"writing" -- the write end, else the read end
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddPipe(KernelPipe *pipe, bool writing)
+{
+    int id = FreeId();
+
+    if (id >= 0) {
+	pipes[id] = pipe;
+	pipeWriting[id] = writing;
+	pipe->Open(writing);
+    }
+    return id;
+}
+
+KernelPipe *
+AddrSpace::GetPipe(int id, bool *writing)
+{
+    if (id < 0 || id >= MaxOpenFiles || pipes[id] == NULL)
+	return NULL;
+    *writing = pipeWriting[id];
+    return pipes[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Resident
+// 	Translate a virtual address of this address space, which must
+//	be running, as the hardware would.  If its page is not in the
+//	TLB or not in memory, handle the fault as the hardware would have
+//	us, and try again.
+//
+//	Returns FALSE if the address is outside the address space.
+//
+//	"virtAddr" -- the address
+//	"writing" -- we are about to write there
+//	"physAddr" -- where to put the physical address
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Resident(int virtAddr, bool writing, int *physAddr)
+{
+    if (virtAddr < 0 || !InSpace(virtAddr / PageSize))
+	return FALSE;
+    for (int tries = 0; tries < 3; tries++) {	// TLB miss, page fault,
+						// then TLB miss again
+	ExceptionType exception = machine->Translate(virtAddr, physAddr,
+							1, writing);
+	if (exception == NoException)
+	    return TRUE;
+	if (exception != PageFaultException)
+	    return FALSE;
+	machine->WriteRegister(BadVAddrReg, virtAddr);
+	ExceptionHandler(PageFaultException);
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn, AddrSpace::CopyOut
+// 	Copy bytes from or to user memory.  Each page is translated once,
+//	and the part of it we want is copied all at once, rather than a
+//	byte at a time through ReadMem or WriteMem.
+//
+//	"from", "into" -- the source and destination; the user one is a
+//		virtual address
+//	"numBytes" -- how many bytes to copy
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyIn(int from, char *into, int numBytes)
+{
+    int physAddr, n;
+
+    while (numBytes > 0) {
+	if (!Resident(from, FALSE, &physAddr))
+	    return FALSE;
+	n = min(numBytes, PageSize - from % PageSize);
+	bcopy(&machine->mainMemory[physAddr], into, n);
+	from += n;
+	into += n;
+	numBytes -= n;
+    }
+    return TRUE;
+}
+
+bool
+AddrSpace::CopyOut(char *from, int into, int numBytes)
+{
+    int physAddr, n;
+
+    while (numBytes > 0) {
+	if (!Resident(into, TRUE, &physAddr))
+	    return FALSE;
+	n = min(numBytes, PageSize - into % PageSize);
+	bcopy(from, &machine->mainMemory[physAddr], n);
+	from += n;
+	into += n;
+	numBytes -= n;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyInString
+// 	Copy a null-terminated string in from user memory, a page at a
+//	time, as for CopyIn.
+//
+//	Returns the length of the string, or -1 if it runs off the
+//	address space or does not fit in "maxBytes" with its null.
+//
+//	"from" -- the string's virtual address
+//	"into" -- where to put it
+//	"maxBytes" -- the room there
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CopyInString(int from, char *into, int maxBytes)
+{
+    int physAddr, n, length = 0;
+    char *end;
+
+    while (length < maxBytes) {
+	if (!Resident(from, FALSE, &physAddr))
+	    return -1;
+	n = min(maxBytes - length, PageSize - from % PageSize);
+	end = (char *) memchr(&machine->mainMemory[physAddr], '\0', n);
+	if (end != NULL)
+	    n = end - &machine->mainMemory[physAddr] + 1;
+	bcopy(&machine->mainMemory[physAddr], into + length, n);
+	length += n;
+	if (end != NULL)
+	    return length - 1;
+	from += n;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Map
+// 	Map an open file into the address space, after the program's own
+//	pages, in the first range no other mapping has; a range that was
+//	unmapped is reused.  The pages start out invalid; they are read in
+//	from the file as the program touches them (see PageIn).
+//
+//	At most the file's length is mapped, so every page written back
+//	starts inside the file.
+//
+//	Returns the virtual address of the mapping, or 0 if the file is
+//	not open or empty, too many are mapped, or the mapping would
+//	reach MaxVirtPages.
+//
+//	"id" -- the OpenFileId of the file
+//	"length" -- how many bytes of it to map
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Map(int id, int length)
+{
+    OpenFile *file = GetFile(id);
+    Mapping *m = NULL;
+
+    if (file == NULL)
+	return 0;
+    length = min(length, file->Length());
+    if (length <= 0)
+	return 0;
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file == NULL) {
+	    m = &mappings[i];
+	    break;
+	}
+    if (m == NULL)
+	return 0;
+
+    m->numPages = divRoundUp(length, PageSize);
+    m->length = length;
+    m->firstPage = programPages;
+    for (bool moved = TRUE; moved; ) {		// first fit
+	moved = FALSE;
+	for (int i = 0; i < MaxMappings; i++) {
+	    Mapping *other = &mappings[i];
+
+	    if (other->file != NULL
+		    && m->firstPage < other->firstPage + other->numPages
+		    && other->firstPage < m->firstPage + m->numPages) {
+		m->firstPage = other->firstPage + other->numPages;
+		moved = TRUE;
+	    }
+	}
+    }
+    unsigned int end = m->firstPage + m->numPages;
+    if (end > MaxVirtPages)
+	return 0;
+    m->file = file;
+    if (end > numPages) {
+#ifndef REVERSE
+	TranslationEntry *table = new TranslationEntry[end];
+	for (unsigned int i = 0; i < numPages; i++)
+	    table[i] = pageTable[i];
+	for (unsigned int i = numPages; i < end; i++) {
+	    table[i].virtualPage = i;
+	    table[i].valid = FALSE;
+	}
+	delete [] pageTable;
+	pageTable = table;
+	machine->pageTable = pageTable;		// we are running
+	machine->pageTableSize = end;
+#endif
+	numPages = end;
+    }
+    DEBUG('a', "Mapped %d bytes of file %d at 0x%x\n", length, id,
+					m->firstPage * PageSize);
+    return m->firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Unmap the mapping that starts at "addr", writing back the pages
+//	that were written to.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Unmap(int addr)
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL
+		&& mappings[i].firstPage * PageSize == addr) {
+	    DropMapping(&mappings[i]);
+	    return TRUE;
+	}
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindMapping
+// 	Return the mapping virtual page "vpn" is in, if any.
+//----------------------------------------------------------------------
+
+Mapping *
+AddrSpace::FindMapping(int vpn)
+{
+    for (int i = 0; i < MaxMappings; i++) {
+	Mapping *m = &mappings[i];
+
+	if (m->file != NULL && m->firstPage <= vpn
+		&& vpn < m->firstPage + m->numPages)
+	    return m;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InSpace
+// 	Is virtual page "vpn" part of the address space: one of the
+//	program's own pages, or a mapped one?  Pages of a range that was
+//	unmapped, and not mapped again, are not.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::InSpace(int vpn)
+{
+    if (vpn < 0 || (unsigned) vpn >= numPages)
+	return FALSE;
+    return (unsigned) vpn < programPages || FindMapping(vpn) != NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DropMapping
+// 	Write back the pages of a mapping that are in memory and dirty,
+//	and free their frames.  The space must be running, so that the
+//	TLB holds its translations, and so that, with a reverse page
+//	table, its frames are those of the current thread.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::DropMapping(Mapping *m)
+{
+    TranslationEntry *entry;
+
+    for (int vpn = m->firstPage; vpn < m->firstPage + m->numPages; vpn++) {
+	entry = Entry(vpn);
+	if (entry == NULL)
+	    continue;
+	if (entry->dirty)
+	    PageOut(vpn, &machine->mainMemory[entry->physicalPage * PageSize]);
+	entry->valid = FALSE;
+	machine->DeallocPhyPage(entry->physicalPage);
+	allocatedPages--;
+    }
+    m->file = NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InMemory
+// 	Find the page table entry of a page that is in memory.  The space
+//	must be running, so that, with a reverse page table, its frames
+//	are those of the current thread.
+//
+//	Returns NULL if the page is not in memory.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::InMemory(int vpn)
+{
+#ifndef REVERSE
+    if (pageTable[vpn].valid)
+	return &pageTable[vpn];
+#else
+    for (int i = 0; i < NumPhysPages; i++)
+	if (machine->pageTable[i].valid
+		&& machine->pageTable[i].tid == currentThread->getTID()
+		&& machine->pageTable[i].virtualPage == vpn)
+	    return &machine->pageTable[i];
+#endif
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Entry
+// 	Find the page table entry of a page that is in memory, and take
+//	the page out of the TLB, keeping its dirty bit, so the entry can
+//	be changed.  The space must be running, as for DropMapping.
+//
+//	Returns NULL if the page is not in memory.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::Entry(int vpn)
+{
+    TranslationEntry *entry = InMemory(vpn);
+
+    if (entry != NULL && machine->tlb != NULL)
+	for (int i = 0; i < TLBSize; i++)
+	    if (machine->tlb[i].valid && machine->tlb[i].virtualPage == vpn) {
+		if (machine->tlb[i].dirty)
+		    entry->dirty = TRUE;
+		machine->tlb[i].valid = FALSE;
+	    }
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GiveFrame
+// 	Put a frame someone gave us, say a pipe, in place of a page, and
+//	free the frame that held the page, if any.  The page is marked
+//	dirty, since swap does not hold its contents.  The space must be
+//	running.
+//
+//	Returns FALSE, and leaves the frame to the caller, if "vpn" is bad
+//	or mapped to a file, or if it is not in memory and we already
+//	have all the frames we may.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::GiveFrame(int vpn, int frame)
+{
+    TranslationEntry *entry;
+
+    if (!InSpace(vpn) || FindMapping(vpn) != NULL)
+	return FALSE;
+    entry = Entry(vpn);
+    if (entry != NULL) {
+	entry->valid = FALSE;
+	machine->DeallocPhyPage(entry->physicalPage);
+    } else if (allocatedPages >= maxPhyPages)
+	return FALSE;
+    else
+	allocatedPages++;
+
+#ifndef REVERSE
+    entry = &pageTable[vpn];
+#else
+    entry = &machine->pageTable[frame];
+    entry->tid = currentThread->getTID();
+#endif
+    entry->virtualPage = vpn;
+    entry->physicalPage = frame;
+    entry->valid = TRUE;
+    entry->use = FALSE;
+    entry->dirty = TRUE;
+    entry->readOnly = FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn, AddrSpace::PageOut
+// 	Move a page of a mapping between its frame and the file, straight
+//	from or to "mainMemory".  Only the part of the page inside the
+//	mapping's length is read or written; the rest reads as zeroes.
+//
+//	Return FALSE if "vpn" is not mapped, so the page belongs in swap.
+//
+//	"vpn" -- the virtual page
+//	"into", "from" -- its frame
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageIn(int vpn, char *into)
+{
+    Mapping *m = FindMapping(vpn);
+    int offset, n;
+
+    if (m == NULL)
+	return FALSE;
+    offset = (vpn - m->firstPage) * PageSize;
+    n = m->file->ReadAt(into, min(PageSize, m->length - offset), offset);
+    bzero(into + max(n, 0), PageSize - max(n, 0));
+    return TRUE;
+}
+
+bool
+AddrSpace::PageOut(int vpn, char *from)
+{
+    Mapping *m = FindMapping(vpn);
+    int offset, n;
+
+    if (m == NULL)
+	return FALSE;
+    offset = (vpn - m->firstPage) * PageSize;
+    n = min(PageSize, m->length - offset);
+    DEBUG('a', "Writing back page %d to its file at %d\n", vpn, offset);
+    if (m->file->WriteAt(from, n, offset) != n)
+	printf("Could not write back page %d to its mapped file\n", vpn);
+    return TRUE;
 }
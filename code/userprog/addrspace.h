@@ -17,6 +17,25 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// files a program can have open,
+					// counting the console's two ids
+#define MaxMappings		4	// files a program can have mapped
+#define MaxVirtPages		4096	// no mapping may reach this page
+
+class AsyncIo;
+class KernelPipe;
+
+// The following class defines an open file mapped into an address
+// space.  Its pages come after the rest of the address space; they
+// are read from the file when touched, and written back to it.
+
+class Mapping {
+  public:
+    OpenFile *file;			// NULL if the slot is free
+    int firstPage;			// virtual page the mapping starts at
+    int numPages;
+    int length;				// bytes of the file mapped
+};
 
 class AddrSpace {
   public:
@@ -35,11 +54,68 @@ class AddrSpace {
     void pageNumIncrease(){allocatedPages ++;}
     // ------end lab 4-----
     char swapfilename[50]; //filename, simulate the file on disk
+
+    int AddFile(OpenFile *file);	// Give "file" an OpenFileId; -1 if
+					// too many are open
+    OpenFile *GetFile(int id);		// NULL if "id" is not open
+    bool CloseFile(int id);		// FALSE if "id" is not open;
+					// closes pipe ends too
+    int AddPipe(KernelPipe *pipe, bool writing);
+					// Give an end of "pipe" an
+					// OpenFileId; -1 if too many are open
+    KernelPipe *GetPipe(int id, bool *writing);
+					// NULL if "id" is not a pipe end
+
+    bool CopyIn(int from, char *into, int numBytes);
+    bool CopyOut(char *from, int into, int numBytes);
+					// Move bytes between the kernel and
+					// this address space, which must be
+					// running, a page at a time; FALSE
+					// if an address is bad
+    int CopyInString(int from, char *into, int maxBytes);
+					// Copy in a null-terminated string;
+					// return its length, -1 if bad or
+					// too long
+    AsyncIo *asyncIo;			// NULL until the program calls
+					// AioSetup
+
+    int Map(int id, int length);	// Map the first "length" bytes of
+					// open file "id"; return the address,
+					// 0 if we cannot
+    bool Unmap(int addr);		// Write back and drop the mapping
+					// at "addr"; FALSE if there is none
+    bool InSpace(int vpn);		// Is page "vpn" in the address
+					// space?  Unmapped ones are not
+    bool PageIn(int vpn, char *into);	// If "vpn" is mapped, read its page
+    bool PageOut(int vpn, char *from);	// from the file, or write it back;
+					// FALSE if it is not mapped
+
+    bool GiveFrame(int vpn, int frame);	// Put "frame" in place of page
+					// "vpn"; FALSE if we cannot
+
   private:
+    OpenFile *openFiles[MaxOpenFiles];	// by OpenFileId; the first two
+					// are the console's, and NULL
+    KernelPipe *pipes[MaxOpenFiles];	// likewise, for pipe ends
+    bool pipeWriting[MaxOpenFiles];	//   and which end each is
+    int FreeId();			// An unused OpenFileId, or -1
+    bool Resident(int virtAddr, bool writing, int *physAddr);
+					// Translate "virtAddr", faulting
+					// its page in if need be
+    Mapping mappings[MaxMappings];
+    Mapping *FindMapping(int vpn);	// NULL if "vpn" is not mapped
+    void DropMapping(Mapping *m);	// Write back and free its pages
+    TranslationEntry *InMemory(int vpn);	// The entry for "vpn", if it
+					// is in memory
+    TranslationEntry *Entry(int vpn);	// The entry for "vpn", if it is
+					// in memory, with the TLB's dirty
+					// bit folded in; out of the TLB
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    unsigned int programPages;		// Those before the mappings: code,
+					// data and stack
 };
 
 #endif // ADDRSPACE_H
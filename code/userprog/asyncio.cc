@@ -0,0 +1,319 @@
+// asyncio.cc 
+//	Routines to carry out a user program's asynchronous I/O.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "asyncio.h"
+#include <stddef.h>
+
+// Dummy function because C++ can't indirectly invoke member functions
+static void AioWorker(int arg)
+{ AioOp *op = (AioOp *) arg; op->owner->Run(op); }
+
+//----------------------------------------------------------------------
+// AsyncIo::AsyncIo
+// 	Set up asynchronous I/O for an address space.
+//
+//	"aSpace" -- the address space; it must be running whenever we
+//		are called, except for Run
+//	"ringAddr" -- where its AioRing is
+//----------------------------------------------------------------------
+
+AsyncIo::AsyncIo(AddrSpace *aSpace, int ringAddr)
+{
+    space = aSpace;
+    ring = ringAddr;
+    outstanding = running = 0;
+    cancelled = FALSE;
+    for (int i = 0; i < MaxOpenFiles; i++)
+	busy[i] = 0;
+    lock = new Lock("aio lock");
+    done = new IntrusiveList<AioOp, &AioOp::link>;
+    completed = new Condition("aio completed");
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::~AsyncIo
+// 	Throw away the requests that are done and not posted.  None may
+//	still be under way.
+//----------------------------------------------------------------------
+
+AsyncIo::~AsyncIo()
+{
+    AioOp *op;
+
+    ASSERT(running == 0);
+    while ((op = done->Remove()) != NULL) {
+	delete [] op->data;
+	delete op;
+	outstanding--;
+    }
+    ASSERT(outstanding == 0);
+    delete lock;
+    delete done;
+    delete completed;
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::GetInt, AsyncIo::PutInt
+// 	Read or write a field of the program's AioRing.
+//
+//	"field" -- its offset in the AioRing
+//	"value" -- what to write there
+//----------------------------------------------------------------------
+
+int
+AsyncIo::GetInt(int field)
+{
+    int value = 0;
+
+    (void) space->CopyIn(ring + field, (char *)&value, sizeof(int));
+    return WordToHost(value);
+}
+
+void
+AsyncIo::PutInt(int field, int value)
+{
+    value = WordToMachine(value);
+    (void) space->CopyOut((char *)&value, ring + field, sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::Submit
+// 	Take requests out of the submission ring, until it is empty or
+//	AioMaxPending are outstanding, and start a thread for each.  The
+//	data to write is copied in now, so the thread need not touch
+//	user memory.  A bad request is done at once, with a result of -1;
+//	so is a read or write at a negative offset, or of more than
+//	AioMaxLength bytes, which would take too big a kernel buffer.
+//
+//	Returns how many requests were taken.  Completions are posted
+//	too, to make room.
+//----------------------------------------------------------------------
+
+int
+AsyncIo::Submit()
+{
+    int size = GetInt(offsetof(AioRing, size));
+    int head = GetInt(offsetof(AioRing, submitHead));
+    int tail = GetInt(offsetof(AioRing, submitTail));
+    int requests = GetInt(offsetof(AioRing, requests));
+    int taken = 0;
+    AioOp *op;
+    int room;			// size of the kernel's buffer
+    bool bad;
+
+    if (size <= 0)
+	return -1;
+    (void) Post();
+    for (; head != tail && outstanding < AioMaxPending; head++, taken++) {
+	op = new AioOp;
+	op->owner = this;
+	op->data = NULL;
+	bad = !space->CopyIn(requests + (head % size) * sizeof(AioRequest),
+				(char *)&op->request, sizeof(AioRequest));
+	for (int i = 0; i < (int)(sizeof(AioRequest) / sizeof(int)); i++)
+	    ((int *)&op->request)[i] = WordToHost(((int *)&op->request)[i]);
+
+	AioRequest *req = &op->request;
+	room = req->length;
+	if (bad || req->length < 0)
+	    bad = TRUE;
+	else if (req->op == AioRead || req->op == AioWrite) {
+	    op->file = space->GetFile(req->id);
+	    bad = (op->file == NULL || req->length > AioMaxLength
+			|| req->offset < 0);
+	} else if (req->op == AioReceive) {
+#ifdef NETWORK
+	    bad = (req->id < 0 || req->id >= postOffice->NumBoxes());
+	    req->length = min(req->length, MaxMailSize);
+	    room = MaxMailSize;		// the message may be longer
+#else
+	    bad = TRUE;			// no network
+#endif
+	} else
+	    bad = TRUE;
+	if (!bad) {
+	    op->data = new char[room];
+	    if (req->op == AioWrite)
+		bad = !space->CopyIn(req->buffer, op->data, req->length);
+	}
+
+	outstanding++;
+	if (bad) {
+	    DEBUG('a', "Bad asynchronous request, tag %d\n", req->tag);
+	    op->result = -1;
+	    lock->Acquire();
+	    done->Append(op);
+	    lock->Release();
+	} else {
+	    lock->Acquire();
+	    running++;
+	    if (req->op != AioReceive)
+		busy[req->id]++;
+	    lock->Release();
+	    (new Thread("async io"))->Fork(AioWorker, (int) op);
+	}
+    }
+    PutInt(offsetof(AioRing, submitHead), head);
+    return taken;
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::Run
+// 	Do the I/O for a request, on a thread of its own, then queue it
+//	to be posted.  A receive waits for mail AioCancelTicks at a time,
+//	and gives up, with a result of -1, once it has been cancelled.
+//
+//	Once the request is queued, its thread is done with us and with
+//	the file: we may be deleted, or the file closed.
+//----------------------------------------------------------------------
+
+void
+AsyncIo::Run(AioOp *op)
+{
+    AioRequest *req = &op->request;
+
+    switch (req->op) {
+      case AioRead:
+	op->result = op->file->ReadAt(op->data, req->length, req->offset);
+	break;
+      case AioWrite:
+	op->result = op->file->WriteAt(op->data, req->length, req->offset);
+	break;
+#ifdef NETWORK
+      case AioReceive: {
+	PacketHeader pktHdr;
+	MailHeader mailHdr;
+
+	while (!cancelled
+		&& postOffice->WaitAny(&req->id, 1, AioCancelTicks) < 0)
+	    ;
+	if (cancelled) {
+	    op->result = -1;
+	    break;
+	}
+	postOffice->Receive(req->id, &pktHdr, &mailHdr, op->data);
+	op->result = min(req->length, (int) mailHdr.length);
+	break;
+      }
+#endif
+      default:
+	ASSERT(FALSE);
+    }
+    DEBUG('a', "Asynchronous request %d done: %d\n", req->tag, op->result);
+
+    lock->Acquire();
+    done->Append(op);
+    running--;
+    if (req->op != AioReceive)
+	busy[req->id]--;
+    completed->Broadcast(lock);		// Wait, WaitFile and Cancel
+    lock->Release();			// all wait for this
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::WaitFile
+// 	Wait until no read or write of a file is under way, so that it
+//	can be closed.
+//
+//	"id" -- the file's OpenFileId
+//----------------------------------------------------------------------
+
+void
+AsyncIo::WaitFile(int id)
+{
+    ASSERT(id >= 0 && id < MaxOpenFiles);
+    lock->Acquire();
+    while (busy[id] > 0)
+	completed->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::Cancel
+// 	Cancel the receives under way, and wait until every request has
+//	finished, so that we can be deleted.  Called when the address
+//	space goes away; reads and writes are let finish.
+//----------------------------------------------------------------------
+
+void
+AsyncIo::Cancel()
+{
+    cancelled = TRUE;
+    lock->Acquire();
+    while (running > 0)
+	completed->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::Post
+// 	Post the requests that are done to the completion ring, as many
+//	as fit, copying in the data that reads and receives brought in.
+//
+//	Returns how many completions are in the ring.
+//----------------------------------------------------------------------
+
+int
+AsyncIo::Post()
+{
+    int size = GetInt(offsetof(AioRing, size));
+    int head = GetInt(offsetof(AioRing, completeHead));
+    int tail = GetInt(offsetof(AioRing, completeTail));
+    int completions = GetInt(offsetof(AioRing, completions));
+    AioCompletion c;
+    AioOp *op;
+
+    if (size <= 0)
+	return 0;
+    while (tail - head < size) {
+	lock->Acquire();
+	op = done->Remove();
+	lock->Release();
+	if (op == NULL)
+	    break;
+
+	if (op->request.op != AioWrite && op->result > 0
+		&& !space->CopyOut(op->data, op->request.buffer, op->result))
+	    op->result = -1;
+	c.tag = WordToMachine(op->request.tag);
+	c.result = WordToMachine(op->result);
+	(void) space->CopyOut((char *)&c,
+		completions + (tail % size) * sizeof(AioCompletion),
+		sizeof(AioCompletion));
+	tail++;
+	outstanding--;
+	delete [] op->data;
+	delete op;
+    }
+    PutInt(offsetof(AioRing, completeTail), tail);
+    return tail - head;
+}
+
+//----------------------------------------------------------------------
+// AsyncIo::Wait
+// 	Post what is done.  If that leaves the completion ring empty,
+//	and requests are under way, wait for one to finish.
+//
+//	Returns how many completions are in the ring; 0 only if nothing
+//	is under way.
+//----------------------------------------------------------------------
+
+int
+AsyncIo::Wait()
+{
+    int ready;
+
+    while ((ready = Post()) == 0 && outstanding > 0) {
+	lock->Acquire();
+	while (done->IsEmpty())
+	    completed->Wait(lock);
+	lock->Release();
+    }
+    return ready;
+}
@@ -0,0 +1,96 @@
+// asyncio.h 
+//	Data structures for a user program's asynchronous I/O.
+//
+//	A program describes its I/O in rings in its own memory (see
+//	AioRing in syscall.h).  On AioSubmit, the kernel takes the
+//	requests out of the ring, and starts a kernel thread for each,
+//	which does the I/O into a kernel buffer -- blocking on the disk,
+//	or waiting for a message, as it must -- and queues the request
+//	as done.  The program's own thread posts the completions to the
+//	completion ring, and copies in the data, the next time it calls
+//	AioSubmit or AioWait: only a thread running in the address space
+//	can get at its memory.
+//
+//	Closing a file waits for the reads and writes of it that are under
+//	way.  When the address space goes away, it waits for all of them,
+//	and cancels the receives, which might otherwise wait forever.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include "copyright.h"
+#include "syscall.h"
+#include "filesys.h"
+#include "synch.h"
+#include "ilist.h"
+#include "addrspace.h"
+
+#define AioMaxPending	32	// most requests a program has under way,
+				// or done but not posted
+#define AioCancelTicks	(10 * NetworkTime)
+				// how often a receive checks whether it
+				// has been cancelled
+
+class AsyncIo;
+
+// The following class defines a request taken out of the ring.
+
+class AioOp {
+  public:
+    AioRequest request;		// as the program gave it, in host order
+    OpenFile *file;		// Read, Write: the file
+    char *data;			// the kernel's copy of the data
+    int result;			// what to post
+    AsyncIo *owner;
+    ListLink<AioOp> link;	// on the queue of those done
+};
+
+// The following class defines an address space's asynchronous I/O.
+
+class AsyncIo {
+  public:
+    AsyncIo(AddrSpace *aSpace, int ringAddr);
+				// Use the AioRing at "ringAddr" in
+				// "aSpace"
+    ~AsyncIo();			// None may still be under way: see Cancel
+
+    int Submit();		// Start the requests in the ring; return
+				// how many
+    int Wait();			// Post completions; wait for one if none
+				// are in the ring and I/O is under way.
+				// Return how many are in the ring
+    int Outstanding() { return outstanding; }
+    void WaitFile(int id);	// Wait until no read or write of file
+				// "id" is under way
+    void Cancel();		// Cancel the receives under way, and wait
+				// for everything under way to finish
+
+    void Run(AioOp *op);	// Internal: do the I/O, on its own thread
+
+  private:
+    AddrSpace *space;
+    int ring;			// the AioRing's virtual address
+    int outstanding;		// # of requests taken out of the ring and
+				//   not posted yet
+    bool cancelled;		// Set by Cancel; receives give up
+
+    Lock *lock;			// protects "done" and the counts below
+    IntrusiveList<AioOp, &AioOp::link> *done;
+				// requests done and not posted yet
+    Condition *completed;	// signalled when one is done
+    int running;		// # of requests whose threads have not
+				//   finished the I/O
+    int busy[MaxOpenFiles];	// # of those, by OpenFileId, that read
+				//   or write a file
+
+    int Post();			// Post what is done; return how many
+				// completions are in the ring
+    int GetInt(int field);	// Read or write a field of the AioRing
+    void PutInt(int field, int value);
+};
+
+#endif // ASYNCIO_H
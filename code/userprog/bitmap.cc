@@ -22,8 +22,8 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +33,7 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
 }
 
 //----------------------------------------------------------------------
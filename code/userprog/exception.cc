@@ -4,8 +4,10 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  Right now, we support "Halt", the file
+//	operations "Create", "Open", "Read", "Write" and "Close", "Pipe",
+//	"Mmap" and "Munmap", which map open files into memory, "AioSetup",
+//	"AioSubmit" and "AioWait", for asynchronous I/O, and "Exit".
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,7 +16,7 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
+// For now, this only handles the system calls above, and page faults.
 // Everything else core dumps.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -24,6 +26,214 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#include "addrspace.h"
+#include "asyncio.h"
+#include "pipe.h"
+
+#define MaxUserString	128		// longest file name we copy in
+#define IoChunkSize	(4 * PageSize)	// most bytes Read or Write moves
+					// through the kernel at once
+
+//----------------------------------------------------------------------
+// UserConsole
+// 	Return the console, making it the first time a program uses it.
+//	Until then, nothing polls the keyboard.
+//----------------------------------------------------------------------
+
+static SynchConsole *
+UserConsole()
+{
+    if (synchConsole == NULL)
+	synchConsole = new SynchConsole(NULL, NULL, 0);
+    return synchConsole;
+}
+
+//----------------------------------------------------------------------
+// FileSyscall
+// 	Carry out the system calls that work on files: Create, Open, Read,
+//	Write and Close.  ConsoleInput and ConsoleOutput go to the console,
+//	pipe ends straight to the pipe (see pipe.h), and other OpenFileIds
+//	to the program's open files.
+//
+//	User buffers move a page at a time between user memory and a
+//	kernel buffer of up to IoChunkSize bytes (see AddrSpace::CopyIn);
+//	console output is buffered in the kernel, so Write returns before
+//	it is all displayed.
+//
+//	Returns the result to pass back to the program: for Open, the
+//	OpenFileId; for Read and Write, the bytes moved; otherwise TRUE
+//	on success.  Returns -1 for a bad name, buffer or OpenFileId.
+//
+//	"type" -- the system call
+//	"arg1", "arg2", "arg3" -- its arguments
+//----------------------------------------------------------------------
+
+static int
+FileSyscall(int type, int arg1, int arg2, int arg3)
+{
+    AddrSpace *space = currentThread->space;
+    char name[MaxUserString];
+    OpenFile *file;
+    KernelPipe *pipe;
+    char *buffer;
+    int done, n;
+    bool bad = FALSE, writing;
+
+    switch (type) {
+      case SC_Create:
+	if (space->CopyInString(arg1, name, MaxUserString) < 0)
+	    return -1;
+	DEBUG('a', "Create %s\n", name);
+	return fileSystem->Create(name, 0);
+
+      case SC_Open:
+	if (space->CopyInString(arg1, name, MaxUserString) < 0)
+	    return -1;
+	file = fileSystem->Open(name);
+	if (file == NULL)
+	    return -1;
+	n = space->AddFile(file);
+	if (n < 0)
+	    delete file;
+	DEBUG('a', "Open %s as %d\n", name, n);
+	return n;
+
+      case SC_Close:
+	return space->CloseFile(arg1) ? TRUE : -1;
+
+      case SC_Read:
+      case SC_Write:
+	if (arg2 < 0)
+	    return -1;
+	if ((pipe = space->GetPipe(arg3, &writing)) != NULL) {
+	    if (writing != (type == SC_Write))
+		return -1;
+	    if (writing)
+		return pipe->Write(space, arg1, arg2);
+	    return pipe->Read(space, arg1, arg2);
+	}
+	if (arg3 == ((type == SC_Read) ? ConsoleInput : ConsoleOutput))
+	    file = NULL;
+	else if ((file = space->GetFile(arg3)) == NULL)
+	    return -1;
+	buffer = new char[IoChunkSize];
+	for (done = 0; done < arg2; done += n) {
+	    n = min(arg2 - done, IoChunkSize);
+	    if (type == SC_Write) {
+		if (!space->CopyIn(arg1 + done, buffer, n)) {
+		    bad = TRUE;
+		    break;
+		}
+		if (file == NULL)
+		    UserConsole()->Write(buffer, n);
+		else
+		    n = file->Write(buffer, n);
+	    } else {
+		if (file == NULL)
+		    n = UserConsole()->Read(buffer, n);
+		else
+		    n = file->Read(buffer, n);
+		if (!space->CopyOut(buffer, arg1 + done, n)) {
+		    bad = TRUE;
+		    break;
+		}
+	    }
+	    if (n == 0 || (file == NULL && type == SC_Read)) {
+		done += n;			// the end of the file, or all
+		break;				// that has been typed
+	    }
+	}
+	delete [] buffer;
+	return (bad && done == 0) ? -1 : done;
+    }
+    ASSERT(FALSE);
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AioSyscall
+// 	Carry out the asynchronous I/O system calls (see asyncio.h).
+//
+//	Returns the result to pass back to the program, -1 if the ring is
+//	bad or has not been set up.
+//
+//	"type" -- the system call
+//	"arg1" -- AioSetup: the address of the AioRing
+//----------------------------------------------------------------------
+
+static int
+AioSyscall(int type, int arg1)
+{
+    AddrSpace *space = currentThread->space;
+    AioRing ring;
+
+    if (type == SC_AioSetup) {
+	if (space->asyncIo != NULL && space->asyncIo->Outstanding() > 0)
+	    return -1;
+	if (!space->CopyIn(arg1, (char *)&ring, sizeof(AioRing))
+		|| (int) WordToHost(ring.size) <= 0)
+	    return -1;
+	delete space->asyncIo;
+	space->asyncIo = new AsyncIo(space, arg1);
+	return 0;
+    }
+    if (space->asyncIo == NULL)
+	return -1;
+    if (type == SC_AioSubmit)
+	return space->asyncIo->Submit();
+    return space->asyncIo->Wait();
+}
+
+//----------------------------------------------------------------------
+// PipeSyscall
+// 	Make a pipe, and give the program an OpenFileId for each end: the
+//	read end in ends[0], the write end in ends[1].  Whole pages written
+//	to it are handed to the reader by remapping.
+//
+//	Returns 0, or -1 if "ends" is bad or too many files are open.
+//
+//	"ends" -- the address of the two OpenFileIds
+//----------------------------------------------------------------------
+
+static int
+PipeSyscall(int ends)
+{
+    AddrSpace *space = currentThread->space;
+    KernelPipe *pipe = new KernelPipe(TRUE);
+    int ids[2], out[2];
+
+    ids[0] = space->AddPipe(pipe, FALSE);
+    if (ids[0] < 0) {
+	delete pipe;			// nothing refers to it
+	return -1;
+    }
+    ids[1] = space->AddPipe(pipe, TRUE);
+    if (ids[1] >= 0) {
+	DEBUG('a', "Pipe from %d to %d\n", ids[1], ids[0]);
+	out[0] = WordToMachine(ids[0]);
+	out[1] = WordToMachine(ids[1]);
+	if (space->CopyOut((char *)out, ends, sizeof(out)))
+	    return 0;
+	space->CloseFile(ids[1]);
+    }
+    space->CloseFile(ids[0]);		// the last end deletes the pipe
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Step the user program past the system call it made.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    int pc = machine->ReadRegister(NextPCReg);
+
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, pc);
+    machine->WriteRegister(NextPCReg, pc + 4);
+}
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -69,33 +279,58 @@ ExceptionHandler(ExceptionType which)
 #endif
     printf("tlb_miss: %d, tlb_hit: %d, tlb miss rate: %.4f\n", 
         machine->tlb_miss, machine->tlb_hit, (float)machine->tlb_miss/(machine->tlb_miss + machine->tlb_hit));
+    printf("tlb flushes: %d on %d cpus\n", machine->tlb_flushes, 
+        machine->NumCpus());
 #endif
+	if (synchConsole != NULL)
+	    synchConsole->Flush();
    	interrupt->Halt();
-    } /*else if ((which == SyscallException) && (type == SC_Exit))
-    {
-        printf("%s exiting\n", currentThread->getName());
-    // deallocate all physical memory
-        for (int i=0; i<machine->pageTableSize; ++i){
-#ifndef REVERSE
-            if (machine->pageTable[i].valid){
-                machine->pageTable[i].valid = FALSE;
-                machine->DeallocPhyPage(machine->pageTable[i].physicalPage);
-            }
-#else
-            if (machine->pageTable[i].valid && machine->pageTable[i].tid == currentThread->getTID()){
-                machine->pageTable[i].valid = FALSE;
-                machine->DeallocPhyPage(i);
-            }
-#endif
-        }
-        int NextPC = machine->ReadRegister(NextPCReg);
-        machine->WriteRegister(PCReg, NextPC);
-    } */else if (which == PageFaultException){
+    } else if ((which == SyscallException) && (type == SC_Exit)) {
+	DEBUG('a', "%s exiting with status %d\n", currentThread->getName(),
+			machine->ReadRegister(4));
+	delete currentThread->space;	// frees its memory, closes its files
+	currentThread->space = NULL;
+	currentThread->Finish();
+    } else if ((which == SyscallException) && (type == SC_Create
+		|| type == SC_Open || type == SC_Read || type == SC_Write
+		|| type == SC_Close)) {
+	machine->WriteRegister(2, FileSyscall(type, machine->ReadRegister(4),
+			machine->ReadRegister(5), machine->ReadRegister(6)));
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_AioSetup
+		|| type == SC_AioSubmit || type == SC_AioWait)) {
+	machine->WriteRegister(2, AioSyscall(type, machine->ReadRegister(4)));
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Pipe)) {
+	machine->WriteRegister(2, PipeSyscall(machine->ReadRegister(4)));
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Mmap)) {
+	machine->WriteRegister(2, currentThread->space->Map(
+			machine->ReadRegister(4), machine->ReadRegister(5)));
+	AdvancePC();
+    } else if ((which == SyscallException) && (type == SC_Munmap)) {
+	machine->WriteRegister(2, currentThread->space->Unmap(
+			machine->ReadRegister(4)) ? TRUE : -1);
+	AdvancePC();
+    } else if (which == PageFaultException){
         int badvaddr = machine->ReadRegister(BadVAddrReg);
         unsigned int vpn = (unsigned) badvaddr/PageSize;
+        // a page that was unmapped, say, is not in the space at all;
+        // check before vpn is used to index the page table
+        if (!currentThread->space->InSpace(vpn)) {
+            ExceptionHandler(AddressErrorException);
+            return;
+        }
         if (machine->tlb != NULL)   // TLB miss
         {
             DEBUG('a', "PageFaultException at vaddr %d\n", badvaddr);
+#ifndef REVERSE
+            // an entry may be about to be replaced: keep the page
+            // table's dirty bits up to date, so no write is lost
+            for (int i = 0; i < TLBSize; i++)
+                if (machine->tlb[i].valid && machine->tlb[i].dirty)
+                    machine->pageTable[machine->tlb[i].virtualPage].dirty = TRUE;
+#endif
             int pos = -1;
             for (int i = 0; i < TLBSize; i++)
                 if (machine->tlb[i].valid == FALSE) // find an empty entry
@@ -198,17 +433,29 @@ ExceptionHandler(ExceptionType which)
             victim_paddr = pos * PageSize;
             // check if it is dirty
 #ifndef REVERSE
+            // drop the victim from the TLB, keeping its dirty bit
+            if (machine->tlb != NULL)
+                for (int i = 0; i < TLBSize; i++)
+                    if (machine->tlb[i].valid 
+                            && machine->tlb[i].virtualPage == victim_vpn) {
+                        if (machine->tlb[i].dirty)
+                            machine->pageTable[victim_vpn].dirty = TRUE;
+                        machine->tlb[i].valid = FALSE;
+                    }
             if (machine->pageTable[victim_vpn].dirty){
-                //write back
-                swapfile->WriteAt(&(machine->mainMemory[victim_paddr]), PageSize, victim_vpn * PageSize);
+                //write back, to the mapped file if it is mapped
+                if (!currentThread->space->PageOut(victim_vpn,
+                                    &(machine->mainMemory[victim_paddr])))
+                    swapfile->WriteAt(&(machine->mainMemory[victim_paddr]), PageSize, victim_vpn * PageSize);
                 machine->pageTable[victim_vpn].dirty = FALSE;
                 //printf("vpn %d (ppn %d) is dirty, write back\n", victim_vpn, pos);
             }
             // modify pageTable
             machine->pageTable[victim_vpn].valid = FALSE;
         }
-        // load content from file
-        swapfile->ReadAt(&(machine->mainMemory[victim_paddr]), PageSize, vpn * PageSize);
+        // load content from file, the mapped one if it is mapped
+        if (!currentThread->space->PageIn(vpn, &(machine->mainMemory[victim_paddr])))
+            swapfile->ReadAt(&(machine->mainMemory[victim_paddr]), PageSize, vpn * PageSize);
         // modify pageTable
         machine->pageTable[vpn].valid = TRUE;
         machine->pageTable[vpn].virtualPage = vpn;
@@ -218,14 +465,17 @@ ExceptionHandler(ExceptionType which)
         machine->pageTable[vpn].readOnly = FALSE;
 #else
             if (machine->pageTable[pos].dirty){
-                //write back
-                swapfile->WriteAt(&(machine->mainMemory[victim_paddr]), PageSize, victim_vpn * PageSize);
+                //write back, to the mapped file if it is mapped
+                if (!currentThread->space->PageOut(victim_vpn,
+                                    &(machine->mainMemory[victim_paddr])))
+                    swapfile->WriteAt(&(machine->mainMemory[victim_paddr]), PageSize, victim_vpn * PageSize);
                 machine->pageTable[pos].dirty = FALSE;
                 printf("vpn %d (ppn %d) is dirty, write back\n", victim_vpn, pos);
             }
         }
-        // load content from file
-        swapfile->ReadAt(&(machine->mainMemory[victim_paddr]), PageSize, vpn * PageSize);
+        // load content from file, the mapped one if it is mapped
+        if (!currentThread->space->PageIn(vpn, &(machine->mainMemory[victim_paddr])))
+            swapfile->ReadAt(&(machine->mainMemory[victim_paddr]), PageSize, vpn * PageSize);
         // modify pageTable
         machine->pageTable[pos].valid = TRUE;
         machine->pageTable[pos].virtualPage = vpn;
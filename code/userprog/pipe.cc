@@ -0,0 +1,264 @@
+// pipe.cc 
+//	Routines to move data between user programs through pipes.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pipe.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// KernelPipe::KernelPipe
+// 	Make an empty pipe.  Nothing refers to it yet; the caller must
+//	Open an end, or Hold it.
+//
+//	"remapPages" -- hand whole pages to readers by remapping them,
+//		not copying
+//----------------------------------------------------------------------
+
+KernelPipe::KernelPipe(bool remapPages)
+{
+    remap = remapPages;
+    lock = new Lock("pipe lock");
+    chunks = new IntrusiveList<PipeChunk, &PipeChunk::link>;
+    lastChunk = NULL;
+    numChunks = 0;
+    readable = new Condition("pipe readable");
+    writable = new Condition("pipe writable");
+    closed = new Condition("pipe closed");
+    readers = writers = holds = 0;
+    bytesRead = pagesRemapped = 0;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::~KernelPipe
+// 	Throw away the data nobody read, freeing the frames in it.
+//----------------------------------------------------------------------
+
+KernelPipe::~KernelPipe()
+{
+    PipeChunk *c;
+
+    while ((c = chunks->Remove()) != NULL) {
+	if (c->frame >= 0)
+	    machine->DeallocPhyPage(c->frame);
+	delete [] c->data;
+	delete c;
+    }
+    delete chunks;
+    delete lock;
+    delete readable;
+    delete writable;
+    delete closed;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Write
+// 	Write data into the pipe, waiting for room as need be.  When we
+//	remap, each whole page is copied into a frame of its own, if one
+//	is free, for Read to hand on; anything else is copied into the
+//	last chunk, or a new one.  The writer's memory is not changed.
+//
+//	Returns the number of bytes written, which is less than
+//	"numBytes" only if the last read end closed; -1 if none were
+//	written for that reason, or because "from" is bad.
+//
+//	"space" -- the writer's address space; it is running
+//	"from" -- the virtual address of the data
+//	"numBytes" -- how much to write
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Write(AddrSpace *space, int from, int numBytes)
+{
+    int done = 0, n, frame;
+    PipeChunk *c;
+
+    lock->Acquire();
+    while (done < numBytes && readers > 0) {
+	if (numChunks == PipeChunks && (lastChunk == NULL
+		    || lastChunk->frame >= 0 || lastChunk->length == PageSize)) {
+	    writable->Wait(lock);		// full
+	    continue;
+	}
+	n = numBytes - done;
+	frame = -1;
+	if (remap && n >= PageSize && numChunks < PipeChunks)
+	    frame = machine->AllocPhyPage();	// -1 if none is free
+	if (frame >= 0 && !space->CopyIn(from + done,
+			&machine->mainMemory[frame * PageSize], PageSize)) {
+	    machine->DeallocPhyPage(frame);
+	    break;
+	}
+
+	if (frame < 0 && lastChunk != NULL && lastChunk->frame < 0
+		&& lastChunk->length < PageSize)
+	    c = lastChunk;			// room left in it
+	else {
+	    c = new PipeChunk;
+	    c->frame = frame;
+	    c->data = (frame < 0) ? new char[PageSize] : NULL;
+	    c->offset = c->length = 0;
+	    chunks->Append(c);
+	    lastChunk = c;
+	    numChunks++;
+	}
+	if (frame >= 0)
+	    n = PageSize;
+	else {
+	    n = min(n, PageSize - c->length);
+	    if (!space->CopyIn(from + done, c->data + c->length, n))
+		break;
+	}
+	c->length += n;
+	done += n;
+	readable->Signal(lock);
+    }
+    lock->Release();
+    return (done == 0 && numBytes > 0) ? -1 : done;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Read
+// 	Wait until the pipe has data, or no writer is left, then read as
+//	much as there is, up to "numBytes".  A whole page in a frame of
+//	its own is mapped into the reader's address space if the reader
+//	wants all of it at a page boundary, and copied out otherwise.
+//
+//	Returns the number of bytes read; 0 if the pipe is empty and
+//	no writer is left; -1 if none were read because "into" is bad.
+//
+//	"space" -- the reader's address space; it is running
+//	"into" -- the virtual address to put the data
+//	"numBytes" -- the most to read
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Read(AddrSpace *space, int into, int numBytes)
+{
+    int done = 0, n;
+    bool bad = FALSE;
+    PipeChunk *c;
+
+    lock->Acquire();
+    while (chunks->IsEmpty() && writers > 0)
+	readable->Wait(lock);
+    while (done < numBytes && (c = chunks->First()) != NULL) {
+	n = min(numBytes - done, c->length - c->offset);
+	if (c->frame >= 0 && c->offset == 0 && n == PageSize
+		&& (into + done) % PageSize == 0
+		&& space->GiveFrame((into + done) / PageSize, c->frame)) {
+	    c->frame = -1;			// it is the reader's now
+	    pagesRemapped++;
+	} else {
+	    char *data = (c->frame >= 0)
+			? &machine->mainMemory[c->frame * PageSize] : c->data;
+
+	    if (!space->CopyOut(data + c->offset, into + done, n)) {
+		bad = TRUE;
+		break;
+	    }
+	}
+	c->offset += n;
+	done += n;
+	if (c->offset == c->length) {
+	    chunks->Remove();
+	    if (c == lastChunk)
+		lastChunk = NULL;
+	    if (c->frame >= 0)
+		machine->DeallocPhyPage(c->frame);
+	    delete [] c->data;
+	    delete c;
+	    numChunks--;
+	    writable->Signal(lock);
+	}
+    }
+    bytesRead += done;
+    lock->Release();
+    return (bad && done == 0) ? -1 : done;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Open, KernelPipe::Close
+// 	Count the OpenFileIds that refer to each end.  The pipe goes away
+//	once none do, unless it is held.
+//
+//	"writing" -- the write end, else the read end
+//----------------------------------------------------------------------
+
+void
+KernelPipe::Open(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	writers++;
+    else
+	readers++;
+    lock->Release();
+}
+
+void
+KernelPipe::Close(bool writing)
+{
+    lock->Acquire();
+    if (writing) {
+	if (--writers == 0)
+	    readable->Broadcast(lock);		// readers see the end
+    } else {
+	if (--readers == 0)
+	    writable->Broadcast(lock);		// writers fail
+    }
+    if (readers == 0 && writers == 0)
+	closed->Broadcast(lock);
+    Unlock();
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Hold, KernelPipe::Release, KernelPipe::WaitClosed
+// 	Let the kernel keep a pipe after its ends are closed, say to
+//	look at its statistics, and wait for that.
+//----------------------------------------------------------------------
+
+void
+KernelPipe::Hold()
+{
+    lock->Acquire();
+    holds++;
+    lock->Release();
+}
+
+void
+KernelPipe::Release()
+{
+    lock->Acquire();
+    holds--;
+    Unlock();
+}
+
+void
+KernelPipe::WaitClosed()
+{
+    lock->Acquire();
+    while (readers > 0 || writers > 0)
+	closed->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Unlock
+// 	Release the lock; then, if nothing refers to the pipe, delete it.
+//	Nobody else can be using it then.
+//----------------------------------------------------------------------
+
+void
+KernelPipe::Unlock()
+{
+    bool unused = (readers == 0 && writers == 0 && holds == 0);
+
+    lock->Release();
+    if (unused)
+	delete this;
+}
@@ -0,0 +1,93 @@
+// pipe.h 
+//	Data structures for pipes: bounded, one-way channels of bytes
+//	between user programs.
+//
+//	A pipe holds up to PipeChunks chunks of at most a page each.
+//	Most writes are copied into chunks of kernel memory, and copied
+//	out again by reads.  But when a write covers a whole page, the
+//	page is copied into a frame of physical memory of its own; and
+//	if the read that reaches it starts on a page boundary and wants
+//	a whole page, the frame is mapped into the reader's address space
+//	in place of its own page.  A page then goes from writer to reader
+//	with one copy, not two.  The writer's memory is left as it was.
+//
+//	Reads wait until the pipe is not empty, writes until it is not
+//	full.  Once every write end is closed, reads of an empty pipe
+//	return 0; once every read end is, writes fail.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "synch.h"
+#include "ilist.h"
+
+#define PipeChunks	8	// most chunks a pipe holds
+
+class AddrSpace;
+
+// The following class defines a chunk of the data in a pipe.
+
+class PipeChunk {
+  public:
+    int frame;			// the frame holding the data, if it is a
+				//   whole page, else -1
+    char *data;			// else the data, copied in; PageSize bytes
+    int offset;			// first byte not yet read
+    int length;			// bytes written into it
+    ListLink<PipeChunk> link;	// on the pipe's list
+};
+
+// The following class defines a pipe.  (The name Pipe is the system
+// call's; see syscall.h.)
+
+class KernelPipe {
+  public:
+    KernelPipe(bool remapPages);
+				// Make a pipe with no ends yet; hand
+				// whole pages to readers by remapping
+				// if "remapPages"
+    ~KernelPipe();
+
+    int Write(AddrSpace *space, int from, int numBytes);
+				// Write "numBytes" at virtual address
+				// "from" of "space", which is running;
+				// return how many, -1 if none could be
+    int Read(AddrSpace *space, int into, int numBytes);
+				// Read up to "numBytes" to "into"; return
+				// how many, 0 at the end, -1 on a bad
+				// address
+
+    void Open(bool writing);	// An OpenFileId now refers to an end
+    void Close(bool writing);	// One no longer does
+    void Hold();		// Keep the pipe after its ends close,
+    void Release();		//   until Release
+    void WaitClosed();		// Wait until no OpenFileId refers to it
+
+    int BytesRead() { return bytesRead; }
+    int PagesRemapped() { return pagesRemapped; }
+
+  private:
+    bool remap;
+    Lock *lock;			// protects all of the below
+    IntrusiveList<PipeChunk, &PipeChunk::link> *chunks;
+    PipeChunk *lastChunk;	// the one writes add to; NULL if none
+    int numChunks;
+    Condition *readable;	// signalled when data is added, or the
+				//   last write end closes
+    Condition *writable;	// signalled when a chunk is freed, or
+				//   the last read end closes
+    Condition *closed;		// signalled when the last end closes
+    int readers, writers;	// # of OpenFileIds for each end
+    int holds;			// # of Holds not yet Released
+    int bytesRead, pagesRemapped;
+
+    void Unlock();		// Release the lock, and delete the pipe
+				// if nothing refers to it any more
+};
+
+#endif // PIPE_H
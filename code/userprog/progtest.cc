@@ -13,6 +13,8 @@
 #include "console.h"
 #include "addrspace.h"
 #include "synch.h"
+#include "pipe.h"
+#include "syscall.h"
 
 void Thread2Run(int which){
     printf("thread 2 running ... \n");
@@ -95,6 +97,67 @@ StartProcess(char *filename)
 					// by doing the syscall "exit"
 }
 
+//----------------------------------------------------------------------
+// RunProgram
+// 	Start the user program whose address space a forked thread has.
+//----------------------------------------------------------------------
+
+static void
+RunProgram(int arg)
+{
+    currentThread->space->InitRegisters();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);
+}
+
+//----------------------------------------------------------------------
+// PipeTest
+// 	Time a pipe.  Run two user programs, giving the writer the write
+//	end of a pipe as OpenFileId 2, and the reader the read end, the
+//	same way (see test/pipewrite.c and test/piperead.c).  Once both
+//	ends are closed, print how fast the data went through, and how
+//	many pages were remapped rather than copied.
+//
+//	"writer", "reader" -- the programs
+//	"remap" -- hand whole pages to the reader by remapping them
+//----------------------------------------------------------------------
+
+void
+PipeTest(char *writer, char *reader, bool remap)
+{
+    KernelPipe *pipe = new KernelPipe(remap);
+    Thread *w = new Thread("pipe writer");
+    Thread *r = new Thread("pipe reader");
+    int start, id;
+
+    bzero(machine->mainMemory, MemorySize);
+#ifdef REVERSE
+    machine->InitRevPageTable();
+#endif
+    pipe->Hold();			// keep it, to read its counts
+    w->space = new AddrSpace(writer);
+    r->space = new AddrSpace(reader);
+    id = w->space->AddPipe(pipe, TRUE);
+    ASSERT(id == ConsoleOutput + 1);
+    id = r->space->AddPipe(pipe, FALSE);
+    ASSERT(id == ConsoleOutput + 1);
+
+    start = stats->totalTicks;
+    w->Fork(RunProgram, 0);
+    r->Fork(RunProgram, 0);
+    pipe->WaitClosed();
+    start = stats->totalTicks - start;
+
+    printf("Pipe (%s): %d bytes in %d ticks, %d bytes/1000 ticks; "
+	"%d pages remapped\n", remap ? "remapping" : "copying",
+	pipe->BytesRead(), start,
+	(int) (pipe->BytesRead() * 1000.0 / max(start, 1)),
+	pipe->PagesRemapped());
+    pipe->Release();
+    interrupt->Halt();
+}
+
 // Data structures needed for the console test.  Threads making
 // I/O requests wait on a Semaphore to delay until the I/O completes.
 
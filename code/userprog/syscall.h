@@ -29,6 +29,12 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Mmap		11
+#define SC_Munmap	12
+#define SC_AioSetup	13
+#define SC_AioSubmit	14
+#define SC_AioWait	15
+#define SC_Pipe		16
 
 #ifndef IN_ASM
 
@@ -48,7 +54,9 @@ void Halt();
 
 /* Address space control operations: Exit, Exec, and Join */
 
-/* This user program is done (status = 0 means exited normally). */
+/* This user program is done (status = 0 means exited normally).  Its
+ * files and pipe ends are closed, and its mappings written back.
+ */
 void Exit(int status);	
 
 /* A unique identifier for an executing user program (address space) */
@@ -105,9 +113,108 @@ void Write(char *buffer, int size, OpenFileId id);
  */
 int Read(char *buffer, int size, OpenFileId id);
 
-/* Close the file, we're done reading and writing to it. */
+/* Close the file, we're done reading and writing to it.  Any mapping
+ * of it is unmapped first.
+ */
 void Close(OpenFileId id);
 
+/* Make a pipe, and put an OpenFileId for its read end in ends[0], and
+ * one for its write end in ends[1].  Return 0, or -1 if too many files
+ * are open.  Read and Write on them as on files: a read waits until
+ * there is data, and returns 0 once there is none and every write end
+ * is closed; a write waits until there is room, and fails once every
+ * read end is closed.
+ *
+ * A read of a whole page, into a page-aligned buffer, of what was
+ * written as a whole page may remap the page into the buffer rather
+ * than copy it.  A write leaves the buffer as it was.
+ */
+int Pipe(OpenFileId *ends);
+
+/* Map the first "length" bytes of the open file "id" into the address
+ * space, and return the address they start at, or 0 if they cannot be
+ * mapped.  Pages of the file are read in as they are touched, and
+ * those written to are written back when they are paged out, and on
+ * Munmap.  No more than the file's length is mapped; the rest of the
+ * last page reads as zeroes, and is not written back.
+ */
+char *Mmap(OpenFileId id, int length);
+
+/* Write back the changes to the mapping that starts at "addr", and
+ * unmap it.  Touching its addresses afterwards is an address error,
+ * until a later Mmap reuses them.
+ */
+void Munmap(char *addr);
+
+
+
+/* Asynchronous I/O: AioSetup, AioSubmit and AioWait.  These let one
+ * thread have many reads, writes and receives under way at once.
+ *
+ * A program puts an AioRing in its memory, with two rings of "size"
+ * entries: one of requests, which it fills, and one of completions,
+ * which the kernel fills.  Entry i of a ring is at index i % size; the
+ * head of a ring is the next entry to take out, the tail the next to
+ * fill, and each side only advances its own.  A request's buffer must
+ * be left alone until its completion is posted.  Closing a file waits
+ * for the requests on it that are under way.
+ *
+ * Completions are posted when the program calls AioSubmit or AioWait,
+ * and the data a read or receive brings in is copied to its buffer
+ * then.
+ */
+
+#define AioMaxLength	4096	/* most bytes a read or write may move */
+
+#define AioRead		0	/* read from an open file */
+#define AioWrite	1	/* write to an open file */
+#define AioReceive	2	/* receive a message, on a machine with a
+				 * network */
+
+typedef struct {
+    int op;			/* AioRead, AioWrite or AioReceive */
+    int id;			/* Read, Write: the OpenFileId; Receive:
+				 * the mailbox */
+    int buffer;			/* address of the data */
+    int length;			/* bytes to read or write, at most
+				 * AioMaxLength; Receive: the room for
+				 * the message */
+    int offset;			/* Read, Write: where in the file; not
+				 * negative */
+    int tag;			/* handed back in the completion */
+} AioRequest;
+
+typedef struct {
+    int tag;			/* the request's */
+    int result;			/* bytes read, written or received; -1 if
+				 * the request was bad */
+} AioCompletion;
+
+typedef struct {
+    int size;			/* entries in each ring */
+    int submitHead;		/* next request the kernel takes */
+    int submitTail;		/* next request the program fills */
+    int completeHead;		/* next completion the program takes */
+    int completeTail;		/* next completion the kernel fills */
+    int requests;		/* address of "size" AioRequests */
+    int completions;		/* address of "size" AioCompletions */
+} AioRing;
+
+/* Use "ring" for this address space's asynchronous I/O.  Return 0, or
+ * -1 if the ring is bad or I/O on the old one is still under way.
+ */
+int AioSetup(AioRing *ring);
+
+/* Start the requests in the ring, and post any completions.  Return
+ * how many requests were started; some may be left in the ring, if
+ * too many are under way.
+ */
+int AioSubmit();
+
+/* Post any completions, and return how many are in the ring.  Only
+ * wait if there are none, and some I/O is under way.
+ */
+int AioWait();
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple